@@ -20,7 +20,13 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <cstdint>
 #include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -50,11 +56,16 @@ template <typename T> class DynamicSubBuffer
 {
   public:
     using size_type = typename std::deque<T>::size_type;
+    /// \brief Handle for a value, unique among the values pushed using the same sequence counter
+    /// (see DynamicSubBuffer()); zero is never used
+    using sequence_type = std::uint64_t;
 
     struct Value
     {
         goby::time::SteadyClock::time_point push_time;
         T data;
+        // set by push()
+        sequence_type sequence_id{0};
         bool operator==(const Value& a) const { return a.push_time == push_time && a.data == data; }
     };
 
@@ -72,7 +83,13 @@ template <typename T> class DynamicSubBuffer
     /// - `newest_first:` true takes priority over false
     /// - `blackout_time:` the smaller value takes precedence
     /// - `queue_size:` the larger value takes precedence
-    DynamicSubBuffer(const std::vector<goby::acomms::protobuf::DynamicBufferConfig>& cfgs)
+    ///
+    /// \param sequence_counter Next Value::sequence_id to give out, shared with other subbuffers
+    /// so that their ids don't collide (if null, this subbuffer has its own counter)
+    DynamicSubBuffer(const std::vector<goby::acomms::protobuf::DynamicBufferConfig>& cfgs,
+                     std::shared_ptr<sequence_type> sequence_counter = nullptr)
+        : next_sequence_id_(sequence_counter ? std::move(sequence_counter)
+                                             : std::make_shared<sequence_type>(1))
     {
         using goby::acomms::protobuf::DynamicBufferConfig;
 
@@ -120,6 +137,13 @@ template <typename T> class DynamicSubBuffer
             cfg_.set_ttl(ttl_sum / ttl_divisor);
         if (value_base_divisor > 0)
             cfg_.set_value_base(value_base_sum / value_base_divisor);
+
+        using Duration = std::chrono::microseconds;
+        ttl_ = goby::time::convert_duration<goby::time::SteadyClock::duration>(
+            cfg_.ttl_with_units());
+        ttl_us_ = goby::time::convert_duration<Duration>(cfg_.ttl_with_units()).count();
+        blackout_ = goby::time::convert_duration<goby::time::SteadyClock::duration>(
+            cfg_.blackout_time_with_units());
     }
 
     ~DynamicSubBuffer() {}
@@ -136,17 +160,29 @@ template <typename T> class DynamicSubBuffer
     Value& top(goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now(),
                goby::time::SteadyClock::duration ack_timeout = std::chrono::microseconds(0))
     {
-        for (auto& datum_pair : data_)
-        {
-            auto& datum_last_access = datum_pair.first;
-            if (datum_last_access == zero_point_ || datum_last_access + ack_timeout < reference)
-            {
-                last_access_ = reference;
-                datum_last_access = last_access_;
-                return datum_pair.second;
-            }
-        }
-        throw(DynamicBufferNoDataException());
+        auto it = _next(data_, reference, ack_timeout);
+        if (it == data_.end())
+            throw(DynamicBufferNoDataException());
+
+        auto& datum_pair = *it;
+        last_access_ = reference;
+        _forget(datum_pair);
+        datum_pair.first = last_access_;
+        sent_times_.insert(datum_pair.first);
+        return datum_pair.second;
+    }
+
+    /// \brief Returns the value that top() would return, without marking it as sent
+    ///
+    /// \throw DynamicBufferNoDataException no data to (re)send
+    const Value&
+    peek(goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now(),
+         goby::time::SteadyClock::duration ack_timeout = std::chrono::microseconds(0)) const
+    {
+        auto it = _next(data_, reference, ack_timeout);
+        if (it == data_.end())
+            throw(DynamicBufferNoDataException());
+        return it->second;
     }
 
     /// \brief returns true if all messages have been sent within ack_timeout of the reference provided and thus none are available for resending yet
@@ -154,13 +190,9 @@ template <typename T> class DynamicSubBuffer
         goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now(),
         goby::time::SteadyClock::duration ack_timeout = std::chrono::microseconds(0)) const
     {
-        for (const auto& datum_pair : data_)
-        {
-            const auto& datum_last_access = datum_pair.first;
-            if (datum_last_access == zero_point_ || datum_last_access + ack_timeout < reference)
-                return false;
-        }
-        return true;
+        // (none never sent, and the oldest send is within ack_timeout)
+        return unsent_ == 0 &&
+               (sent_times_.empty() || !(*sent_times_.begin() + ack_timeout < reference));
     }
 
     enum class ValueResult
@@ -195,14 +227,32 @@ template <typename T> class DynamicSubBuffer
             return std::make_pair(-std::numeric_limits<double>::infinity(),
                                   ValueResult::ALL_MESSAGES_WAITING_FOR_ACK);
 
-        using Duration = std::chrono::microseconds;
+        return std::make_pair(priority(reference), ValueResult::VALUE_PROVIDED);
+    }
 
+    /// \brief The priority value this subbuffer would have (if it has a value to provide): it
+    /// grows linearly with the time since last access at priority_rate() per microsecond
+    double priority(goby::time::SteadyClock::time_point reference) const
+    {
+        using Duration = std::chrono::microseconds;
         double dt = std::chrono::duration_cast<Duration>(reference - last_access_).count();
-        double ttl = goby::time::convert_duration<Duration>(cfg_.ttl_with_units()).count();
-        double v_b = cfg_.value_base();
+        return cfg_.value_base() * dt / ttl_us_;
+    }
+
+    /// \brief Rate (per microsecond) at which priority() increases
+    double priority_rate() const { return cfg_.value_base() / ttl_us_; }
 
-        double v = v_b * dt / ttl;
-        return std::make_pair(v, ValueResult::VALUE_PROVIDED);
+    /// \brief Time of the last call to top()
+    goby::time::SteadyClock::time_point last_access() const { return last_access_; }
+
+    /// \brief Last time point of the blackout following the last call to top()
+    goby::time::SteadyClock::time_point blackout_end() const { return last_access_ + blackout_; }
+
+    /// \brief Time of the oldest send of a value still in the queue (zero if any value has never
+    /// been sent): all_waiting_for_ack() is false once this is more than ack_timeout ago
+    goby::time::SteadyClock::time_point oldest_send() const
+    {
+        return (unsent_ > 0 || sent_times_.empty()) ? zero_point_ : *sent_times_.begin();
     }
 
     /// \brief Returns if buffer is in blackout
@@ -211,10 +261,7 @@ template <typename T> class DynamicSubBuffer
     bool in_blackout(
         goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now()) const
     {
-        auto blackout = goby::time::convert_duration<goby::time::SteadyClock::duration>(
-            cfg_.blackout_time_with_units());
-
-        return reference <= (last_access_ + blackout);
+        return reference <= (last_access_ + blackout_);
     }
     /// \brief Returns if this queue is empty
     bool empty() const { return data_.empty(); }
@@ -223,7 +270,7 @@ template <typename T> class DynamicSubBuffer
     size_type size() const { return data_.size(); }
 
     /// \brief Pop the value on the top of the queue
-    void pop() { data_.pop_front(); }
+    void pop() { _remove(data_.begin()); }
 
     /// \brief Push a value to the queue
     ///
@@ -235,54 +282,65 @@ template <typename T> class DynamicSubBuffer
     {
         std::vector<Value> exceeded;
 
-        if (cfg_.newest_first())
-            data_.push_front(std::make_pair(zero_point_, Value({reference, t})));
-        else
-            data_.push_back(std::make_pair(zero_point_, Value({reference, t})));
+        Datum datum(zero_point_, Value({reference, t, (*next_sequence_id_)++}));
+        auto it = data_.insert(cfg_.newest_first() ? data_.begin() : data_.end(), datum);
+        index_.insert(std::make_pair(it->second.sequence_id, it));
+        ++unsent_;
 
         if (data_.size() > cfg_.max_queue())
         {
             exceeded.push_back(data_.back().second);
-            data_.pop_back();
+            _remove(std::prev(data_.end()));
         }
         return exceeded;
     }
 
     /// \brief Erase any values that have exceeded their time-to-live
     ///
-    /// \return Vector of values that have expired and have been erased
-    std::vector<Value>
-    expire(goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now())
+    /// \param reference Current time reference
+    /// \param visitor Called with each value (as `void(const Value&)`) just before it is erased
+    template <typename Visitor>
+    void expire(goby::time::SteadyClock::time_point reference, Visitor visitor)
     {
-        std::vector<Value> expired;
-
-        auto ttl =
-            goby::time::convert_duration<goby::time::SteadyClock::duration>(cfg_.ttl_with_units());
         if (cfg_.newest_first())
         {
-            while (!data_.empty() && reference > (data_.back().second.push_time + ttl))
+            while (!data_.empty() && reference > (data_.back().second.push_time + ttl_))
             {
-                expired.push_back(data_.back().second);
-                data_.pop_back();
+                visitor(static_cast<const Value&>(data_.back().second));
+                _remove(std::prev(data_.end()));
             }
         }
         else
         {
-            while (!data_.empty() && reference > (data_.front().second.push_time + ttl))
+            while (!data_.empty() && reference > (data_.front().second.push_time + ttl_))
             {
-                expired.push_back(data_.front().second);
-                data_.pop_front();
+                visitor(static_cast<const Value&>(data_.front().second));
+                _remove(data_.begin());
             }
         }
+    }
+
+    /// \brief Erase any values that have exceeded their time-to-live
+    ///
+    /// \return Vector of values that have expired and have been erased
+    std::vector<Value>
+    expire(goby::time::SteadyClock::time_point reference = goby::time::SteadyClock::now())
+    {
+        std::vector<Value> expired;
+        expire(reference, [&expired](const Value& v) { expired.push_back(v); });
         return expired;
     }
 
     /// \brief Erase a value
     ///
-    /// \param value Value to erase (if it exists)
+    /// \param value Value to erase (if it exists): found by its sequence_id if it has one (i.e.
+    /// it was returned by this subbuffer), otherwise by comparing push_time and data
     /// \return true if the value was found and erase, false if the value was not found
     bool erase(const Value& value)
     {
+        if (value.sequence_id != 0)
+            return erase(value.sequence_id);
+
         // start at the beginning as we are most likely to want to erase elements we recently asked for with top()
 
         for (auto it = data_.begin(), end = data_.end(); it != end; ++it)
@@ -290,7 +348,7 @@ template <typename T> class DynamicSubBuffer
             const auto& datum_pair = it->second;
             if (datum_pair == value)
             {
-                data_.erase(it);
+                _remove(it);
                 return true;
             }
 
@@ -303,13 +361,67 @@ template <typename T> class DynamicSubBuffer
         return false;
     }
 
+    /// \brief Erase a value by its Value::sequence_id
+    ///
+    /// \return true if the value was found and erase, false if the value was not found
+    bool erase(sequence_type sequence_id)
+    {
+        auto index_it = index_.find(sequence_id);
+        if (index_it == index_.end())
+            return false;
+        _remove(index_it->second);
+        return true;
+    }
+
+  private:
+    using Datum = std::pair<goby::time::SteadyClock::time_point, Value>;
+
+    // first value never sent, or not sent within ack_timeout
+    template <typename Data>
+    auto _next(Data& data, goby::time::SteadyClock::time_point reference,
+               goby::time::SteadyClock::duration ack_timeout) const -> decltype(data.begin())
+    {
+        return std::find_if(data.begin(), data.end(), [&](const Datum& datum) {
+            return datum.first == zero_point_ || datum.first + ack_timeout < reference;
+        });
+    }
+
+    void _remove(typename std::list<Datum>::iterator it)
+    {
+        _forget(*it);
+        index_.erase(it->second.sequence_id);
+        data_.erase(it);
+    }
+
+    // remove the datum's last send from the cached state (before it is removed or resent)
+    void _forget(const Datum& datum)
+    {
+        if (datum.first == zero_point_)
+            --unsent_;
+        else
+            sent_times_.erase(sent_times_.find(datum.first));
+    }
+
   private:
     goby::acomms::protobuf::DynamicBufferConfig cfg_;
 
+    // from cfg_
+    goby::time::SteadyClock::duration ttl_;
+    double ttl_us_;
+    goby::time::SteadyClock::duration blackout_;
+
     // pair of last send -> value
-    std::deque<std::pair<goby::time::SteadyClock::time_point, Value> > data_;
+    std::list<Datum> data_;
+    // sequence_id -> value
+    std::unordered_map<sequence_type, typename std::list<Datum>::iterator> index_;
+    std::shared_ptr<sequence_type> next_sequence_id_;
     goby::time::SteadyClock::time_point last_access_{goby::time::SteadyClock::now()};
 
+    // values never sent, and the last send times of the others, so that all_waiting_for_ack()
+    // does not need to look at every value
+    size_type unsent_{0};
+    std::multiset<goby::time::SteadyClock::time_point> sent_times_;
+
     goby::time::SteadyClock::time_point zero_point_{std::chrono::seconds(0)};
 };
 
@@ -325,9 +437,14 @@ template <typename T> class DynamicBuffer
     }
     ~DynamicBuffer() {}
 
+    // contest_ points into sub_
+    DynamicBuffer(const DynamicBuffer&) = delete;
+    DynamicBuffer& operator=(const DynamicBuffer&) = delete;
+
     using subbuffer_id_type = std::string;
     using size_type = typename DynamicSubBuffer<T>::size_type;
     using modem_id_type = int;
+    using sequence_type = typename DynamicSubBuffer<T>::sequence_type;
 
     struct Value
     {
@@ -335,6 +452,19 @@ template <typename T> class DynamicBuffer
         subbuffer_id_type subbuffer_id;
         goby::time::SteadyClock::time_point push_time;
         T data;
+        // set for values returned by the buffer: makes erase() a direct lookup
+        sequence_type sequence_id{0};
+    };
+
+    /// \brief A subbuffer that can provide its next value (see candidates())
+    struct Candidate
+    {
+        modem_id_type modem_id;
+        subbuffer_id_type subbuffer_id;
+        // DynamicSubBuffer::top_value()
+        double priority;
+        // size of the value that top() would return
+        size_type bytes;
     };
 
     /// \brief Create a new subbuffer with the given configuration
@@ -361,7 +491,10 @@ template <typename T> class DynamicBuffer
         if (sub_.count(dest_id) && sub_.at(dest_id).count(sub_id))
             throw(goby::Exception("Subbuffer ID: " + sub_id + " already exists."));
 
-        sub_[dest_id].insert(std::make_pair(sub_id, DynamicSubBuffer<T>(cfgs)));
+        auto it =
+            sub_[dest_id].insert(std::make_pair(sub_id, Subbuffer(cfgs, next_sequence_id_))).first;
+        it->second.dest_id = dest_id;
+        it->second.sub_id = &it->first;
     }
 
     /// \brief Replace an existing subbuffer with the given configuration (any messages in the subbuffer will be erased)
@@ -384,7 +517,13 @@ template <typename T> class DynamicBuffer
     void replace(modem_id_type dest_id, const subbuffer_id_type& sub_id,
                  const std::vector<goby::acomms::protobuf::DynamicBufferConfig>& cfgs)
     {
-        sub_[dest_id].erase(sub_id);
+        auto& dest_subs = sub_[dest_id];
+        auto it = dest_subs.find(sub_id);
+        if (it != dest_subs.end())
+        {
+            _leave_contest(it->second);
+            dest_subs.erase(it);
+        }
         create(dest_id, sub_id, cfgs);
     }
 
@@ -396,9 +535,15 @@ template <typename T> class DynamicBuffer
     std::vector<Value> push(const Value& fvt)
     {
         std::vector<Value> exceeded;
-        auto sub_exceeded = sub(fvt.modem_id, fvt.subbuffer_id).push(fvt.data, fvt.push_time);
+        auto& subbuffer = _subbuffer(fvt.modem_id, fvt.subbuffer_id);
+        auto sub_exceeded = subbuffer.buffer.push(fvt.data, fvt.push_time);
         for (const auto& e : sub_exceeded)
-            exceeded.push_back({fvt.modem_id, fvt.subbuffer_id, e.push_time, e.data});
+            exceeded.push_back(
+                {fvt.modem_id, fvt.subbuffer_id, e.push_time, e.data, e.sequence_id});
+        // a value that has never been sent ends the wait for acks
+        if (subbuffer.wait == &ack_wait_)
+            _leave_contest(subbuffer);
+        _enter_contest(subbuffer);
         return exceeded;
     }
 
@@ -409,7 +554,7 @@ template <typename T> class DynamicBuffer
         {
             for (const auto& sub_p : sub_id_p.second)
             {
-                if (!sub_p.second.empty())
+                if (!sub_p.second.buffer.empty())
                     return false;
             }
         }
@@ -423,13 +568,24 @@ template <typename T> class DynamicBuffer
         size_type size = 0;
         for (const auto& sub_id_p : sub_)
         {
-            for (const auto& sub_p : sub_id_p.second) size += sub_p.second.size();
+            for (const auto& sub_p : sub_id_p.second) size += sub_p.second.buffer.size();
         }
         return size;
     }
 
     /// \brief Returns the top value in a priority contest between all subbuffers
     ///
+    /// Subbuffers whose priority values grow at the same rate (DynamicSubBuffer::priority_rate())
+    /// keep the same order (least recently accessed first) as time passes, so each of these
+    /// classes is kept sorted and is only searched until the first subbuffer that can provide a
+    /// value, or that cannot beat the best value found so far.
+    ///
+    /// Subbuffers found in blackout or waiting for acks are set aside (indexed by the time they
+    /// can next provide a value) until that time, so they are not searched again meanwhile.
+    /// Subbuffers whose next value is larger than max_bytes are still passed over one at a time,
+    /// so a call costs O(number of those subbuffers) in addition to O(log n) per subbuffer set
+    /// aside or returned to the contest.
+    ///
     /// \param dest_id Modem id for this packet (can be QUERY_DESTINATION_ID to query all possible destinations)
     /// \param max_bytes Maximum number of bytes in the returned message
     /// \param ack_timeout Duration to wait before resending a value
@@ -443,7 +599,7 @@ template <typename T> class DynamicBuffer
         glog.is_debug1() && glog << group(glog_priority_group_)
                                  << "Starting priority contest:" << std::endl;
 
-        typename std::unordered_map<subbuffer_id_type, DynamicSubBuffer<T> >::iterator winning_sub;
+        Subbuffer* winning_sub = nullptr;
         double winning_value = -std::numeric_limits<double>::infinity();
 
         auto now = goby::time::SteadyClock::now();
@@ -451,53 +607,52 @@ template <typename T> class DynamicBuffer
         if (dest_id != goby::acomms::QUERY_DESTINATION_ID && !sub_.count(dest_id))
             throw(DynamicBufferNoDataException());
 
+        _end_waits(now, ack_timeout);
+
         // if QUERY_DESTINATION_ID, search all subbuffers, otherwise just search the ones that were specified by dest_id
-        for (auto sub_id_it = (dest_id == goby::acomms::QUERY_DESTINATION_ID) ? sub_.begin()
-                                                                              : sub_.find(dest_id),
-                  sub_id_end = (dest_id == goby::acomms::QUERY_DESTINATION_ID)
-                                   ? sub_.end()
-                                   : ++sub_.find(dest_id);
-             sub_id_it != sub_id_end; ++sub_id_it)
+        bool query = (dest_id == goby::acomms::QUERY_DESTINATION_ID);
+        for (auto contest_it = query ? contest_.begin() : contest_.find(dest_id),
+                  contest_end = (query || contest_it == contest_.end()) ? contest_.end()
+                                                                        : std::next(contest_it);
+             contest_it != contest_end; ++contest_it)
         {
-            for (auto sub_it = sub_id_it->second.begin(), sub_end = sub_id_it->second.end();
-                 sub_it != sub_end; ++sub_it)
+            for (auto& rate_p : contest_it->second)
             {
-                double value;
-                typename DynamicSubBuffer<T>::ValueResult result;
-                std::tie(value, result) = sub_it->second.top_value(now, max_bytes, ack_timeout);
-
-                std::string value_or_reason;
-                switch (result)
+                auto& entries = rate_p.second;
+                for (auto it = entries.begin(); it != entries.end();)
                 {
-                    case DynamicSubBuffer<T>::ValueResult::VALUE_PROVIDED:
-                        value_or_reason = std::to_string(value);
-                        break;
-
-                    case DynamicSubBuffer<T>::ValueResult::EMPTY: value_or_reason = "empty"; break;
-
-                    case DynamicSubBuffer<T>::ValueResult::IN_BLACKOUT:
-                        value_or_reason = "blackout";
-                        break;
+                    Subbuffer& subbuffer = *it->subbuffer;
+                    const auto& buffer = subbuffer.buffer;
 
-                    case DynamicSubBuffer<T>::ValueResult::NEXT_MESSAGE_TOO_LARGE:
-                        value_or_reason = "too large";
+                    // the rest of this class has (at most) this value
+                    if (!(buffer.priority(now) > winning_value))
                         break;
 
-                    case DynamicSubBuffer<T>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK:
-                        value_or_reason = "ack wait";
+                    double value;
+                    typename DynamicSubBuffer<T>::ValueResult result;
+                    std::tie(value, result) = buffer.top_value(now, max_bytes, ack_timeout);
+
+                    glog.is_debug1() && glog << group(glog_priority_group_) << "\t" << *it->sub_id
+                                             << " [dest: " << contest_it->first
+                                             << ", n: " << buffer.size()
+                                             << "]: " << value_or_reason(value, result)
+                                             << std::endl;
+
+                    if (result == DynamicSubBuffer<T>::ValueResult::VALUE_PROVIDED)
+                    {
+                        winning_value = value;
+                        winning_sub = &subbuffer;
+                        dest_id = contest_it->first;
                         break;
-                }
-
-                glog.is_debug1() && glog << group(glog_priority_group_) << "\t" << sub_it->first
-                                         << " [dest: " << sub_id_it->first
-                                         << ", n: " << sub_it->second.size()
-                                         << "]: " << value_or_reason << std::endl;
-
-                if (value > winning_value)
-                {
-                    winning_value = value;
-                    winning_sub = sub_it;
-                    dest_id = sub_id_it->first;
+                    }
+
+                    auto next = std::next(it);
+                    if (result == DynamicSubBuffer<T>::ValueResult::IN_BLACKOUT)
+                        _wait(subbuffer, blackout_wait_, buffer.blackout_end());
+                    else if (result ==
+                             DynamicSubBuffer<T>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK)
+                        _wait(subbuffer, ack_wait_, buffer.oldest_send());
+                    it = next;
                 }
             }
         }
@@ -505,56 +660,282 @@ template <typename T> class DynamicBuffer
         if (winning_value == -std::numeric_limits<double>::infinity())
             throw(DynamicBufferNoDataException());
 
-        glog.is_debug1() && glog << group(glog_priority_group_) << "Winner: " << winning_sub->first
+        const subbuffer_id_type& winning_id = *winning_sub->contest_it->sub_id;
+        glog.is_debug1() && glog << group(glog_priority_group_) << "Winner: " << winning_id
                                  << std::endl;
 
-        const auto& top_p = winning_sub->second.top(now, ack_timeout);
-        return {dest_id, winning_sub->first, top_p.push_time, top_p.data};
+        const auto& top_p = winning_sub->buffer.top(now, ack_timeout);
+        Value top{dest_id, winning_id, top_p.push_time, top_p.data, top_p.sequence_id};
+
+        // last access has changed
+        _leave_contest(*winning_sub);
+        _enter_contest(*winning_sub);
+        return top;
+    }
+
+    /// \brief Returns every subbuffer that could provide a value to top() right now, without
+    /// changing the state of any subbuffer
+    ///
+    /// Use this to choose a set of values (e.g. to pack a frame), then take each with
+    /// top(modem_id_type, const subbuffer_id_type&, goby::time::SteadyClock::duration)
+    /// \param dest_id Modem id for this packet (can be QUERY_DESTINATION_ID to query all possible destinations)
+    /// \param max_bytes Maximum size of each value
+    /// \param ack_timeout Duration to wait before resending a value
+    std::vector<Candidate>
+    candidates(modem_id_type dest_id = goby::acomms::QUERY_DESTINATION_ID,
+               size_type max_bytes = std::numeric_limits<size_type>::max(),
+               goby::time::SteadyClock::duration ack_timeout = std::chrono::microseconds(0)) const
+    {
+        std::vector<Candidate> candidates;
+        auto now = goby::time::SteadyClock::now();
+        for (const auto& sub_id_p : sub_)
+        {
+            if (dest_id != goby::acomms::QUERY_DESTINATION_ID && sub_id_p.first != dest_id)
+                continue;
+
+            for (const auto& sub_p : sub_id_p.second)
+            {
+                const auto& buffer = sub_p.second.buffer;
+                auto value_p = buffer.top_value(now, max_bytes, ack_timeout);
+                if (value_p.second != DynamicSubBuffer<T>::ValueResult::VALUE_PROVIDED)
+                    continue;
+
+                size_type bytes = data_size(buffer.peek(now, ack_timeout).data);
+                if (bytes <= max_bytes)
+                    candidates.push_back({sub_id_p.first, sub_p.first, value_p.first, bytes});
+            }
+        }
+        return candidates;
+    }
+
+    /// \brief Returns the top value of a given subbuffer, regardless of the other subbuffers
+    /// (e.g. one chosen from candidates())
+    ///
+    /// \param dest_id Modem id of the subbuffer
+    /// \param sub_id Subbuffer id
+    /// \param ack_timeout Duration to wait before resending a value
+    /// \throw DynamicBufferNoDataException The subbuffer has no data to (re)send
+    /// \throw goby::Exception If subbuffer doesn't exist
+    Value top(modem_id_type dest_id, const subbuffer_id_type& sub_id,
+              goby::time::SteadyClock::duration ack_timeout = std::chrono::microseconds(0))
+    {
+        auto& subbuffer = _subbuffer(dest_id, sub_id);
+        const auto& top_p = subbuffer.buffer.top(goby::time::SteadyClock::now(), ack_timeout);
+        Value top{dest_id, sub_id, top_p.push_time, top_p.data, top_p.sequence_id};
+
+        // last access has changed
+        _leave_contest(subbuffer);
+        _enter_contest(subbuffer);
+        return top;
     }
 
     /// \brief Erase a value
     ///
-    /// \param value Value to erase (if it exists)
+    /// \param value Value to erase (if it exists): a value returned by the buffer (e.g. from
+    /// top()) is found directly by its sequence_id, otherwise by comparing push_time and data
     /// \return true if the value was found and erase, false if the value was not found
     /// \throw goby::Exception If subbuffer doesn't exist
     bool erase(const Value& value)
     {
-        return sub(value.modem_id, value.subbuffer_id).erase({value.push_time, value.data});
+        auto& subbuffer = _subbuffer(value.modem_id, value.subbuffer_id);
+        bool erased = value.sequence_id != 0
+                          ? subbuffer.buffer.erase(value.sequence_id)
+                          : subbuffer.buffer.erase({value.push_time, value.data});
+        if (subbuffer.buffer.empty())
+            _leave_contest(subbuffer);
+        return erased;
     }
 
     /// \brief Erase any values that have exceeded their time-to-live
     ///
-    /// \return Vector of values that have expired and have been erased
-    std::vector<Value> expire()
+    /// \param visitor Called with each value (as `void(const Value&)`) as it is erased
+    template <typename Visitor> void expire(Visitor visitor)
     {
         auto now = goby::time::SteadyClock::now();
-        std::vector<Value> expired;
         for (auto& sub_id_p : sub_)
         {
             for (auto& sub_p : sub_id_p.second)
             {
-                auto sub_expired = sub_p.second.expire(now);
-                for (const auto& e : sub_expired)
-                    expired.push_back({sub_id_p.first, sub_p.first, e.push_time, e.data});
+                auto& subbuffer = sub_p.second;
+                subbuffer.buffer.expire(now, [&](const typename DynamicSubBuffer<T>::Value& e) {
+                    visitor(static_cast<const Value&>(Value{sub_id_p.first, sub_p.first,
+                                                            e.push_time, e.data, e.sequence_id}));
+                });
+                if (subbuffer.buffer.empty())
+                    _leave_contest(subbuffer);
             }
         }
+    }
+
+    /// \brief Erase any values that have exceeded their time-to-live
+    ///
+    /// \return Vector of values that have expired and have been erased
+    std::vector<Value> expire()
+    {
+        std::vector<Value> expired;
+        expire([&expired](const Value& v) { expired.push_back(v); });
         return expired;
     }
 
-    /// \brief Reference a given subbuffer
+    /// \brief Reference a given subbuffer (read only: it is changed through the DynamicBuffer so
+    /// that the priority contest stays correct)
     ///
     /// \throw goby::Exception If subbuffer doesn't exist
-    DynamicSubBuffer<T>& sub(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    const DynamicSubBuffer<T>& sub(modem_id_type dest_id, const subbuffer_id_type& sub_id) const
+    {
+        return _subbuffer(dest_id, sub_id).buffer;
+    }
+
+  private:
+    struct Subbuffer;
+    using WaitMap = std::multimap<goby::time::SteadyClock::time_point, Subbuffer*>;
+
+    struct ContestEntry
+    {
+        // last access, negated if the priority value decreases with time (priority_rate() < 0)
+        goby::time::SteadyClock::rep order;
+        // key in sub_
+        const subbuffer_id_type* sub_id;
+        Subbuffer* subbuffer;
+
+        bool operator<(const ContestEntry& e) const
+        {
+            return order < e.order || (order == e.order && *sub_id < *e.sub_id);
+        }
+    };
+
+    struct Subbuffer
     {
-        if (!sub_.count(dest_id) || !sub_.at(dest_id).count(sub_id))
-            throw(goby::Exception("Subbuffer ID: " + sub_id +
-                                  " does not exist, must call create(...) first."));
-        return sub_.at(dest_id).at(sub_id);
+        Subbuffer(const std::vector<goby::acomms::protobuf::DynamicBufferConfig>& cfgs,
+                  std::shared_ptr<sequence_type> sequence_counter)
+            : buffer(cfgs, std::move(sequence_counter))
+        {
+        }
+
+        DynamicSubBuffer<T> buffer;
+        modem_id_type dest_id{0};
+        // key in sub_
+        const subbuffer_id_type* sub_id{nullptr};
+
+        // place in contest_ or (if waiting) in blackout_wait_ or ack_wait_; neither if empty
+        std::set<ContestEntry>* contest_class{nullptr};
+        typename std::set<ContestEntry>::iterator contest_it;
+        WaitMap* wait{nullptr};
+        typename WaitMap::iterator wait_it;
+    };
+
+    Subbuffer& _subbuffer(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    {
+        return _find_subbuffer(sub_, dest_id, sub_id);
+    }
+
+    const Subbuffer& _subbuffer(modem_id_type dest_id, const subbuffer_id_type& sub_id) const
+    {
+        return _find_subbuffer(sub_, dest_id, sub_id);
+    }
+
+    // SubMap is (const) decltype(sub_)
+    template <typename SubMap>
+    static auto& _find_subbuffer(SubMap& sub, modem_id_type dest_id,
+                                 const subbuffer_id_type& sub_id)
+    {
+        auto dest_it = sub.find(dest_id);
+        if (dest_it != sub.end())
+        {
+            auto it = dest_it->second.find(sub_id);
+            if (it != dest_it->second.end())
+                return it->second;
+        }
+        throw(goby::Exception("Subbuffer ID: " + sub_id +
+                              " does not exist, must call create(...) first."));
+    }
+
+    static goby::time::SteadyClock::rep _contest_order(const DynamicSubBuffer<T>& buffer)
+    {
+        auto last_access = buffer.last_access().time_since_epoch().count();
+        return buffer.priority_rate() < 0 ? -last_access : last_access;
+    }
+
+    void _enter_contest(Subbuffer& subbuffer)
+    {
+        if (subbuffer.contest_class || subbuffer.wait || subbuffer.buffer.empty())
+            return;
+
+        auto& contest_class = contest_[subbuffer.dest_id][subbuffer.buffer.priority_rate()];
+        subbuffer.contest_it =
+            contest_class.insert({_contest_order(subbuffer.buffer), subbuffer.sub_id, &subbuffer})
+                .first;
+        subbuffer.contest_class = &contest_class;
+    }
+
+    // takes the subbuffer out of the contest (or a wait)
+    void _leave_contest(Subbuffer& subbuffer)
+    {
+        if (subbuffer.contest_class)
+        {
+            subbuffer.contest_class->erase(subbuffer.contest_it);
+            subbuffer.contest_class = nullptr;
+        }
+        else if (subbuffer.wait)
+        {
+            subbuffer.wait->erase(subbuffer.wait_it);
+            subbuffer.wait = nullptr;
+        }
+    }
+
+    // moves the subbuffer from the contest to a wait, keyed on blackout_end() or oldest_send()
+    void _wait(Subbuffer& subbuffer, WaitMap& wait, goby::time::SteadyClock::time_point key)
+    {
+        _leave_contest(subbuffer);
+        subbuffer.wait_it = wait.insert(std::make_pair(key, &subbuffer));
+        subbuffer.wait = &wait;
+    }
+
+    // returns subbuffers to the contest once their blackout or wait for acks may be over
+    void _end_waits(goby::time::SteadyClock::time_point now,
+                    goby::time::SteadyClock::duration ack_timeout)
+    {
+        while (!blackout_wait_.empty() && blackout_wait_.begin()->first < now)
+        {
+            Subbuffer& subbuffer = *blackout_wait_.begin()->second;
+            _leave_contest(subbuffer);
+            _enter_contest(subbuffer);
+        }
+        while (!ack_wait_.empty() && ack_wait_.begin()->first + ack_timeout < now)
+        {
+            Subbuffer& subbuffer = *ack_wait_.begin()->second;
+            _leave_contest(subbuffer);
+            _enter_contest(subbuffer);
+        }
+    }
+
+    static std::string value_or_reason(double value,
+                                       typename DynamicSubBuffer<T>::ValueResult result)
+    {
+        switch (result)
+        {
+            case DynamicSubBuffer<T>::ValueResult::VALUE_PROVIDED: return std::to_string(value);
+            case DynamicSubBuffer<T>::ValueResult::EMPTY: return "empty";
+            case DynamicSubBuffer<T>::ValueResult::IN_BLACKOUT: return "blackout";
+            case DynamicSubBuffer<T>::ValueResult::NEXT_MESSAGE_TOO_LARGE: return "too large";
+            case DynamicSubBuffer<T>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK: return "ack wait";
+        }
+        return "";
     }
 
   private:
     // destination -> subbuffer id (group/type) -> subbuffer
-    std::map<modem_id_type, std::unordered_map<subbuffer_id_type, DynamicSubBuffer<T> > > sub_;
+    std::map<modem_id_type, std::unordered_map<subbuffer_id_type, Subbuffer> > sub_;
+    // shared by all subbuffers (including replacements), so a Value's sequence_id can't match a
+    // different value pushed later
+    std::shared_ptr<sequence_type> next_sequence_id_{std::make_shared<sequence_type>(1)};
+
+    // destination -> priority_rate() -> non-empty subbuffers in order of decreasing priority
+    std::map<modem_id_type, std::map<double, std::set<ContestEntry> > > contest_;
+    // subbuffers left out of contest_ until blackout_end() has passed, or until oldest_send() is
+    // more than ack_timeout ago (ack_timeout is a top() parameter, so it isn't part of the key)
+    WaitMap blackout_wait_;
+    WaitMap ack_wait_;
 
     std::string glog_priority_group_;
     static std::atomic<int> count_;
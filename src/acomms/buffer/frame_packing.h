@@ -0,0 +1,127 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FramePacking20261018H
+#define FramePacking20261018H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace goby
+{
+namespace acomms
+{
+/// \brief Chooses which values to send in a frame of max_bytes so that the sum of their
+/// priorities is as large as possible (and then, so that as many bytes as possible are used)
+///
+/// Values with a priority below zero are treated as having priority zero: they are only used to
+/// fill space. Unlike repeatedly taking the highest priority value that fits, this will skip a
+/// large value for several smaller values that are worth more together.
+///
+/// This is solved exactly (0/1 knapsack) unless candidates.size() * (max_bytes + 1) is more than
+/// max_cells, in which case the candidates are taken in order of priority per byte while they fit.
+/// \tparam Candidate Type with members priority (double) and bytes (e.g.
+/// DynamicBuffer::Candidate)
+/// \param candidates Values that could be sent (each no larger than max_bytes)
+/// \param max_bytes Space in the frame
+/// \param max_cells Limit on the work (and memory in bytes) for the exact solution
+/// \return Indices into candidates of the values to send, highest priority first
+template <typename Candidate>
+std::vector<std::size_t> pack_frame(const std::vector<Candidate>& candidates,
+                                    std::size_t max_bytes, std::size_t max_cells)
+{
+    auto n = candidates.size();
+    auto value = [&](std::size_t i) { return std::max(candidates[i].priority, 0.0); };
+
+    std::vector<std::size_t> chosen;
+    if (max_bytes < max_cells && n <= max_cells / (max_bytes + 1))
+    {
+        // best value (then bytes) using no more than w bytes, for the candidates so far
+        std::vector<double> best_value(max_bytes + 1, 0);
+        std::vector<std::size_t> best_bytes(max_bytes + 1, 0);
+        // whether candidate i is part of the best solution for w bytes
+        std::vector<bool> take(n * (max_bytes + 1), false);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::size_t bytes = candidates[i].bytes;
+            if (bytes > max_bytes)
+                continue;
+
+            for (std::size_t w = max_bytes + 1; w-- > bytes;)
+            {
+                double v = best_value[w - bytes] + value(i);
+                std::size_t b = best_bytes[w - bytes] + bytes;
+                if (v > best_value[w] || (v == best_value[w] && b > best_bytes[w]))
+                {
+                    best_value[w] = v;
+                    best_bytes[w] = b;
+                    take[i * (max_bytes + 1) + w] = true;
+                }
+            }
+        }
+
+        for (std::size_t i = n, w = max_bytes; i-- > 0;)
+        {
+            if (take[i * (max_bytes + 1) + w])
+            {
+                chosen.push_back(i);
+                w -= candidates[i].bytes;
+            }
+        }
+    }
+    else
+    {
+        std::vector<double> density(n);
+        for (std::size_t i = 0; i < n; ++i)
+            density[i] = candidates[i].bytes > 0 ? value(i) / candidates[i].bytes
+                                                 : std::numeric_limits<double>::infinity();
+
+        std::vector<std::size_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](std::size_t a, std::size_t b) { return density[a] > density[b]; });
+
+        std::size_t remaining = max_bytes;
+        for (auto i : order)
+        {
+            if (candidates[i].bytes <= remaining)
+            {
+                chosen.push_back(i);
+                remaining -= candidates[i].bytes;
+            }
+        }
+    }
+
+    std::stable_sort(chosen.begin(), chosen.end(), [&](std::size_t a, std::size_t b) {
+        return candidates[a].priority > candidates[b].priority;
+    });
+    return chosen;
+}
+
+} // namespace acomms
+} // namespace goby
+
+#endif
@@ -20,7 +20,9 @@
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdlib>
+#include <deque>
 #include <dlfcn.h>
+#include <future>
 #include <iostream>
 
 #include "goby/util/debug_logger.h"
@@ -57,7 +59,8 @@ int main(int argc, char* argv[])
     return goby::run<goby::middleware::hdf5::Writer>(argc, argv);
 }
 
-void goby::middleware::hdf5::Channel::add_message(const goby::middleware::HDF5ProtobufEntry& entry)
+goby::middleware::hdf5::MessageCollection&
+goby::middleware::hdf5::Channel::add_message(const goby::middleware::HDF5ProtobufEntry& entry)
 {
     const std::string& msg_name = entry.msg->GetDescriptor()->full_name();
     typedef std::map<std::string, MessageCollection>::iterator It;
@@ -69,6 +72,7 @@ void goby::middleware::hdf5::Channel::add_message(const goby::middleware::HDF5Pr
         it = itpair.first;
     }
     it->second.entries.insert(std::make_pair(time::MicroTime(entry.time).value(), entry.msg));
+    return it->second;
 }
 
 H5::Group& goby::middleware::hdf5::GroupFactory::fetch_group(const std::string& group_path)
@@ -106,8 +110,15 @@ goby::middleware::hdf5::Writer::Writer()
     : h5file_(app_cfg().output_file(), H5F_ACC_TRUNC), group_factory_(h5file_)
 {
     load();
-    collect();
-    write();
+    if (app_cfg().streaming())
+    {
+        collect_and_write();
+    }
+    else
+    {
+        collect();
+        write();
+    }
     quit();
 }
 
@@ -152,179 +163,136 @@ void goby::middleware::hdf5::Writer::collect()
     }
 }
 
-void goby::middleware::hdf5::Writer::write()
+void goby::middleware::hdf5::Writer::collect_and_write()
 {
-    for (std::map<std::string, goby::middleware::hdf5::Channel>::const_iterator
-             it = channels_.begin(),
-             end = channels_.end();
-         it != end; ++it)
-        write_channel("/" + it->first, it->second);
-}
+    if (app_cfg().chunk_size() == 0)
+        glog.is(DIE) && glog << "chunk_size must be greater than zero" << std::endl;
 
-void goby::middleware::hdf5::Writer::write_channel(const std::string& group,
-                                                   const goby::middleware::hdf5::Channel& channel)
-{
-    for (std::map<std::string, goby::middleware::hdf5::MessageCollection>::const_iterator
-             it = channel.entries.begin(),
-             end = channel.entries.end();
-         it != end; ++it)
-        write_message_collection(group + "/" + it->first, it->second);
-}
-
-void goby::middleware::hdf5::Writer::write_message_collection(
-    const std::string& group, const goby::middleware::hdf5::MessageCollection& message_collection)
-{
-    write_time(group, message_collection);
-
-    const google::protobuf::Descriptor* desc =
-        message_collection.entries.begin()->second->GetDescriptor();
-    for (int i = 0, n = desc->field_count(); i < n; ++i)
+    goby::middleware::HDF5ProtobufEntry entry;
+    while (plugin_->provide_entry(&entry))
     {
-        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-
-        std::vector<const google::protobuf::Message*> messages;
-        for (std::multimap<std::uint64_t,
-                           std::shared_ptr<google::protobuf::Message> >::const_iterator
-                 it = message_collection.entries.begin(),
-                 end = message_collection.entries.end();
-             it != end; ++it)
-        { messages.push_back(it->second.get()); } std::vector<hsize_t> hs;
-        hs.push_back(messages.size());
-        write_field_selector(group, field_desc, messages, hs);
-    }
-}
+        boost::trim_if(entry.channel,
+                       boost::algorithm::is_space() || boost::algorithm::is_any_of("/"));
 
-void goby::middleware::hdf5::Writer::write_embedded_message(
-    const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-    const std::vector<const google::protobuf::Message*> messages, std::vector<hsize_t>& hs)
-{
-    const google::protobuf::Descriptor* sub_desc = field_desc->message_type();
-    if (field_desc->is_repeated())
-    {
-        int max_field_size = 0;
-        for (unsigned i = 0, n = messages.size(); i < n; ++i)
+        typedef std::map<std::string, goby::middleware::hdf5::Channel>::iterator It;
+        It it = channels_.find(entry.channel);
+        if (it == channels_.end())
         {
-            if (messages[i])
-            {
-                const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                int field_size = refl->FieldSize(*messages[i], field_desc);
-                if (field_size > max_field_size)
-                    max_field_size = field_size;
-            }
+            std::pair<It, bool> itpair = channels_.insert(
+                std::make_pair(entry.channel, goby::middleware::hdf5::Channel(entry.channel)));
+            it = itpair.first;
         }
 
-        hs.push_back(max_field_size);
-
-        for (int i = 0, n = sub_desc->field_count(); i < n; ++i)
+        goby::middleware::hdf5::MessageCollection& message_collection =
+            it->second.add_message(entry);
+        if (message_collection.entries.size() >= app_cfg().chunk_size())
         {
-            const google::protobuf::FieldDescriptor* sub_field_desc = sub_desc->field(i);
-
-            std::vector<const google::protobuf::Message*> sub_messages(
-                messages.size() * max_field_size, (const google::protobuf::Message*)0);
-
-            for (unsigned i = 0, n = messages.size(); i < n; ++i)
-            {
-                if (messages[i])
-                {
-                    const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                    int field_size = refl->FieldSize(*messages[i], field_desc);
-
-                    for (int j = 0; j < field_size; ++j)
-                    {
-                        const google::protobuf::Message& sub_msg =
-                            refl->GetRepeatedMessage(*messages[i], field_desc, j);
-                        sub_messages[i * max_field_size + j] = &sub_msg;
-                    }
-                }
-            }
-            write_field_selector(group + "/" + field_desc->name(), sub_field_desc, sub_messages,
-                                 hs);
+            write_message_collection("/" + it->first + "/" + message_collection.name,
+                                     message_collection);
+            message_collection.entries.clear();
         }
-        hs.pop_back();
+        entry.clear();
     }
-    else
+
+    // the remaining partial chunks
+    write();
+}
+
+void goby::middleware::hdf5::Writer::write()
+{
+    typedef std::vector<std::unique_ptr<ColumnSet> > ColumnSets;
+
+    // the fields of each channel are extracted by up to "threads" threads at once, while this
+    // thread writes the channels (in order) as they become ready
+    std::deque<std::pair<std::map<std::string, goby::middleware::hdf5::Channel>::const_iterator,
+                         std::future<ColumnSets> > >
+        pending;
+    const unsigned threads = std::max(1u, app_cfg().threads());
+    const std::launch policy = threads > 1 ? std::launch::async : std::launch::deferred;
+
+    auto it = channels_.cbegin(), end = channels_.cend();
+    while (it != end || !pending.empty())
     {
-        for (int i = 0, n = sub_desc->field_count(); i < n; ++i)
+        while (it != end && pending.size() < threads)
         {
-            const google::protobuf::FieldDescriptor* sub_field_desc = sub_desc->field(i);
-            std::vector<const google::protobuf::Message*> sub_messages;
-            for (std::vector<const google::protobuf::Message*>::const_iterator
-                     it = messages.begin(),
-                     end = messages.end();
-                 it != end; ++it)
+            // plans are built here so that the extracting threads only read them
+            std::vector<std::pair<const MessageCollection*, const MessagePlan*> > collections;
+            for (const auto& collection : it->second.entries)
             {
-                if (*it)
-                {
-                    const google::protobuf::Reflection* refl = (*it)->GetReflection();
-                    const google::protobuf::Message& sub_msg = refl->GetMessage(**it, field_desc);
-                    sub_messages.push_back(&sub_msg);
-                }
-                else
-                {
-                    sub_messages.push_back(0);
-                }
+                // (streaming) everything already written
+                if (!collection.second.entries.empty())
+                    collections.push_back(std::make_pair(
+                        &collection.second,
+                        &plan(collection.second.entries.begin()->second->GetDescriptor())));
             }
-            write_field_selector(group + "/" + field_desc->name(), sub_field_desc, sub_messages,
-                                 hs);
+
+            pending.push_back(std::make_pair(it, std::async(policy, [collections]() {
+                                                 ColumnSets column_sets;
+                                                 for (const auto& collection : collections)
+                                                     column_sets.push_back(extract(
+                                                         *collection.second, *collection.first));
+                                                 return column_sets;
+                                             })));
+            ++it;
         }
+
+        ColumnSets column_sets = pending.front().second.get();
+        write_channel("/" + pending.front().first->first, pending.front().first->second,
+                      column_sets);
+        pending.pop_front();
     }
 }
 
-void goby::middleware::hdf5::Writer::write_field_selector(
-    const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-    const std::vector<const google::protobuf::Message*>& messages, std::vector<hsize_t>& hs)
+void goby::middleware::hdf5::Writer::write_channel(
+    const std::string& group, const goby::middleware::hdf5::Channel& channel,
+    std::vector<std::unique_ptr<ColumnSet> >& column_sets)
 {
-    switch (field_desc->cpp_type())
+    auto column_set_it = column_sets.begin();
+    for (std::map<std::string, goby::middleware::hdf5::MessageCollection>::const_iterator
+             it = channel.entries.begin(),
+             end = channel.entries.end();
+         it != end; ++it)
     {
-        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
-            write_embedded_message(group, field_desc, messages, hs);
-            break;
+        // (streaming) everything already written
+        if (!it->second.entries.empty())
+            write_columns(group + "/" + it->first, it->second, **column_set_it++);
+    }
+}
 
-        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
-        {
-            // google uses int for the enum value type, we'll assume that's an int32 here
-            write_field<std::int32_t>(group, field_desc, messages, hs);
-            write_enum_attributes(group, field_desc);
-            break;
-        }
+void goby::middleware::hdf5::Writer::write_message_collection(
+    const std::string& group, const goby::middleware::hdf5::MessageCollection& message_collection)
+{
+    auto column_set = extract(
+        plan(message_collection.entries.begin()->second->GetDescriptor()), message_collection);
+    write_columns(group, message_collection, *column_set);
+}
 
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
-            write_field<std::int32_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
-            write_field<std::int64_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
-            write_field<std::uint32_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
-            write_field<std::uint64_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
-            write_field<unsigned char>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
-            if (app_cfg().include_string_fields())
-                write_field<std::string>(group, field_desc, messages, hs);
-            else
-                // placeholder for users to know that the field exists, even if the data are omitted
-                write_vector(group, field_desc->name(), std::vector<unsigned char>(),
-                             std::vector<hsize_t>(1, 0), (unsigned char)0);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
-            write_field<float>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
-            write_field<double>(group, field_desc, messages, hs);
-            break;
-    }
+void goby::middleware::hdf5::Writer::write_columns(
+    const std::string& group, const goby::middleware::hdf5::MessageCollection& message_collection,
+    ColumnSet& column_set)
+{
+    write_time(group, message_collection);
+    for (auto& column : column_set.columns()) column->write(*this, group, column_set);
+}
+
+const goby::middleware::hdf5::MessagePlan&
+goby::middleware::hdf5::Writer::plan(const google::protobuf::Descriptor* desc)
+{
+    auto it = plans_.find(desc);
+    if (it == plans_.end())
+        it = plans_
+                 .insert(std::make_pair(desc, std::unique_ptr<MessagePlan>(new MessagePlan(
+                                                  desc, app_cfg().include_string_fields()))))
+                 .first;
+    return *it->second;
+}
+
+std::unique_ptr<goby::middleware::hdf5::ColumnSet> goby::middleware::hdf5::Writer::extract(
+    const MessagePlan& plan, const goby::middleware::hdf5::MessageCollection& message_collection)
+{
+    std::unique_ptr<ColumnSet> column_set(new ColumnSet(plan));
+    for (const auto& entry : message_collection.entries) column_set->add_message(*entry.second);
+    return column_set;
 }
 
 void goby::middleware::hdf5::Writer::write_enum_attributes(
@@ -334,6 +302,10 @@ void goby::middleware::hdf5::Writer::write_enum_attributes(
     H5::Group& grp = group_factory_.fetch_group(group);
     H5::DataSet ds = grp.openDataSet(field_desc->name());
 
+    // (streaming) written with the first chunk
+    if (H5Aexists(ds.getId(), "enum_names") > 0)
+        return;
+
     const google::protobuf::EnumDescriptor* enum_desc = field_desc->enum_type();
 
     std::vector<const char*> names(enum_desc->value_count(), (const char*)(0));
@@ -400,13 +372,25 @@ void goby::middleware::hdf5::Writer::write_vector(const std::string& group,
     std::vector<const char*> data_c_str;
     for (unsigned i = 0, n = data.size(); i < n; ++i) data_c_str.push_back(data[i].c_str());
 
-    H5::DataSpace dataspace(hs.size(), hs.data(), hs.data());
     H5::StrType datatype(H5::PredType::C_S1, H5T_VARIABLE);
     H5::Group& grp = group_factory_.fetch_group(group);
-    H5::DataSet dataset = grp.createDataSet(dataset_name, datatype, dataspace);
+    H5::DataSet dataset;
+    if (app_cfg().streaming())
+    {
+        // the fill value of a variable length string is an empty string
+        if (!append_vector(grp, dataset_name, datatype,
+                           data_c_str.size() ? data_c_str.data() : nullptr, hs, nullptr,
+                           &dataset))
+            return;
+    }
+    else
+    {
+        H5::DataSpace dataspace(hs.size(), hs.data(), hs.data());
+        dataset = grp.createDataSet(dataset_name, datatype, dataspace);
 
-    if (data_c_str.size())
-        dataset.write(data_c_str.data(), datatype);
+        if (data_c_str.size())
+            dataset.write(data_c_str.data(), datatype);
+    }
 
     const int rank = 1;
     hsize_t att_hs[] = {1};
@@ -416,3 +400,55 @@ void goby::middleware::hdf5::Writer::write_vector(const std::string& group,
     const H5std_string strbuf(default_value);
     att.write(att_datatype, strbuf);
 }
+
+bool goby::middleware::hdf5::Writer::append_vector(H5::Group& grp, const std::string& dataset_name,
+                                                   const H5::DataType& datatype, const void* data,
+                                                   const std::vector<hsize_t>& hs,
+                                                   const void* fill_value, H5::DataSet* dataset)
+{
+    bool created = false;
+    std::vector<hsize_t> dims(hs.size(), 0);
+    if (H5Lexists(grp.getId(), dataset_name.c_str(), H5P_DEFAULT) > 0)
+    {
+        *dataset = grp.openDataSet(dataset_name);
+        H5::DataSpace dataspace = dataset->getSpace();
+        if (dataspace.getSimpleExtentNdims() != static_cast<int>(hs.size()))
+            glog.is(DIE) && glog << "Dimensions of " << dataset_name << " changed" << std::endl;
+        dataspace.getSimpleExtentDims(dims.data());
+    }
+    else
+    {
+        std::vector<hsize_t> max_dims(hs.size(), H5S_UNLIMITED);
+        std::vector<hsize_t> chunk_dims(hs);
+        chunk_dims[0] = app_cfg().chunk_size();
+        for (auto& d : chunk_dims) d = std::max<hsize_t>(d, 1);
+
+        H5::DSetCreatPropList props;
+        props.setChunk(chunk_dims.size(), chunk_dims.data());
+        if (fill_value)
+            props.setFillValue(datatype, fill_value);
+        if (app_cfg().compression_level() > 0)
+            props.setDeflate(app_cfg().compression_level());
+
+        H5::DataSpace dataspace(dims.size(), dims.data(), max_dims.data());
+        *dataset = grp.createDataSet(dataset_name, datatype, dataspace, props);
+        created = true;
+    }
+
+    std::vector<hsize_t> new_dims(dims);
+    new_dims[0] += hs[0];
+    for (std::size_t i = 1, n = hs.size(); i < n; ++i) new_dims[i] = std::max(dims[i], hs[i]);
+    dataset->extend(new_dims.data());
+
+    bool empty = std::find(hs.begin(), hs.end(), 0) != hs.end();
+    if (data && !empty)
+    {
+        std::vector<hsize_t> offset(hs.size(), 0);
+        offset[0] = dims[0];
+        H5::DataSpace file_space = dataset->getSpace();
+        file_space.selectHyperslab(H5S_SELECT_SET, hs.data(), offset.data());
+        H5::DataSpace mem_space(hs.size(), hs.data());
+        dataset->write(data, datatype, mem_space, file_space);
+    }
+    return created;
+}
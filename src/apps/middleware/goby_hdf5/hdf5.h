@@ -31,8 +31,8 @@
 #include "goby/middleware/protobuf/hdf5.pb.h"
 #include "goby/util/binary.h"
 
+#include "hdf5_columns.h"
 #include "hdf5_predicate.h"
-#include "hdf5_protobuf_values.h"
 
 namespace goby
 {
@@ -54,7 +54,8 @@ struct Channel
     Channel(const std::string& n) : name(n) {}
     std::string name;
 
-    void add_message(const goby::middleware::HDF5ProtobufEntry& entry);
+    /// \return the collection the message was added to
+    MessageCollection& add_message(const goby::middleware::HDF5ProtobufEntry& entry);
 
     // message name -> hdf5::Message
     std::map<std::string, MessageCollection> entries;
@@ -99,31 +100,29 @@ class Writer : public goby::middleware::Application<goby::middleware::protobuf::
     void load();
     void collect();
     void write();
-    void write_channel(const std::string& group, const goby::middleware::hdf5::Channel& channel);
+    // collect() and write() a chunk at a time (streaming mode)
+    void collect_and_write();
+    void write_channel(const std::string& group, const goby::middleware::hdf5::Channel& channel,
+                       std::vector<std::unique_ptr<ColumnSet>>& column_sets);
     void
     write_message_collection(const std::string& group,
                              const goby::middleware::hdf5::MessageCollection& message_collection);
+    void write_columns(const std::string& group,
+                       const goby::middleware::hdf5::MessageCollection& message_collection,
+                       ColumnSet& column_set);
+
+    // built on first use (from the main thread only)
+    const MessagePlan& plan(const google::protobuf::Descriptor* desc);
+    // may be called from any thread
+    static std::unique_ptr<ColumnSet>
+    extract(const MessagePlan& plan,
+            const goby::middleware::hdf5::MessageCollection& message_collection);
     void write_time(const std::string& group,
                     const goby::middleware::hdf5::MessageCollection& message_collection);
 
-    void write_field_selector(const std::string& group,
-                              const google::protobuf::FieldDescriptor* field_desc,
-                              const std::vector<const google::protobuf::Message*>& messages,
-                              std::vector<hsize_t>& hs);
-
     void write_enum_attributes(const std::string& group,
                                const google::protobuf::FieldDescriptor* field_desc);
 
-    template <typename T>
-    void write_field(const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-                     const std::vector<const google::protobuf::Message*>& messages,
-                     std::vector<hsize_t>& hs);
-
-    void write_embedded_message(const std::string& group,
-                                const google::protobuf::FieldDescriptor* field_desc,
-                                const std::vector<const google::protobuf::Message*> messages,
-                                std::vector<hsize_t>& hs);
-
     template <typename T>
     void write_vector(const std::string& group, const std::string dataset_name,
                       const std::vector<T>& data, const std::vector<hsize_t>& hs,
@@ -133,11 +132,24 @@ class Writer : public goby::middleware::Application<goby::middleware::protobuf::
                       const std::vector<std::string>& data, const std::vector<hsize_t>& hs,
                       const std::string& default_value);
 
+    // streaming mode: append data (of dimensions hs) along the first dimension of the dataset,
+    // creating it if needed (returns true if created), and growing the other dimensions if hs
+    // is larger. Values not written (padding) are fill_value (if set).
+    bool append_vector(H5::Group& grp, const std::string& dataset_name,
+                       const H5::DataType& datatype, const void* data,
+                       const std::vector<hsize_t>& hs, const void* fill_value,
+                       H5::DataSet* dataset);
+
     void run() {}
 
+    template <typename T> friend class Column;
+    friend class PlaceholderColumn;
+
   private:
     std::shared_ptr<goby::middleware::HDF5Plugin> plugin_;
 
+    std::map<const google::protobuf::Descriptor*, std::unique_ptr<MessagePlan> > plans_;
+
     // channel name -> hdf5::Channel
     std::map<std::string, goby::middleware::hdf5::Channel> channels_;
     H5::H5File h5file_;
@@ -146,84 +158,73 @@ class Writer : public goby::middleware::Application<goby::middleware::protobuf::
 };
 
 template <typename T>
-void Writer::write_field(const std::string& group,
-                         const google::protobuf::FieldDescriptor* field_desc,
-                         const std::vector<const google::protobuf::Message*>& messages,
-                         std::vector<hsize_t>& hs)
+void Writer::write_vector(const std::string& group, const std::string dataset_name,
+                          const std::vector<T>& data, const std::vector<hsize_t>& hs,
+                          const T& default_value)
 {
-    if (field_desc->is_repeated())
+    H5::Group& grp = group_factory_.fetch_group(group);
+    H5::DataSet dataset;
+    if (app_cfg().streaming())
     {
-        // pass one to figure out field size
-        int max_field_size = 0;
-        for (unsigned i = 0, n = messages.size(); i < n; ++i)
-        {
-            if (messages[i])
-            {
-                const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                int field_size = refl->FieldSize(*messages[i], field_desc);
-                if (field_size > max_field_size)
-                    max_field_size = field_size;
-            }
-        }
-
-        hs.push_back(max_field_size);
-
-        std::vector<T> values(messages.size() * max_field_size, retrieve_empty_value<T>());
+        T fill_value = retrieve_empty_value<T>();
+        // attributes were written with the first chunk
+        if (!append_vector(grp, dataset_name, predicate<T>(), data.size() ? &data[0] : nullptr,
+                           hs, &fill_value, &dataset))
+            return;
+    }
+    else
+    {
+        H5::DataSpace dataspace(hs.size(), hs.data(), hs.data());
+        dataset = grp.createDataSet(dataset_name, predicate<T>(), dataspace);
+        if (data.size())
+            dataset.write(&data[0], predicate<T>());
+    }
 
-        for (unsigned i = 0, n = messages.size(); i < n; ++i)
-        {
-            if (messages[i])
-            {
-                const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                int field_size = refl->FieldSize(*messages[i], field_desc);
-                for (int j = 0; j < field_size; ++j)
-                    retrieve_repeated_value<T>(&values[i * max_field_size + j], j,
-                                               PBMeta(refl, field_desc, (*messages[i])));
-            }
-        }
+    const int rank = 1;
+    hsize_t att_hs[] = {1};
+    H5::DataSpace att_space(rank, att_hs, att_hs);
+    H5::Attribute att = dataset.createAttribute("default_value", predicate<T>(), att_space);
+    att.write(predicate<T>(), &default_value);
+}
 
-        T default_value;
-        retrieve_default_value(&default_value, field_desc);
+template <typename T>
+void Column<T>::write(Writer& writer, const std::string& group, const ColumnSet& columns)
+{
+    std::vector<hsize_t> hs;
+    std::vector<std::size_t> indices;
+    columns.layout(field(), &hs, &indices);
 
-        write_vector(group, field_desc->name(), values, hs, default_value);
+    T default_value;
+    retrieve_default_value(&default_value, field().field_desc);
 
-        hs.pop_back();
+    if (field().levels.empty())
+    {
+        // not repeated, so already one value per message
+        writer.write_vector(group + field().group, field().field_desc->name(), values_, hs,
+                            default_value);
     }
     else
     {
-        std::vector<T> values(messages.size(), retrieve_empty_value<T>());
-        for (unsigned i = 0, n = messages.size(); i < n; ++i)
-        {
-            if (messages[i])
-            {
-                const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                retrieve_single_value<T>(&values[i], PBMeta(refl, field_desc, (*messages[i])));
-            }
-        }
-
-        T default_value;
-        retrieve_default_value(&default_value, field_desc);
-
-        write_vector(group, field_desc->name(), values, hs, default_value);
+        hsize_t size = 1;
+        for (auto h : hs) size *= h;
+        std::vector<T> data(size, retrieve_empty_value<T>());
+        for (std::size_t i = 0, n = indices.size(); i < n; ++i)
+            data[indices[i]] = std::move(values_[i]);
+        writer.write_vector(group + field().group, field().field_desc->name(), data, hs,
+                            default_value);
     }
+    values_.clear();
+
+    if (field().field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_ENUM)
+        writer.write_enum_attributes(group + field().group, field().field_desc);
 }
 
-template <typename T>
-void Writer::write_vector(const std::string& group, const std::string dataset_name,
-                          const std::vector<T>& data, const std::vector<hsize_t>& hs,
-                          const T& default_value)
+inline void PlaceholderColumn::write(Writer& writer, const std::string& group,
+                                     const ColumnSet& columns)
 {
-    H5::DataSpace dataspace(hs.size(), hs.data(), hs.data());
-    H5::Group& grp = group_factory_.fetch_group(group);
-    H5::DataSet dataset = grp.createDataSet(dataset_name, predicate<T>(), dataspace);
-    if (data.size())
-        dataset.write(&data[0], predicate<T>());
-
-    const int rank = 1;
-    hsize_t att_hs[] = {1};
-    H5::DataSpace att_space(rank, att_hs, att_hs);
-    H5::Attribute att = dataset.createAttribute("default_value", predicate<T>(), att_space);
-    att.write(predicate<T>(), &default_value);
+    // placeholder for users to know that the field exists, even if the data are omitted
+    writer.write_vector(group + field().group, field().field_desc->name(),
+                        std::vector<unsigned char>(), std::vector<hsize_t>(1, 0), (unsigned char)0);
 }
 } // namespace hdf5
 } // namespace middleware
@@ -0,0 +1,362 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBYHDF5COLUMNS20261018H
+#define GOBYHDF5COLUMNS20261018H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "H5Cpp.h"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include "hdf5_protobuf_values.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace hdf5
+{
+class Writer;
+class ColumnSet;
+
+/// \brief How to extract one field (and, for embedded messages, all of its fields) from a
+/// message: built once per message type
+struct FieldPlan
+{
+    const google::protobuf::FieldDescriptor* field_desc{nullptr};
+    // relative to the group of the top-level message (embedded messages are subgroups)
+    std::string group;
+    // embedded message: its fields
+    std::vector<FieldPlan> fields;
+    // string field that is omitted (!include_string_fields): only an empty dataset is written
+    bool placeholder{false};
+    // all other fields that are not embedded messages: index into ColumnSet::columns()
+    int column{-1};
+    // repeated fields: index of the extra dimension this field adds
+    int level{-1};
+    // columns: the dimensions (levels) after the first (message) dimension, outermost first
+    std::vector<int> levels;
+};
+
+/// \brief All the columns (datasets) of a message type, flattened from the embedded messages
+class MessagePlan
+{
+  public:
+    MessagePlan(const google::protobuf::Descriptor* desc, bool include_string_fields)
+        : include_string_fields_(include_string_fields)
+    {
+        std::vector<int> levels;
+        add_fields(desc, "", levels, fields_);
+        add_columns(fields_);
+    }
+
+    const std::vector<FieldPlan>& fields() const { return fields_; }
+    /// \brief Fields that are written as a dataset, in the order they are written
+    const std::vector<const FieldPlan*>& columns() const { return columns_; }
+    int level_count() const { return level_count_; }
+
+  private:
+    void add_fields(const google::protobuf::Descriptor* desc, const std::string& group,
+                    std::vector<int>& levels, std::vector<FieldPlan>& fields);
+    void add_columns(const std::vector<FieldPlan>& fields);
+
+  private:
+    bool include_string_fields_;
+    std::vector<FieldPlan> fields_;
+    std::vector<const FieldPlan*> columns_;
+    int column_count_{0};
+    int level_count_{0};
+};
+
+/// \brief Values of one field, appended message by message
+class ColumnBase
+{
+  public:
+    ColumnBase(const FieldPlan& field) : field_(field) {}
+    virtual ~ColumnBase() = default;
+
+    virtual void add_single(const google::protobuf::Reflection* refl,
+                            const google::protobuf::Message& msg) = 0;
+    virtual void add_repeated(const google::protobuf::Reflection* refl,
+                              const google::protobuf::Message& msg, int size) = 0;
+
+    /// \brief Pads the values to a dense array and writes them to group + field().group
+    virtual void write(Writer& writer, const std::string& group, const ColumnSet& columns) = 0;
+
+    const FieldPlan& field() const { return field_; }
+
+  private:
+    const FieldPlan& field_;
+};
+
+template <typename T> class Column : public ColumnBase
+{
+  public:
+    Column(const FieldPlan& field) : ColumnBase(field) {}
+
+    void add_single(const google::protobuf::Reflection* refl,
+                    const google::protobuf::Message& msg) override
+    {
+        values_.emplace_back();
+        retrieve_single_value<T>(&values_.back(), PBMeta(refl, field().field_desc, msg));
+    }
+
+    void add_repeated(const google::protobuf::Reflection* refl,
+                      const google::protobuf::Message& msg, int size) override
+    {
+        auto offset = values_.size();
+        values_.resize(offset + size);
+        for (int i = 0; i < size; ++i)
+            retrieve_repeated_value<T>(&values_[offset + i], i,
+                                       PBMeta(refl, field().field_desc, msg));
+    }
+
+    // defined in hdf5.h
+    void write(Writer& writer, const std::string& group, const ColumnSet& columns) override;
+
+  private:
+    std::vector<T> values_;
+};
+
+/// \brief Omitted string field
+class PlaceholderColumn : public ColumnBase
+{
+  public:
+    PlaceholderColumn(const FieldPlan& field) : ColumnBase(field) {}
+
+    void add_single(const google::protobuf::Reflection* refl,
+                    const google::protobuf::Message& msg) override
+    {
+    }
+    void add_repeated(const google::protobuf::Reflection* refl,
+                      const google::protobuf::Message& msg, int size) override
+    {
+    }
+
+    // defined in hdf5.h
+    void write(Writer& writer, const std::string& group, const ColumnSet& columns) override;
+};
+
+/// \brief The columns of a collection of messages of one type, filled in a single pass over the
+/// messages using a MessagePlan
+///
+/// Repeated fields are stored as they are read (ragged); the sizes of each repeated field are
+/// kept (once for all of the columns within a repeated embedded message) so that each column can
+/// be padded to the largest size when it is written.
+class ColumnSet
+{
+  public:
+    ColumnSet(const MessagePlan& plan) : plan_(plan), sizes_(plan.level_count())
+    {
+        max_sizes_.resize(plan.level_count(), 0);
+        for (const FieldPlan* field : plan.columns()) columns_.push_back(make_column(*field));
+    }
+
+    void add_message(const google::protobuf::Message& msg)
+    {
+        add_fields(plan_.fields(), msg);
+        ++rows_;
+    }
+
+    /// \brief Number of messages added
+    hsize_t rows() const { return rows_; }
+    std::vector<std::unique_ptr<ColumnBase>>& columns() { return columns_; }
+
+    /// \brief The dimensions of a column, and the index into that (row-major) array of each value
+    /// added to the column
+    void layout(const FieldPlan& field, std::vector<hsize_t>* hs,
+                std::vector<std::size_t>* indices) const;
+
+  private:
+    static std::unique_ptr<ColumnBase> make_column(const FieldPlan& field);
+    void add_fields(const std::vector<FieldPlan>& fields, const google::protobuf::Message& msg);
+    void add_size(int level, int size)
+    {
+        sizes_[level].push_back(size);
+        if (size > max_sizes_[level])
+            max_sizes_[level] = size;
+    }
+
+  private:
+    const MessagePlan& plan_;
+    std::vector<std::unique_ptr<ColumnBase>> columns_;
+    hsize_t rows_{0};
+    // level -> size of the repeated field, for each time it was read
+    std::vector<std::vector<int>> sizes_;
+    std::vector<int> max_sizes_;
+};
+
+inline void MessagePlan::add_fields(const google::protobuf::Descriptor* desc,
+                                    const std::string& group, std::vector<int>& levels,
+                                    std::vector<FieldPlan>& fields)
+{
+    for (int i = 0, n = desc->field_count(); i < n; ++i)
+    {
+        FieldPlan field;
+        field.field_desc = desc->field(i);
+        field.group = group;
+
+        if (field.field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_STRING &&
+            !include_string_fields_)
+        {
+            field.placeholder = true;
+            field.column = column_count_++;
+            fields.push_back(std::move(field));
+            continue;
+        }
+
+        field.levels = levels;
+        if (field.field_desc->is_repeated())
+        {
+            field.level = level_count_++;
+            field.levels.push_back(field.level);
+        }
+
+        if (field.field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            add_fields(field.field_desc->message_type(), group + "/" + field.field_desc->name(),
+                       field.levels, field.fields);
+        else
+            field.column = column_count_++;
+
+        fields.push_back(std::move(field));
+    }
+}
+
+inline void MessagePlan::add_columns(const std::vector<FieldPlan>& fields)
+{
+    // same (depth-first) order as the column indices were assigned by add_fields(); fields_ is
+    // complete, so these pointers remain valid
+    for (const FieldPlan& field : fields)
+    {
+        if (field.field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            add_columns(field.fields);
+        else
+            columns_.push_back(&field);
+    }
+}
+
+inline std::unique_ptr<ColumnBase> ColumnSet::make_column(const FieldPlan& field)
+{
+    if (field.placeholder)
+        return std::unique_ptr<ColumnBase>(new PlaceholderColumn(field));
+
+    switch (field.field_desc->cpp_type())
+    {
+        // google uses int for the enum value type, we'll assume that's an int32 here
+        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+            return std::unique_ptr<ColumnBase>(new Column<std::int32_t>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+            return std::unique_ptr<ColumnBase>(new Column<std::int64_t>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+            return std::unique_ptr<ColumnBase>(new Column<std::uint32_t>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+            return std::unique_ptr<ColumnBase>(new Column<std::uint64_t>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            return std::unique_ptr<ColumnBase>(new Column<unsigned char>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+            return std::unique_ptr<ColumnBase>(new Column<std::string>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+            return std::unique_ptr<ColumnBase>(new Column<float>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+            return std::unique_ptr<ColumnBase>(new Column<double>(field));
+        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE: break;
+    }
+    return nullptr;
+}
+
+inline void ColumnSet::add_fields(const std::vector<FieldPlan>& fields,
+                                  const google::protobuf::Message& msg)
+{
+    const google::protobuf::Reflection* refl = msg.GetReflection();
+    for (const FieldPlan& field : fields)
+    {
+        if (field.placeholder)
+            continue;
+
+        const google::protobuf::FieldDescriptor* field_desc = field.field_desc;
+        if (field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+        {
+            if (field_desc->is_repeated())
+            {
+                int size = refl->FieldSize(msg, field_desc);
+                add_size(field.level, size);
+                for (int i = 0; i < size; ++i)
+                    add_fields(field.fields, refl->GetRepeatedMessage(msg, field_desc, i));
+            }
+            else
+            {
+                add_fields(field.fields, refl->GetMessage(msg, field_desc));
+            }
+        }
+        else if (field_desc->is_repeated())
+        {
+            int size = refl->FieldSize(msg, field_desc);
+            add_size(field.level, size);
+            columns_[field.column]->add_repeated(refl, msg, size);
+        }
+        else
+        {
+            columns_[field.column]->add_single(refl, msg);
+        }
+    }
+}
+
+inline void ColumnSet::layout(const FieldPlan& field, std::vector<hsize_t>* hs,
+                              std::vector<std::size_t>* indices) const
+{
+    hs->assign(1, rows_);
+    for (int level : field.levels) hs->push_back(max_sizes_[level]);
+
+    indices->clear();
+    if (field.levels.empty())
+        return;
+
+    // row-major strides
+    std::vector<std::size_t> strides(hs->size(), 1);
+    for (int i = strides.size() - 2; i >= 0; --i) strides[i] = strides[i + 1] * (*hs)[i + 1];
+
+    // walk the recorded sizes in the order they were read
+    std::vector<std::size_t> cursors(field.levels.size(), 0);
+    std::function<void(std::size_t, std::size_t)> place = [&](std::size_t depth,
+                                                                std::size_t base) {
+        if (depth == field.levels.size())
+        {
+            indices->push_back(base);
+            return;
+        }
+        int size = sizes_[field.levels[depth]][cursors[depth]++];
+        for (int i = 0; i < size; ++i) place(depth + 1, base + i * strides[depth + 1]);
+    };
+    for (hsize_t row = 0; row < rows_; ++row) place(0, row * strides[0]);
+}
+
+} // namespace hdf5
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -19,9 +19,18 @@
 // You should have received a copy of the GNU General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 #include "goby/middleware/application/interface.h"
 
 #include "goby/middleware/log.h"
+#include "goby/middleware/log/mapped_log_reader.h"
+#include "goby/middleware/marshalling/dccl.h"
 #include "goby/middleware/protobuf/log_tool_config.pb.h"
 
 #include "goby/middleware/log/dccl_log_plugin.h"
@@ -49,6 +58,30 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
     // never gets called
     void run() override {}
 
+    // return the size of the input log in bytes (the whole file in both modes, so that their
+    // throughputs can be compared)
+    std::uint64_t read_sequential();
+    std::uint64_t read_indexed();
+    bool filter_match(const std::string& group, const std::string& type);
+    void write_entry(goby::middleware::log::LogEntry& log_entry);
+    void format_entry(goby::middleware::log::LogEntry& log_entry, std::ostream& out);
+    void report_throughput(std::uint64_t bytes);
+
+    // with threads > 1, the main thread reads entries into batches, worker threads format each
+    // batch, and a writer thread writes the formatted batches in file order
+    struct Batch
+    {
+        std::vector<goby::middleware::log::LogEntry> entries;
+        std::string output;
+        bool formatted{false};
+    };
+    void start_pipeline();
+    void submit_batch();
+    void drain_pipeline();
+    void stop_pipeline();
+    void run_worker();
+    void run_writer();
+
     // dynamically loaded libraries
     std::vector<void*> dl_handles_;
 
@@ -57,6 +90,22 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
 
     std::ifstream f_in_;
     std::ofstream f_out_;
+
+    std::chrono::steady_clock::time_point start_{std::chrono::steady_clock::now()};
+    std::uint64_t entries_written_{0};
+
+    bool pipelined_{false};
+    std::unique_ptr<Batch> batch_;
+    std::mutex pipeline_mutex_;
+    std::condition_variable pipeline_cv_;
+    // all submitted batches not yet written, in file order
+    std::deque<std::shared_ptr<Batch>> batches_;
+    // submitted batches not yet claimed by a worker
+    std::deque<std::shared_ptr<Batch>> work_;
+    int unformatted_{0};
+    bool stopping_{false};
+    std::vector<std::thread> workers_;
+    std::thread writer_;
 };
 } // namespace middleware
 }
@@ -81,47 +130,72 @@ goby::apps::middleware::LogTool::LogTool()
 
     for (auto& p : plugins_) p.second->register_read_hooks(f_in_);
 
+    if (app_cfg().threads() > 1)
+        start_pipeline();
+
+    auto input_bytes = app_cfg().use_index() ? read_indexed() : read_sequential();
+
+    if (pipelined_)
+        stop_pipeline();
+    f_out_.flush();
+    report_throughput(input_bytes);
+
+    quit();
+}
+
+bool goby::apps::middleware::LogTool::filter_match(const std::string& group,
+                                                   const std::string& type)
+{
+    auto match = [](const google::protobuf::RepeatedPtrField<std::string>& allowed,
+                    const std::string& value) {
+        return allowed.empty() ||
+               std::find(allowed.begin(), allowed.end(), value) != allowed.end();
+    };
+    return match(app_cfg().group(), group) && match(app_cfg().type(), type);
+}
+
+std::uint64_t goby::apps::middleware::LogTool::read_sequential()
+{
+    // skip compressed blocks that have none of the requested groups without decompressing them
+    if (!app_cfg().group().empty())
+    {
+        goby::middleware::log::LogEntry::block_filter =
+            [this](const goby::middleware::log::LogBlockHeader& header) {
+                for (const auto& group : goby::middleware::log::LogEntry::block_groups(header))
+                {
+                    if (std::find(app_cfg().group().begin(), app_cfg().group().end(), group) !=
+                        app_cfg().group().end())
+                        return true;
+                }
+                return false;
+            };
+    }
+
+    // new Protobuf descriptors must not be added while the workers are decoding
+    if (pipelined_)
+    {
+        for (auto& hook : goby::middleware::log::LogEntry::filter_hook)
+        {
+            auto add_types = hook.second;
+            hook.second = [this, add_types](const std::vector<unsigned char>& data) {
+                drain_pipeline();
+                add_types(data);
+            };
+        }
+    }
+
+    f_in_.seekg(0, std::ios::end);
+    std::streamoff input_bytes = std::max<std::streamoff>(f_in_.tellg(), 0);
+    f_in_.seekg(0, std::ios::beg);
+
     while (true)
     {
         try
         {
             goby::middleware::log::LogEntry log_entry;
             log_entry.parse(&f_in_);
-            try
-            {
-                auto plugin = plugins_.find(log_entry.scheme());
-                if (plugin == plugins_.end())
-                    throw(goby::middleware::log::LogException("No plugin available for scheme: " +
-                                            std::to_string(log_entry.scheme())));
-
-                switch (app_cfg().format())
-                {
-                    case protobuf::LogToolConfig::DEBUG_TEXT:
-                    {
-                        auto debug_text_msg = plugin->second->debug_text_message(log_entry);
-                        f_out_ << log_entry.scheme() << " | " << log_entry.group() << " | "
-                               << log_entry.type() << " | " << debug_text_msg << std::endl;
-                        break;
-                    }
-                }
-            }
-
-            catch (goby::middleware::log::LogException& e)
-            {
-                glog.is_warn() && glog << "Failed to parse message (scheme: " << log_entry.scheme()
-                                       << ", group: " << log_entry.group()
-                                       << ", type: " << log_entry.type() << std::endl;
-
-                switch (app_cfg().format())
-                {
-                    case protobuf::LogToolConfig::DEBUG_TEXT:
-                        f_out_ << log_entry.scheme() << " | " << log_entry.group() << " | "
-                               << log_entry.type() << " | "
-                               << "Unable to parse message of " << log_entry.data().size()
-                               << " bytes. Reason: " << e.what() << std::endl;
-                        break;
-                }
-            }
+            if (filter_match(log_entry.group(), log_entry.type()))
+                write_entry(log_entry);
         }
         catch (goby::middleware::log::LogException& e)
         {
@@ -136,5 +210,219 @@ goby::apps::middleware::LogTool::LogTool()
             break;
         }
     }
-    quit();
+
+    return input_bytes;
+}
+
+std::uint64_t goby::apps::middleware::LogTool::read_indexed()
+{
+    std::unique_ptr<goby::middleware::log::MappedLogReader> reader;
+    try
+    {
+        reader.reset(new goby::middleware::log::MappedLogReader(app_cfg().input_file()));
+    }
+    catch (goby::middleware::log::LogException& e)
+    {
+        glog.is_die() && glog << "Failed to index input log: " << e.what() << std::endl;
+    }
+
+    // merge the matching (scheme, group, type) lists back into file order
+    std::vector<std::size_t> indices;
+    for (const auto& filter : reader->filters())
+    {
+        if (filter_match(filter.group, filter.type))
+        {
+            const auto& matches = reader->find(filter.scheme, filter.group, filter.type);
+            indices.insert(indices.end(), matches.begin(), matches.end());
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+
+    glog.is_verbose() && glog << "Writing " << indices.size() << " of " << reader->size()
+                              << " entries" << std::endl;
+
+    for (auto i : indices)
+    {
+        auto log_entry = reader->entry(i);
+        write_entry(log_entry);
+    }
+
+    return reader->file_size();
+}
+
+void goby::apps::middleware::LogTool::write_entry(goby::middleware::log::LogEntry& log_entry)
+{
+    ++entries_written_;
+    if (!pipelined_)
+    {
+        format_entry(log_entry, f_out_);
+        return;
+    }
+
+    if (!batch_)
+        batch_.reset(new Batch);
+    batch_->entries.push_back(std::move(log_entry));
+    if (batch_->entries.size() >= app_cfg().batch_size())
+        submit_batch();
+}
+
+void goby::apps::middleware::LogTool::format_entry(goby::middleware::log::LogEntry& log_entry,
+                                                   std::ostream& out)
+{
+    try
+    {
+        auto plugin = plugins_.find(log_entry.scheme());
+        if (plugin == plugins_.end())
+            throw(goby::middleware::log::LogException("No plugin available for scheme: " +
+                                                      std::to_string(log_entry.scheme())));
+
+        switch (app_cfg().format())
+        {
+            case protobuf::LogToolConfig::DEBUG_TEXT:
+            {
+                auto debug_text_msg = plugin->second->debug_text_message(log_entry);
+                out << log_entry.scheme() << " | " << log_entry.group() << " | "
+                    << log_entry.type() << " | " << debug_text_msg << "\n";
+                break;
+            }
+        }
+    }
+    catch (goby::middleware::log::LogException& e)
+    {
+        glog.is_warn() && glog << "Failed to parse message (scheme: " << log_entry.scheme()
+                               << ", group: " << log_entry.group()
+                               << ", type: " << log_entry.type() << std::endl;
+
+        switch (app_cfg().format())
+        {
+            case protobuf::LogToolConfig::DEBUG_TEXT:
+                out << log_entry.scheme() << " | " << log_entry.group() << " | "
+                    << log_entry.type() << " | "
+                    << "Unable to parse message of " << log_entry.data().size()
+                    << " bytes. Reason: " << e.what() << "\n";
+                break;
+        }
+    }
+}
+
+void goby::apps::middleware::LogTool::report_throughput(std::uint64_t bytes)
+{
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    if (seconds <= 0)
+        return;
+
+    glog.is_verbose() && glog << "Wrote " << entries_written_ << " entries from a " << bytes
+                              << " byte input log in " << seconds
+                              << " s: " << bytes / seconds / 1.0e6 << " MB/s, "
+                              << entries_written_ / seconds << " entries/s" << std::endl;
+}
+
+void goby::apps::middleware::LogTool::start_pipeline()
+{
+    pipelined_ = true;
+    goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+    // DCCL decodes in each worker concurrently if the DCCL version allows it, otherwise one at a
+    // time
+    try
+    {
+        goby::middleware::DCCLSerializerParserHelperBase::set_codec_mode(
+            goby::middleware::DCCLSerializerParserHelperBase::CodecMode::THREAD_LOCAL);
+    }
+    catch (goby::Exception& e)
+    {
+        glog.is_verbose() && glog << "DCCL decoding is not parallel: " << e.what() << std::endl;
+    }
+
+    for (unsigned i = 0, n = app_cfg().threads(); i < n; ++i)
+        workers_.emplace_back([this]() { run_worker(); });
+    writer_ = std::thread([this]() { run_writer(); });
+}
+
+void goby::apps::middleware::LogTool::submit_batch()
+{
+    if (!batch_)
+        return;
+
+    std::shared_ptr<Batch> batch(batch_.release());
+    std::unique_lock<std::mutex> lock(pipeline_mutex_);
+    // bounds the memory used when the workers or writer can't keep up with the reader
+    pipeline_cv_.wait(lock, [this]() { return batches_.size() < 4 * workers_.size(); });
+    batches_.push_back(batch);
+    work_.push_back(batch);
+    ++unformatted_;
+    pipeline_cv_.notify_all();
+}
+
+void goby::apps::middleware::LogTool::drain_pipeline()
+{
+    submit_batch();
+    std::unique_lock<std::mutex> lock(pipeline_mutex_);
+    pipeline_cv_.wait(lock, [this]() { return unformatted_ == 0; });
+}
+
+void goby::apps::middleware::LogTool::stop_pipeline()
+{
+    submit_batch();
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex_);
+        stopping_ = true;
+    }
+    pipeline_cv_.notify_all();
+
+    for (auto& worker : workers_) worker.join();
+    writer_.join();
+    workers_.clear();
+    pipelined_ = false;
+}
+
+void goby::apps::middleware::LogTool::run_worker()
+{
+    for (;;)
+    {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(pipeline_mutex_);
+            pipeline_cv_.wait(lock, [this]() { return !work_.empty() || stopping_; });
+            if (work_.empty())
+                return;
+            batch = work_.front();
+            work_.pop_front();
+        }
+
+        std::stringstream out;
+        for (auto& log_entry : batch->entries) format_entry(log_entry, out);
+        batch->entries.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline_mutex_);
+            batch->output = out.str();
+            batch->formatted = true;
+            --unformatted_;
+        }
+        pipeline_cv_.notify_all();
+    }
+}
+
+void goby::apps::middleware::LogTool::run_writer()
+{
+    for (;;)
+    {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(pipeline_mutex_);
+            pipeline_cv_.wait(lock, [this]() {
+                return (!batches_.empty() && batches_.front()->formatted) ||
+                       (batches_.empty() && stopping_);
+            });
+            if (batches_.empty())
+                return;
+            batch = batches_.front();
+            batches_.pop_front();
+        }
+        pipeline_cv_.notify_all();
+
+        f_out_.write(batch->output.data(), batch->output.size());
+    }
 }
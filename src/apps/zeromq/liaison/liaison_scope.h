@@ -254,7 +254,7 @@ class ScopeCommsThread : public goby::zeromq::LiaisonCommsThread<LiaisonScope>
     ScopeCommsThread(LiaisonScope* scope, const protobuf::LiaisonConfig& config, int index)
         : LiaisonCommsThread<LiaisonScope>(scope, config, index), scope_(scope)
     {
-        auto subscription_handler = [this](const std::vector<unsigned char>& data, int scheme,
+        auto subscription_handler = [this](goby::middleware::ByteSpan data, int scheme,
                                            const std::string& type,
                                            const goby::middleware::Group& group) {
             std::string gr = group;
@@ -262,7 +262,7 @@ class ScopeCommsThread : public goby::zeromq::LiaisonCommsThread<LiaisonScope>
             {
                 auto pb_msg = dccl::DynamicProtobufManager::new_protobuf_message<
                     std::shared_ptr<google::protobuf::Message> >(type);
-                pb_msg->ParseFromArray(&data[0], data.size());
+                pb_msg->ParseFromArray(data.data(), data.size());
                 scope_->post_to_wt([=]() { scope_->inbox(gr, pb_msg); });
             }
             catch (const std::exception& e)
@@ -20,11 +20,16 @@
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <fstream>
+#include <iomanip>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
 
 #include "goby/middleware/log.h"
+#include "goby/middleware/log/async_log_writer.h"
 #include "goby/middleware/log/dccl_log_plugin.h"
+#include "goby/middleware/log/groups.h"
+#include "goby/middleware/log/log_block_writer.h"
 #include "goby/middleware/log/protobuf_log_plugin.h"
 #include "goby/time.h"
 #include "goby/zeromq/application/single_thread.h"
@@ -45,18 +50,13 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
   public:
     Logger()
         : goby::zeromq::SingleThreadApplication<protobuf::LoggerConfig>(1 *
-                                                                        boost::units::si::hertz),
-          log_file_path_(std::string(cfg().log_dir() + "/" + cfg().interprocess().platform() + "_" +
-                                     goby::time::file_str() + ".goby")),
-          log_(log_file_path_.c_str(), std::ofstream::binary)
+                                                                        boost::units::si::hertz)
     {
-        if (!log_.is_open())
-            glog.is_die() && glog << "Failed to open log in directory: " << cfg().log_dir()
-                                  << std::endl;
+        open_log();
 
-        namespace sp = std::placeholders;
         interprocess().subscribe_regex(
-            std::bind(&Logger::log, this, sp::_1, sp::_2, sp::_3, sp::_4),
+            [this](goby::middleware::ByteSpan data, int scheme, const std::string& type,
+                   const goby::middleware::Group& group) { log(data, scheme, type, group); },
             {goby::middleware::MarshallingScheme::ALL_SCHEMES}, cfg().type_regex(),
             cfg().group_regex());
 
@@ -67,33 +67,70 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
                 glog.is_die() && glog << "Failed to open library: " << lib << std::endl;
             dl_handles_.push_back(lib_handle);
         }
-
-        pb_plugin_.register_write_hooks(log_);
-        dccl_plugin_.register_write_hooks(log_);
     }
 
     ~Logger()
     {
-        log_.close();
-        // set read only
-        chmod(log_file_path_.c_str(), S_IRUSR | S_IRGRP);
-
+        close_log();
+        if (closer_.joinable())
+            closer_.join();
         for (void* handle : dl_handles_) dlclose(handle);
     }
 
-    void log(const std::vector<unsigned char>& data, int scheme, const std::string& type,
+    void log(goby::middleware::ByteSpan data, int scheme, const std::string& type,
              const goby::middleware::Group& group);
     void loop() override
     {
+        if (rotation_due())
+            rotate_log();
+
+        if (block_writer_)
+            block_writer_->flush_if_due();
+        log_->commit_if_due();
+
+        auto status = log_->status();
+        if (block_writer_)
+        {
+            status.set_compressed_blocks(block_writer_->blocks_written());
+            status.set_uncompressed_bytes(block_writer_->uncompressed_bytes());
+            status.set_compressed_bytes(block_writer_->compressed_bytes());
+        }
+        interprocess().publish<goby::middleware::groups::logger_status>(status);
+
         if (do_quit)
             quit();
     }
 
     static std::atomic<bool> do_quit;
 
+  private:
+    void open_log();
+    void close_log();
+    void rotate_log();
+    static void close_log_file(goby::middleware::log::AsyncLogWriter& log,
+                               const std::string& log_file_path);
+    bool rotation_due() const
+    {
+        if (!cfg().has_rotation())
+            return false;
+
+        const auto& rotation = cfg().rotation();
+        return (rotation.max_bytes() > 0 && log_->size() >= rotation.max_bytes()) ||
+               (rotation.max_duration_s() > 0 &&
+                std::chrono::steady_clock::now() >=
+                    segment_start_ + std::chrono::seconds(rotation.max_duration_s()));
+    }
+
   private:
     std::string log_file_path_;
-    std::ofstream log_;
+    // with rotation, the number of the current file
+    int segment_{0};
+    std::chrono::steady_clock::time_point segment_start_;
+    std::unique_ptr<goby::middleware::log::AsyncLogWriter> log_;
+    // only if compression is configured
+    std::unique_ptr<goby::middleware::log::LogBlockWriter> block_writer_;
+    // closes the previous file after a rotation
+    std::thread closer_;
 
     std::vector<void*> dl_handles_;
 
@@ -137,13 +174,106 @@ int main(int argc, char* argv[])
 
 void signal_handler(int sig) { goby::apps::zeromq::Logger::do_quit = true; }
 
-void goby::apps::zeromq::Logger::log(const std::vector<unsigned char>& data, int scheme,
-                               const std::string& type, const goby::middleware::Group& group)
+void goby::apps::zeromq::Logger::log(goby::middleware::ByteSpan data, int scheme,
+                                     const std::string& type,
+                                     const goby::middleware::Group& group)
 {
+    // recorded with the entry (log version 3 and newer)
+    auto received = goby::time::SystemClock::now();
+
     glog.is_debug1() && glog << "Received " << data.size()
                              << " bytes to log to [scheme, type, group] = [" << scheme << ", "
                              << type << ", " << group << "]" << std::endl;
 
-    goby::middleware::log::LogEntry entry(data, scheme, type, group);
-    entry.serialize(&log_);
+    // drop rather than block if the disk has fallen behind
+    if (!log_->accept_entry())
+    {
+        glog.is_debug1() && glog << "Dropped entry: writer queue is full" << std::endl;
+        return;
+    }
+
+    // the only copy of the received data
+    goby::middleware::log::LogEntry entry(data.to_vector(), scheme, type, group, received);
+    if (block_writer_)
+        block_writer_->write(entry);
+    else
+        entry.serialize(log_.get());
+    log_->commit_if_due();
+}
+
+void goby::apps::zeromq::Logger::open_log()
+{
+    log_file_path_ =
+        cfg().log_dir() + "/" + cfg().interprocess().platform() + "_" + goby::time::file_str();
+    if (cfg().has_rotation())
+    {
+        std::stringstream segment;
+        segment << std::setw(4) << std::setfill('0') << segment_;
+        log_file_path_ += "_" + segment.str();
+    }
+    log_file_path_ += ".goby";
+    segment_start_ = std::chrono::steady_clock::now();
+
+    try
+    {
+        log_.reset(new goby::middleware::log::AsyncLogWriter(log_file_path_, cfg().writer()));
+    }
+    catch (goby::middleware::log::LogException& e)
+    {
+        glog.is_die() && glog << "Failed to open log in directory: " << cfg().log_dir() << ": "
+                              << e.what() << std::endl;
+    }
+
+    if (cfg().has_compression())
+    {
+        try
+        {
+            block_writer_.reset(
+                new goby::middleware::log::LogBlockWriter(*log_, cfg().compression()));
+        }
+        catch (goby::middleware::log::LogException& e)
+        {
+            glog.is_die() && glog << "Invalid compression configuration: " << e.what()
+                                  << std::endl;
+        }
+    }
+
+    // each file gets its own version, index entries, and file descriptors, so it can be read alone
+    goby::middleware::log::LogEntry::reset_index();
+    pb_plugin_.register_write_hooks(*log_);
+    dccl_plugin_.register_write_hooks(*log_);
+
+    glog.is_verbose() && glog << "Logging to " << log_file_path_ << std::endl;
+}
+
+void goby::apps::zeromq::Logger::close_log()
+{
+    // writes the last block
+    block_writer_.reset();
+    close_log_file(*log_, log_file_path_);
+}
+
+void goby::apps::zeromq::Logger::rotate_log()
+{
+    // the last block is written here as it uses the global index, which open_log() resets
+    block_writer_.reset();
+
+    // waiting for the writer thread and syncing can take a while, so do it on another thread
+    if (closer_.joinable())
+        closer_.join();
+    closer_ = std::thread(
+        [](std::unique_ptr<goby::middleware::log::AsyncLogWriter> log,
+           const std::string& log_file_path) { close_log_file(*log, log_file_path); },
+        std::move(log_), log_file_path_);
+
+    ++segment_;
+    open_log();
+}
+
+void goby::apps::zeromq::Logger::close_log_file(goby::middleware::log::AsyncLogWriter& log,
+                                                const std::string& log_file_path)
+{
+    // everything is on disk before the file is marked complete (read only)
+    log.close(true);
+    chmod(log_file_path.c_str(), S_IRUSR | S_IRGRP);
 }
@@ -0,0 +1,167 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef Doorbell20261018H
+#define Doorbell20261018H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Lightweight wakeup primitive (an "eventcount") used in place of a condition variable
+/// when the notifying side must not take a mutex
+///
+/// The waiting thread calls prepare_wait(), re-checks for work, and then either cancel_wait()
+/// (work found) or wait() with the returned key. Notifiers call ring() after making work
+/// available. ring() is a single atomic increment unless a thread is actually asleep, in which
+/// case (on Linux) a futex wake is issued.
+class Doorbell
+{
+  public:
+    using key_type = std::uint32_t;
+
+    Doorbell() = default;
+    Doorbell(const Doorbell&) = delete;
+    Doorbell& operator=(const Doorbell&) = delete;
+
+    /// \brief Announce the intent to wait; must be followed by a re-check for work and then either
+    /// cancel_wait() or wait()
+    key_type prepare_wait()
+    {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    /// \brief Withdraw a prepare_wait() because work was found in the re-check
+    void cancel_wait() { waiters_.fetch_sub(1, std::memory_order_seq_cst); }
+
+    /// \brief Block until ring() is called after prepare_wait() returned key, or until timeout
+    ///
+    /// \return true if woken by ring() (or spuriously), false if the timeout was reached
+    template <class Clock, class Duration>
+    bool wait(key_type key, const std::chrono::time_point<Clock, Duration>& timeout)
+    {
+        bool rung = true;
+        while (epoch_.load(std::memory_order_seq_cst) == key)
+        {
+            if (timeout == std::chrono::time_point<Clock, Duration>::max())
+            {
+                _wait(key, nullptr);
+            }
+            else
+            {
+                auto remaining =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - Clock::now());
+                if (remaining <= std::chrono::nanoseconds::zero())
+                {
+                    rung = false;
+                    break;
+                }
+                _wait(key, &remaining);
+            }
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        return rung;
+    }
+
+    /// \brief Wake all threads currently blocked in wait()
+    void ring()
+    {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) > 0)
+            _wake();
+    }
+
+  private:
+#ifdef __linux__
+    void _wait(key_type key, const std::chrono::nanoseconds* remaining)
+    {
+        struct timespec ts;
+        struct timespec* ts_ptr = nullptr;
+        if (remaining)
+        {
+            auto ns = remaining->count();
+            ts.tv_sec = ns / 1000000000;
+            ts.tv_nsec = ns % 1000000000;
+            ts_ptr = &ts;
+        }
+        // returns immediately (EAGAIN) if epoch_ != key, avoiding a lost wakeup
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key,
+                ts_ptr, nullptr, 0);
+    }
+
+    void _wake()
+    {
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, INT_MAX,
+                nullptr, nullptr, 0);
+    }
+#else
+    void _wait(key_type key, const std::chrono::nanoseconds* remaining)
+    {
+        std::unique_lock<std::mutex> lock(fallback_mutex_);
+        auto pred = [&]() { return epoch_.load(std::memory_order_seq_cst) != key; };
+        if (remaining)
+            fallback_cv_.wait_for(lock, *remaining, pred);
+        else
+            fallback_cv_.wait(lock, pred);
+    }
+
+    void _wake()
+    {
+        // only reached when a thread is (about to be) asleep
+        { std::lock_guard<std::mutex> lock(fallback_mutex_); }
+        fallback_cv_.notify_all();
+    }
+
+    std::mutex fallback_mutex_;
+    std::condition_variable fallback_cv_;
+#endif
+
+  private:
+    static_assert(sizeof(std::atomic<key_type>) == sizeof(key_type),
+                  "std::atomic<std::uint32_t> must be unpadded to be used as a futex");
+    std::atomic<key_type> epoch_{0};
+    std::atomic<int> waiters_{0};
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
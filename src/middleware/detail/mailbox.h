@@ -0,0 +1,190 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef Mailbox20261018H
+#define Mailbox20261018H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Bounded multiple-producer, single-consumer queue
+///
+/// push() is lock-free as long as the ring has space (a bounded ring with per-cell sequence
+/// numbers). If the consumer falls behind and the ring fills, values spill to a mutex-protected
+/// overflow queue instead of being dropped or blocking the producer (which may be the consumer
+/// thread itself, publishing to its own subscriptions). Values from any one producer are always
+/// popped in the order they were pushed.
+template <typename T> class Mailbox
+{
+  public:
+    /// \param capacity Number of ring slots (rounded up to the next power of two)
+    explicit Mailbox(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    /// \brief Push a value (any thread)
+    void push(T value)
+    {
+        if (!overflowed_.load(std::memory_order_acquire) && _try_push(value))
+            return;
+
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow_.push_back(std::move(value));
+        overflowed_.store(true, std::memory_order_release);
+        ++overflow_count_;
+    }
+
+    /// \brief Push a value only if there is room in the ring (any thread)
+    ///
+    /// \return true if pushed, false (leaving value untouched) if the ring is full
+    bool try_push(T& value)
+    {
+        return !overflowed_.load(std::memory_order_acquire) && _try_push(value);
+    }
+
+    /// \brief Pop up to max_values values (consumer thread only), passing each to f
+    ///
+    /// \return number of values popped
+    template <typename Function> std::size_t consume(Function f, std::size_t max_values)
+    {
+        std::size_t count = 0;
+        T value;
+        while (count < max_values && _try_pop(value))
+        {
+            ++count;
+            f(std::move(value));
+        }
+
+        // the ring has been drained, so anything in the overflow is newer than what we popped
+        if (count < max_values && overflowed_.load(std::memory_order_acquire))
+        {
+            std::deque<T> overflow;
+            {
+                std::lock_guard<std::mutex> lock(overflow_mutex_);
+                overflow.swap(overflow_);
+                overflowed_.store(false, std::memory_order_release);
+            }
+            for (auto& v : overflow)
+            {
+                ++count;
+                f(std::move(v));
+            }
+        }
+        return count;
+    }
+
+    /// \brief Number of values that did not fit in the ring since construction
+    std::size_t overflow_count() const
+    {
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        return overflow_count_;
+    }
+
+  private:
+    bool _try_push(T& value)
+    {
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool _try_pop(T& value)
+    {
+        Cell& cell = cells_[dequeue_pos_ & mask_];
+        std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(dequeue_pos_ + 1) < 0)
+            return false; // empty
+
+        value = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_{0};
+
+    // producers and consumer on separate cache lines
+    alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(64) std::size_t dequeue_pos_{0};
+
+    alignas(64) std::atomic<bool> overflowed_{false};
+    mutable std::mutex overflow_mutex_;
+    std::deque<T> overflow_;
+    std::size_t overflow_count_{0};
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -23,6 +23,8 @@
 #ifndef Group20170807H
 #define Group20170807H
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -40,18 +42,58 @@ namespace goby
 {
 namespace middleware
 {
+namespace detail
+{
+constexpr std::uint64_t fnv1a_offset_basis{14695981039346656037ull};
+constexpr std::uint64_t fnv1a_prime{1099511628211ull};
+
+// 64-bit FNV-1a hash of a C string, evaluated at compile time for constexpr Groups
+constexpr std::uint64_t fnv1a(const char* c)
+{
+    std::uint64_t h = fnv1a_offset_basis;
+    for (; *c != '\0'; ++c)
+    {
+        h ^= static_cast<unsigned char>(*c);
+        h *= fnv1a_prime;
+    }
+    return h;
+}
+
+// same as fnv1a(std::to_string(i).c_str())
+constexpr std::uint64_t fnv1a(std::uint8_t i)
+{
+    std::uint64_t h = fnv1a_offset_basis;
+    for (int div = 100; div > 0; div /= 10)
+    {
+        if (i >= div || div == 1)
+        {
+            h ^= static_cast<unsigned char>('0' + (i / div) % 10);
+            h *= fnv1a_prime;
+        }
+    }
+    return h;
+}
+} // namespace detail
+
 class Group
 {
   public:
     static constexpr std::uint8_t broadcast_group{0};
     static constexpr std::uint8_t invalid_numeric_group{255};
 
-    constexpr Group(const char* c, std::uint8_t i = invalid_numeric_group) : c_(c), i_(i) {}
-    constexpr Group(std::uint8_t i = invalid_numeric_group) : i_(i) {}
+    constexpr Group(const char* c, std::uint8_t i = invalid_numeric_group)
+        : c_(c), i_(i), hash_(c != nullptr ? detail::fnv1a(c) : detail::fnv1a(i))
+    {
+    }
+    constexpr Group(std::uint8_t i = invalid_numeric_group) : i_(i), hash_(detail::fnv1a(i)) {}
 
     constexpr std::uint8_t numeric() const { return i_; }
     constexpr const char* c_str() const { return c_; }
 
+    /// \brief Hash of std::string(*this), computed once at construction (at compile time for
+    /// constexpr Groups)
+    constexpr std::uint64_t hash() const { return hash_; }
+
     operator std::string() const
     {
         if (c_ != nullptr)
@@ -61,17 +103,25 @@ class Group
     }
 
   protected:
-    void set_c_str(const char* c) { c_ = c; }
+    void set_c_str(const char* c)
+    {
+        c_ = c;
+        hash_ = detail::fnv1a(c);
+    }
 
   private:
     const char* c_{nullptr};
     std::uint8_t i_{invalid_numeric_group};
+    std::uint64_t hash_;
 };
 
 inline bool operator==(const Group& a, const Group& b)
 {
     if (a.c_str() != nullptr && b.c_str() != nullptr)
-        return std::string(a.c_str()) == std::string(b.c_str());
+        // only compare the strings if the hashes match and they aren't the same string
+        // (as is the case for copies of the same constexpr Group)
+        return a.hash() == b.hash() &&
+               (a.c_str() == b.c_str() || std::strcmp(a.c_str(), b.c_str()) == 0);
     else
         return a.numeric() == b.numeric();
 }
@@ -104,7 +154,7 @@ template <> struct hash<goby::middleware::Group>
 {
     size_t operator()(const goby::middleware::Group& group) const noexcept
     {
-        return std::hash<std::string>{}(std::string(group));
+        return static_cast<size_t>(group.hash());
     }
 };
 } // namespace std
@@ -0,0 +1,368 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "goby/exception.h"
+#include "goby/middleware/log/log_crc.h"
+#include "goby/util/debug_logger.h"
+
+#include "buffer_journal.h"
+
+using goby::glog;
+using goby::middleware::intervehicle::BufferJournal;
+
+namespace
+{
+const char file_magic[4] = {'G', 'B', 'Y', 'J'};
+constexpr std::uint32_t file_version{1};
+constexpr std::uint64_t file_header_size{16};
+constexpr std::uint64_t initial_capacity{1 << 16};
+
+// "JREC": the start of a written record
+constexpr std::uint32_t record_magic{0x4a524543};
+
+struct RecordHeader
+{
+    std::uint32_t magic;
+    // CRC-32C of the rest of the header and the data
+    std::uint32_t crc;
+    std::uint8_t type;
+    std::uint8_t reserved[3];
+    std::uint32_t size;
+    // new id (PUSH, SUBSCRIPTION) or the id removed (ACK, SENT, EXPIRE)
+    std::uint64_t id;
+    // microseconds since the UNIX epoch
+    std::int64_t time;
+    std::int32_t modem_id;
+    std::uint32_t reserved2;
+};
+static_assert(sizeof(RecordHeader) == 40, "RecordHeader must not be padded");
+
+// records (and so their headers) start on 8 byte boundaries
+std::uint64_t record_bytes(std::size_t size) { return sizeof(RecordHeader) + ((size + 7) & ~7ull); }
+
+std::uint32_t record_crc(const RecordHeader& header, const char* data)
+{
+    const auto* after_crc = reinterpret_cast<const char*>(&header) + 2 * sizeof(std::uint32_t);
+    auto crc = goby::middleware::log::crc32c(0, after_crc, sizeof(header) - 8);
+    return header.size > 0 ? goby::middleware::log::crc32c(crc, data, header.size) : crc;
+}
+
+void sync_directory(const std::string& path)
+{
+    auto slash = path.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+} // namespace
+
+BufferJournal::BufferJournal(const protobuf::BufferJournalConfig& cfg)
+    : cfg_(cfg), last_commit_(std::chrono::steady_clock::now())
+{
+    _open();
+    _scan();
+}
+
+BufferJournal::~BufferJournal()
+{
+    commit();
+    _unmap();
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+void BufferJournal::_open()
+{
+    const auto& path = cfg_.path();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw(goby::Exception("Failed to open " + path + ": " + std::strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0)
+        throw(goby::Exception("Failed to stat " + path + ": " + std::strerror(errno)));
+
+    if (st.st_size == 0)
+    {
+        _map(initial_capacity);
+        std::memcpy(map_, file_magic, sizeof(file_magic));
+        std::memcpy(map_ + sizeof(file_magic), &file_version, sizeof(file_version));
+        write_pos_ = file_header_size;
+        commit();
+    }
+    else
+    {
+        if (static_cast<std::uint64_t>(st.st_size) < file_header_size)
+            throw(goby::Exception(path + " is not a buffer journal (too short)"));
+        _map(st.st_size);
+
+        std::uint32_t version;
+        std::memcpy(&version, map_ + sizeof(file_magic), sizeof(version));
+        if (std::memcmp(map_, file_magic, sizeof(file_magic)) != 0 || version != file_version)
+            throw(goby::Exception(path + " is not a buffer journal (version " +
+                                  std::to_string(file_version) + ")"));
+    }
+}
+
+void BufferJournal::_map(std::uint64_t capacity)
+{
+    if (::ftruncate(fd_, capacity) != 0)
+        throw(goby::Exception("Failed to resize " + cfg_.path() + ": " + std::strerror(errno)));
+
+    void* addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED)
+        throw(goby::Exception("Failed to mmap " + cfg_.path() + ": " + std::strerror(errno)));
+    map_ = static_cast<char*>(addr);
+    capacity_ = capacity;
+}
+
+void BufferJournal::_unmap()
+{
+    if (map_)
+        munmap(map_, capacity_);
+    map_ = nullptr;
+    capacity_ = 0;
+}
+
+void BufferJournal::_scan()
+{
+    std::uint64_t pos = file_header_size;
+    while (pos + sizeof(RecordHeader) <= capacity_)
+    {
+        RecordHeader header;
+        std::memcpy(&header, map_ + pos, sizeof(header));
+        if (header.magic != record_magic)
+            break;
+
+        auto bytes = record_bytes(header.size);
+        if (pos + bytes > capacity_ ||
+            record_crc(header, map_ + pos + sizeof(header)) != header.crc)
+        {
+            glog.is_warn() && glog << "Buffer journal " << cfg_.path()
+                                   << ": ignoring incomplete record at byte " << pos << std::endl;
+            break;
+        }
+
+        switch (static_cast<RecordType>(header.type))
+        {
+            case RecordType::PUSH:
+            case RecordType::SUBSCRIPTION:
+                live_[header.id] = {pos, bytes};
+                live_bytes_ += bytes;
+                next_id_ = std::max(next_id_, header.id + 1);
+                break;
+
+            case RecordType::ACK:
+            case RecordType::SENT:
+            case RecordType::EXPIRE:
+            {
+                auto it = live_.find(header.id);
+                if (it != live_.end())
+                {
+                    live_bytes_ -= it->second.bytes;
+                    live_.erase(it);
+                }
+                break;
+            }
+        }
+        pos += bytes;
+    }
+    write_pos_ = synced_pos_ = pos;
+
+    // clear what's left of an incomplete record so that it can't be read as part of a later one
+    auto end = capacity_;
+    while (end > pos && map_[end - 1] == 0) --end;
+    if (end > pos)
+        std::memset(map_ + pos, 0, end - pos);
+
+    glog.is_verbose() && glog << "Buffer journal " << cfg_.path() << ": " << live_.size()
+                              << " records to replay" << std::endl;
+}
+
+BufferJournal::id_type BufferJournal::_append(RecordType type, id_type id, std::int32_t modem_id,
+                                              goby::time::SystemClock::time_point time,
+                                              const char* data, std::size_t size)
+{
+    bool adds = (type == RecordType::PUSH || type == RecordType::SUBSCRIPTION);
+    if (adds)
+        id = next_id_++;
+
+    auto bytes = record_bytes(size);
+    if (write_pos_ + bytes > capacity_)
+    {
+        auto capacity = capacity_;
+        while (write_pos_ + bytes > capacity) capacity *= 2;
+        _unmap();
+        _map(capacity);
+    }
+
+    RecordHeader header{};
+    header.magic = record_magic;
+    header.type = static_cast<std::uint8_t>(type);
+    header.size = size;
+    header.id = id;
+    header.time =
+        std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    header.modem_id = modem_id;
+    header.crc = record_crc(header, data);
+
+    // the header last, so that a record is not seen until it has been written
+    char* p = map_ + write_pos_;
+    if (size > 0)
+        std::memcpy(p + sizeof(header), data, size);
+    std::memcpy(p, &header, sizeof(header));
+
+    if (adds)
+    {
+        live_[id] = {write_pos_, bytes};
+        live_bytes_ += bytes;
+    }
+    write_pos_ += bytes;
+    return id;
+}
+
+void BufferJournal::_remove(RecordType type, id_type id)
+{
+    auto it = live_.find(id);
+    if (it == live_.end())
+        return;
+    live_bytes_ -= it->second.bytes;
+    live_.erase(it);
+    _append(type, id, 0, goby::time::SystemClock::now(), nullptr, 0);
+}
+
+BufferJournal::Record BufferJournal::_record(std::uint64_t offset) const
+{
+    RecordHeader header;
+    std::memcpy(&header, map_ + offset, sizeof(header));
+
+    goby::time::SystemClock::time_point time(
+        std::chrono::duration_cast<goby::time::SystemClock::duration>(
+            std::chrono::microseconds(header.time)));
+    return {static_cast<RecordType>(header.type),
+            header.id,
+            header.modem_id,
+            time,
+            map_ + offset + sizeof(header),
+            header.size};
+}
+
+void BufferJournal::commit()
+{
+    last_commit_ = std::chrono::steady_clock::now();
+    if (!map_ || synced_pos_ == write_pos_)
+        return;
+
+    // msync() must start on a page boundary
+    auto page_size = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    auto start = synced_pos_ / page_size * page_size;
+    if (msync(map_ + start, write_pos_ - start, MS_SYNC) != 0)
+    {
+        glog.is_warn() && glog << "Failed to sync buffer journal " << cfg_.path() << ": "
+                               << std::strerror(errno) << std::endl;
+        return;
+    }
+    synced_pos_ = write_pos_;
+}
+
+void BufferJournal::commit_if_due()
+{
+    if (std::chrono::steady_clock::now() >=
+        last_commit_ + std::chrono::milliseconds(cfg_.commit_interval_ms()))
+        commit();
+
+    if (write_pos_ >= cfg_.compact_size() && live_bytes_ < (write_pos_ - file_header_size) / 2)
+        _compact();
+}
+
+void BufferJournal::_compact()
+{
+    std::string compact_path = cfg_.path() + ".compact";
+    auto fail = [&](int fd, void* addr, std::uint64_t capacity) {
+        glog.is_warn() && glog << "Failed to compact buffer journal " << cfg_.path() << ": "
+                               << std::strerror(errno) << std::endl;
+        if (addr)
+            munmap(addr, capacity);
+        if (fd >= 0)
+            ::close(fd);
+        ::unlink(compact_path.c_str());
+    };
+
+    int fd = ::open(compact_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return fail(fd, nullptr, 0);
+
+    // room to grow before the next resize
+    auto capacity = initial_capacity;
+    while (capacity < 2 * (file_header_size + live_bytes_)) capacity *= 2;
+    if (::ftruncate(fd, capacity) != 0)
+        return fail(fd, nullptr, 0);
+
+    void* addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        return fail(fd, nullptr, 0);
+    char* map = static_cast<char*>(addr);
+
+    std::memcpy(map, map_, file_header_size);
+    std::uint64_t pos = file_header_size;
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(live_.size());
+    for (const auto& live_p : live_)
+    {
+        std::memcpy(map + pos, map_ + live_p.second.offset, live_p.second.bytes);
+        offsets.push_back(pos);
+        pos += live_p.second.bytes;
+    }
+
+    // the compacted file must be complete on disk before it replaces the journal
+    if (msync(map, pos, MS_SYNC) != 0 ||
+        std::rename(compact_path.c_str(), cfg_.path().c_str()) != 0)
+        return fail(fd, addr, capacity);
+    sync_directory(cfg_.path());
+
+    glog.is_debug1() && glog << "Compacted buffer journal " << cfg_.path() << " from "
+                             << write_pos_ << " to " << pos << " bytes" << std::endl;
+
+    _unmap();
+    ::close(fd_);
+    fd_ = fd;
+    map_ = map;
+    capacity_ = capacity;
+    write_pos_ = synced_pos_ = pos;
+
+    auto offset_it = offsets.begin();
+    for (auto& live_p : live_) live_p.second.offset = *offset_it++;
+}
@@ -0,0 +1,178 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BufferJournal20261018H
+#define BufferJournal20261018H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "goby/middleware/protobuf/intervehicle.pb.h"
+#include "goby/time/system_clock.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace intervehicle
+{
+/// \brief Append-only, memory-mapped file recording what is in a ModemDriverThread's buffer, so
+/// that it can be rebuilt (replay()) when the process restarts
+///
+/// Writing a record is a copy into the mapped file: nothing is synced to disk until commit() (or
+/// commit_if_due(), which also compacts the file once most of it is no longer needed). A process
+/// crash loses nothing (the kernel has the pages); a power loss loses at most the records since
+/// the last commit.
+///
+/// The file is in host byte order: it is meant to be replayed by the same machine.
+class BufferJournal
+{
+  public:
+    using id_type = std::uint64_t;
+
+    enum class RecordType : std::uint8_t
+    {
+        PUSH = 1,
+        ACK = 2,
+        EXPIRE = 3,
+        SUBSCRIPTION = 4,
+        SENT = 5
+    };
+
+    /// \brief A record still needed (a PUSH not yet acked, sent or expired, or a SUBSCRIPTION)
+    struct Record
+    {
+        RecordType type;
+        id_type id;
+        std::int32_t modem_id;
+        goby::time::SystemClock::time_point time;
+        // valid until the journal is next written to
+        const char* data;
+        std::size_t size;
+    };
+
+    /// \brief Open (and read) the journal, or create it if it doesn't exist
+    ///
+    /// \throw goby::Exception if the file cannot be opened or isn't a journal
+    BufferJournal(const protobuf::BufferJournalConfig& cfg);
+    ~BufferJournal();
+
+    BufferJournal(const BufferJournal&) = delete;
+    BufferJournal& operator=(const BufferJournal&) = delete;
+
+    /// \brief Calls visitor (as `void(const Record&)`) for each record still needed, in the
+    /// order written. The visitor may write to the journal.
+    template <typename Visitor> void replay(Visitor visitor)
+    {
+        std::vector<id_type> ids;
+        for (const auto& live_p : live_) ids.push_back(live_p.first);
+
+        for (auto id : ids)
+        {
+            auto it = live_.find(id);
+            if (it != live_.end())
+                visitor(_record(it->second.offset));
+        }
+    }
+
+    /// \brief Record a value pushed to the buffer
+    /// \return id for ack(), sent() or expire()
+    id_type push(std::int32_t modem_id, goby::time::SystemClock::time_point time,
+                 const std::string& data)
+    {
+        return _append(RecordType::PUSH, 0, modem_id, time, data.data(), data.size());
+    }
+
+    /// \brief Record a subscription, kept until the journal is removed
+    id_type subscription(std::int32_t modem_id, const std::string& data)
+    {
+        return _append(RecordType::SUBSCRIPTION, 0, modem_id, goby::time::SystemClock::now(),
+                       data.data(), data.size());
+    }
+
+    /// \brief Record that a pushed value was acknowledged (and removed from the buffer)
+    void ack(id_type id) { _remove(RecordType::ACK, id); }
+
+    /// \brief Record that a pushed value not requiring an ack was sent (and removed from the
+    /// buffer)
+    void sent(id_type id) { _remove(RecordType::SENT, id); }
+
+    /// \brief Record that a pushed value expired (and was removed from the buffer)
+    void expire(id_type id) { _remove(RecordType::EXPIRE, id); }
+
+    /// \brief Sync the records written since the last commit to disk
+    void commit();
+
+    /// \brief commit() if commit_interval_ms has passed since the last one, and compact the file
+    /// if it is at least compact_size and more than half of it is no longer needed
+    void commit_if_due();
+
+    /// \brief Bytes used in the file
+    std::uint64_t size() const { return write_pos_; }
+
+    /// \brief Bytes of the records still needed
+    std::uint64_t live_bytes() const { return live_bytes_; }
+
+    /// \brief Number of records still needed
+    std::size_t live_records() const { return live_.size(); }
+
+  private:
+    struct Live
+    {
+        std::uint64_t offset;
+        std::uint64_t bytes;
+    };
+
+    void _open();
+    void _map(std::uint64_t capacity);
+    void _unmap();
+    void _scan();
+    void _compact();
+
+    id_type _append(RecordType type, id_type id, std::int32_t modem_id,
+                    goby::time::SystemClock::time_point time, const char* data, std::size_t size);
+    void _remove(RecordType type, id_type id);
+    Record _record(std::uint64_t offset) const;
+
+  private:
+    protobuf::BufferJournalConfig cfg_;
+    int fd_{-1};
+    char* map_{nullptr};
+    std::uint64_t capacity_{0};
+    std::uint64_t write_pos_{0};
+    // written before this offset are on disk
+    std::uint64_t synced_pos_{0};
+    std::chrono::steady_clock::time_point last_commit_;
+
+    id_type next_id_{1};
+    std::map<id_type, Live> live_;
+    std::uint64_t live_bytes_{0};
+};
+
+} // namespace intervehicle
+} // namespace middleware
+} // namespace goby
+
+#endif
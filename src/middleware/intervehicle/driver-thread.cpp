@@ -21,6 +21,7 @@
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "goby/acomms/bind.h"
+#include "goby/acomms/buffer/frame_packing.h"
 #include "goby/acomms/modem_driver.h"
 
 #include "driver-thread.h"
@@ -113,24 +114,26 @@ goby::middleware::intervehicle::ModemDriverThread::ModemDriverThread(
     subscription_key_.set_type(intervehicle::protobuf::Subscription::descriptor()->full_name());
     subscription_key_.set_group_numeric(Group::broadcast_group);
 
+    if (cfg().has_buffer_journal())
+        _replay_journal();
+
     goby::glog.is_debug1() && goby::glog << "Driver ready" << std::endl;
     interthread_->publish<groups::modem_driver_ready, bool>(true);
 }
 
 void goby::middleware::intervehicle::ModemDriverThread::loop()
 {
-    auto expired = buffer_.expire();
-
-    if (!expired.empty())
-    {
-        auto now = goby::time::SteadyClock::now();
-        for (const auto& value : expired)
-            _expire_value(now, value,
-                          intervehicle::protobuf::ExpireData::EXPIRED_TIME_TO_LIVE_EXCEEDED);
-    }
+    auto now = goby::time::SteadyClock::now();
+    buffer_.expire([&](const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value) {
+        _expire_value(now, value,
+                      intervehicle::protobuf::ExpireData::EXPIRED_TIME_TO_LIVE_EXCEEDED);
+    });
 
     driver_->do_work();
     mac_.do_work();
+
+    if (journal_)
+        journal_->commit_if_due();
 }
 
 void goby::middleware::intervehicle::ModemDriverThread::_expire_value(
@@ -147,8 +150,10 @@ void goby::middleware::intervehicle::ModemDriverThread::_expire_value(
         goby::time::convert_duration<goby::time::MicroTime>(now - value.push_time));
     expire_data.set_reason(reason);
 
-    *expire_pair.mutable_serializer() = value.data;
+    *expire_pair.mutable_serializer() = *value.data;
     interprocess_->publish<groups::modem_expire_in>(expire_pair);
+
+    _journal_remove(value, BufferJournal::RecordType::EXPIRE);
 }
 
 void goby::middleware::intervehicle::ModemDriverThread::_forward_subscription(
@@ -175,11 +180,13 @@ void goby::middleware::intervehicle::ModemDriverThread::_forward_subscription(
         auto subscription_publication = serialize_publication(
             subscription, groups::subscription_forward, Publisher<decltype(subscription)>());
 
-        // overwrite serialize_time to ensure mapping with InterVehicle portals
+        // overwrite serialize_time and publication_id to ensure mapping with InterVehicle portals
         auto subscribe_time = subscription.time_with_units();
         subscription_publication->mutable_key()->set_serialize_time_with_units(subscribe_time);
+        subscription_publication->mutable_key()->set_publication_id(
+            subscription.publication_id());
 
-        buffer_.push({dest, buffer_id, goby::time::SteadyClock::now(), *subscription_publication});
+        buffer_.push({dest, buffer_id, goby::time::SteadyClock::now(), subscription_publication});
     }
 }
 
@@ -202,40 +209,122 @@ void goby::middleware::intervehicle::ModemDriverThread::_data_request(
     {
         std::string* frame = msg->add_frame();
 
-        while (frame->size() < msg->max_frame_bytes())
+        int messages = 0;
+        switch (cfg().frame_packing())
         {
-            try
-            {
-                auto buffer_value =
-                    buffer_.top(dest, msg->max_frame_bytes() - frame->size(),
-                                goby::time::convert_duration<std::chrono::microseconds>(
-                                    cfg().ack_timeout_with_units()));
-                dest = buffer_value.modem_id;
-                *frame += buffer_value.data.data();
-
-                bool ack_required = buffer_.sub(buffer_value.modem_id, buffer_value.subbuffer_id)
-                                        .cfg()
-                                        .ack_required();
-
-                if (!ack_required)
-                {
-                    buffer_.erase(buffer_value);
-                }
-                else
-                {
-                    msg->set_ack_requested(true);
-                    pending_ack_[frame_number].push_back(buffer_value);
-                }
-            }
-            catch (goby::acomms::DynamicBufferNoDataException&)
-            {
+            case intervehicle::protobuf::PortalConfig::LinkConfig::PACK_GREEDY:
+                messages = _fill_frame_greedy(msg, frame_number, &dest);
+                break;
+            case intervehicle::protobuf::PortalConfig::LinkConfig::PACK_KNAPSACK:
+                messages = _fill_frame_packed(msg, frame_number, &dest);
                 break;
-            }
         }
+
+        intervehicle::protobuf::FrameFill fill;
+        fill.set_dest(dest);
+        fill.set_frame_number(frame_number);
+        fill.set_max_frame_bytes(msg->max_frame_bytes());
+        fill.set_bytes(frame->size());
+        fill.set_messages(messages);
+        fill.set_efficiency(msg->max_frame_bytes() > 0
+                                ? static_cast<double>(frame->size()) / msg->max_frame_bytes()
+                                : 0);
+        glog.is_debug1() && glog << "Filled frame: " << fill.ShortDebugString() << std::endl;
+        interprocess_->publish<groups::modem_frame_fill>(fill);
     }
     msg->set_dest(dest);
 }
 
+int goby::middleware::intervehicle::ModemDriverThread::_fill_frame_greedy(
+    goby::acomms::protobuf::ModemTransmission* msg, int frame_number, int* dest)
+{
+    std::string* frame = msg->mutable_frame(msg->frame_size() - 1);
+    int messages = 0;
+    while (frame->size() < msg->max_frame_bytes())
+    {
+        try
+        {
+            auto buffer_value = buffer_.top(*dest, msg->max_frame_bytes() - frame->size(),
+                                            goby::time::convert_duration<std::chrono::microseconds>(
+                                                cfg().ack_timeout_with_units()));
+            *dest = buffer_value.modem_id;
+            _add_to_frame(msg, frame_number, buffer_value);
+            ++messages;
+        }
+        catch (goby::acomms::DynamicBufferNoDataException&)
+        {
+            break;
+        }
+    }
+    return messages;
+}
+
+int goby::middleware::intervehicle::ModemDriverThread::_fill_frame_packed(
+    goby::acomms::protobuf::ModemTransmission* msg, int frame_number, int* dest)
+{
+    std::string* frame = msg->mutable_frame(msg->frame_size() - 1);
+    auto ack_timeout =
+        goby::time::convert_duration<std::chrono::microseconds>(cfg().ack_timeout_with_units());
+
+    int messages = 0;
+    // values taken may be followed by others from the same subbuffers, so repeat until none fit
+    while (frame->size() < msg->max_frame_bytes())
+    {
+        auto candidates =
+            buffer_.candidates(*dest, msg->max_frame_bytes() - frame->size(), ack_timeout);
+        if (candidates.empty())
+            break;
+
+        // the frame goes to the destination with the highest priority value, as for PACK_GREEDY
+        if (*dest == goby::acomms::QUERY_DESTINATION_ID)
+        {
+            using Candidate = decltype(candidates)::value_type;
+            *dest = std::max_element(candidates.begin(), candidates.end(),
+                                     [](const Candidate& a, const Candidate& b) {
+                                         return a.priority < b.priority;
+                                     })
+                        ->modem_id;
+            auto other_dest = [&](const Candidate& c) { return c.modem_id != *dest; };
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), other_dest),
+                             candidates.end());
+        }
+
+        auto chosen = goby::acomms::pack_frame(candidates, msg->max_frame_bytes() - frame->size(),
+                                               cfg().max_packing_cells());
+        if (chosen.empty())
+            break;
+
+        for (auto i : chosen)
+        {
+            _add_to_frame(msg, frame_number,
+                          buffer_.top(*dest, candidates[i].subbuffer_id, ack_timeout));
+            ++messages;
+        }
+    }
+    return messages;
+}
+
+void goby::middleware::intervehicle::ModemDriverThread::_add_to_frame(
+    goby::acomms::protobuf::ModemTransmission* msg, int frame_number,
+    const goby::acomms::DynamicBuffer<buffer_data_type>::Value& buffer_value)
+{
+    *msg->mutable_frame(msg->frame_size() - 1) += buffer_value.data->data();
+
+    bool ack_required =
+        buffer_.sub(buffer_value.modem_id, buffer_value.subbuffer_id).cfg().ack_required();
+
+    if (!ack_required)
+    {
+        buffer_.erase(buffer_value);
+        _journal_remove(buffer_value, BufferJournal::RecordType::SENT);
+    }
+    else
+    {
+        msg->set_ack_requested(true);
+        pending_ack_[frame_number].push_back(buffer_value);
+    }
+}
+
 goby::middleware::intervehicle::ModemDriverThread::subbuffer_id_type
 goby::middleware::intervehicle::ModemDriverThread::_create_buffer_id(unsigned dccl_id,
                                                                      unsigned group)
@@ -262,6 +351,9 @@ void goby::middleware::intervehicle::ModemDriverThread::_accept_subscription(
     {
         subscriber_buffer_cfg_[dest].insert(std::make_pair(buffer_id, subscription));
 
+        if (journal_ && !replaying_journal_)
+            journal_->subscription(dest, subscription.SerializeAsString());
+
         // check if there's a publisher already, if so create the buffer
         auto pub_it = publisher_buffer_cfg_.find(buffer_id);
         if (pub_it != publisher_buffer_cfg_.end())
@@ -294,54 +386,161 @@ void goby::middleware::intervehicle::ModemDriverThread::_buffer_message(
     std::shared_ptr<const SerializerTransporterMessage> msg)
 {
     auto buffer_id = _create_buffer_id(msg->key());
-    if (!publisher_buffer_cfg_.count(buffer_id))
-    {
-        publisher_buffer_cfg_.insert(std::make_pair(buffer_id, msg->key()));
-
-        // check for new subbuffers
-        // TODO see if there's a change to the buffer configuration with this publication
-        for (const auto& sub_id_p : subscriber_buffer_cfg_)
-        {
-            const auto& sub_map = sub_id_p.second;
-            auto sub_it = sub_map.find(buffer_id);
-            if (sub_it != sub_map.end())
-            {
-                auto dest_id = sub_id_p.first;
-                const auto& intervehicle_subscription = sub_it->second;
-                _create_buffer(dest_id, buffer_id,
-                               {msg->key().cfg().intervehicle().buffer(),
-                                intervehicle_subscription.intervehicle().buffer()});
-            }
-        }
-    }
+    _register_publisher(buffer_id, msg->key());
 
     if (!subbuffers_created_[buffer_id].empty())
     {
+        // serialized once for all the subscribed buffers
+        std::string journal_data;
+        if (journal_)
+            msg->SerializeToString(&journal_data);
+
         // push to all subscribed buffers
         for (auto dest_id : subbuffers_created_[buffer_id])
         {
             if (!_dest_is_in_subnet(dest_id))
                 continue;
 
-            auto exceeded =
-                buffer_.push({dest_id, buffer_id, goby::time::SteadyClock::now(), *msg});
-            if (!exceeded.empty())
-            {
-                auto now = goby::time::SteadyClock::now();
-                for (const auto& value : exceeded)
-                    _expire_value(now, value,
-                                  intervehicle::protobuf::ExpireData::EXPIRED_BUFFER_OVERFLOW);
-            }
+            BufferJournal::id_type journal_id = 0;
+            if (journal_)
+                journal_id =
+                    journal_->push(dest_id, goby::time::SystemClock::now(), journal_data);
+            _push({dest_id, buffer_id, goby::time::SteadyClock::now(), msg}, journal_id);
         }
     }
     else
     {
         auto now = goby::time::SteadyClock::now();
-        _expire_value(now, {cfg().driver().modem_id(), buffer_id, now, *msg},
+        _expire_value(now, {cfg().driver().modem_id(), buffer_id, now, msg},
                       intervehicle::protobuf::ExpireData::EXPIRED_NO_SUBSCRIBERS);
     }
 }
 
+void goby::middleware::intervehicle::ModemDriverThread::_register_publisher(
+    const subbuffer_id_type& buffer_id,
+    const goby::middleware::protobuf::SerializerTransporterKey& key)
+{
+    if (publisher_buffer_cfg_.count(buffer_id))
+        return;
+
+    publisher_buffer_cfg_.insert(std::make_pair(buffer_id, key));
+
+    // check for new subbuffers
+    // TODO see if there's a change to the buffer configuration with this publication
+    for (const auto& sub_id_p : subscriber_buffer_cfg_)
+    {
+        const auto& sub_map = sub_id_p.second;
+        auto sub_it = sub_map.find(buffer_id);
+        if (sub_it != sub_map.end())
+        {
+            auto dest_id = sub_id_p.first;
+            const auto& intervehicle_subscription = sub_it->second;
+            _create_buffer(dest_id, buffer_id,
+                           {key.cfg().intervehicle().buffer(),
+                            intervehicle_subscription.intervehicle().buffer()});
+        }
+    }
+}
+
+void goby::middleware::intervehicle::ModemDriverThread::_push(
+    const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value,
+    BufferJournal::id_type journal_id)
+{
+    // before pushing, as the value itself may be removed if the subbuffer is full
+    if (journal_)
+        journal_ids_[_journal_key(value)] = journal_id;
+
+    auto exceeded = buffer_.push(value);
+    if (!exceeded.empty())
+    {
+        auto now = goby::time::SteadyClock::now();
+        for (const auto& exceeded_value : exceeded)
+            _expire_value(now, exceeded_value,
+                          intervehicle::protobuf::ExpireData::EXPIRED_BUFFER_OVERFLOW);
+    }
+}
+
+void goby::middleware::intervehicle::ModemDriverThread::_journal_remove(
+    const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value,
+    BufferJournal::RecordType type)
+{
+    if (!journal_)
+        return;
+
+    auto it = journal_ids_.find(_journal_key(value));
+    if (it == journal_ids_.end())
+        return;
+
+    switch (type)
+    {
+        case BufferJournal::RecordType::ACK: journal_->ack(it->second); break;
+        case BufferJournal::RecordType::SENT: journal_->sent(it->second); break;
+        default: journal_->expire(it->second); break;
+    }
+    journal_ids_.erase(it);
+}
+
+void goby::middleware::intervehicle::ModemDriverThread::_replay_journal()
+{
+    journal_.reset(new BufferJournal(cfg().buffer_journal()));
+
+    // push times were recorded with the system clock
+    auto system_now = goby::time::SystemClock::now();
+    auto steady_now = goby::time::SteadyClock::now();
+
+    replaying_journal_ = true;
+    journal_->replay([&](const BufferJournal::Record& record) {
+        switch (record.type)
+        {
+            case BufferJournal::RecordType::SUBSCRIPTION:
+            {
+                intervehicle::protobuf::Subscription subscription;
+                if (subscription.ParseFromArray(record.data, record.size))
+                    _accept_subscription(subscription);
+                break;
+            }
+
+            case BufferJournal::RecordType::PUSH:
+            {
+                auto msg = std::make_shared<SerializerTransporterMessage>();
+                subbuffer_id_type buffer_id;
+                if (msg->ParseFromArray(record.data, record.size))
+                {
+                    // the DCCL type may not be loaded yet, so read the id from the message
+                    const auto& data = msg->data();
+                    buffer_id = _create_buffer_id(
+                        DCCLSerializerParserHelperBase::id(data.begin(), data.end()),
+                        msg->key().group_numeric());
+                    _register_publisher(buffer_id, msg->key());
+                }
+
+                if (buffer_id.empty() || !subbuffers_created_[buffer_id].count(record.modem_id))
+                {
+                    glog.is_warn() && glog << "Dropping journaled message for "
+                                           << record.modem_id << ": no buffer for it"
+                                           << std::endl;
+                    journal_->expire(record.id);
+                    break;
+                }
+
+                auto push_time =
+                    steady_now - std::chrono::duration_cast<goby::time::SteadyClock::duration>(
+                                     system_now - record.time);
+                _push({record.modem_id, buffer_id, push_time, msg}, record.id);
+                break;
+            }
+
+            case BufferJournal::RecordType::ACK:
+            case BufferJournal::RecordType::SENT:
+            case BufferJournal::RecordType::EXPIRE: break;
+        }
+    });
+    replaying_journal_ = false;
+
+    glog.is_verbose() && glog << "Replayed " << buffer_.size() << " messages from "
+                              << cfg().buffer_journal().path() << std::endl;
+}
+
 void goby::middleware::intervehicle::ModemDriverThread::_receive(
     const goby::acomms::protobuf::ModemTransmission& rx_msg)
 {
@@ -382,9 +581,10 @@ void goby::middleware::intervehicle::ModemDriverThread::_receive(
                     ack_data.set_latency_with_units(
                         goby::time::convert_duration<goby::time::MicroTime>(now - value.push_time));
 
-                    *ack_pair.mutable_serializer() = value.data;
+                    *ack_pair.mutable_serializer() = *value.data;
                     interprocess_->publish<groups::modem_ack_in>(ack_pair);
                     buffer_.erase(value);
+                    _journal_remove(value, BufferJournal::RecordType::ACK);
                 }
                 pending_ack_.erase(values_to_ack_it);
                 // TODO publish acks for other drivers to erase the same piece of data (if they have it and the ack'ing party is the same vehicle - need a distinction between modem_id and vehicle_id ?)
@@ -23,12 +23,17 @@
 #ifndef DriverThread20190619H
 #define DriverThread20190619H
 
+#include <atomic>
+#include <tuple>
+#include <unistd.h>
+
 #include "goby/acomms/amac.h"
 #include "goby/acomms/buffer/dynamic_buffer.h"
 
 #include "goby/middleware/marshalling/dccl.h"
 
 #include "goby/middleware/group.h"
+#include "goby/middleware/intervehicle/buffer_journal.h"
 #include "goby/middleware/protobuf/intervehicle.pb.h"
 #include "goby/middleware/thread.h"
 #include "goby/middleware/transport/interprocess.h"
@@ -47,6 +52,10 @@ namespace middleware
 namespace protobuf
 {
 inline size_t data_size(const SerializerTransporterMessage& msg) { return msg.data().size(); }
+inline size_t data_size(const std::shared_ptr<const SerializerTransporterMessage>& msg)
+{
+    return msg->data().size();
+}
 
 inline bool operator==(const SerializerTransporterMessage& a, const SerializerTransporterMessage& b)
 {
@@ -74,13 +83,22 @@ inline bool operator<(const SerializerTransporterMessage& a, const SerializerTra
 
 namespace intervehicle
 {
+/// \brief Identifier for a new publication, unique among all processes on this host: the process
+/// ID followed by a per-process counter
+inline std::uint64_t next_publication_id()
+{
+    static const std::uint64_t pid = static_cast<std::uint32_t>(getpid());
+    static std::atomic<std::uint32_t> count{0};
+    return (pid << 32) | ++count;
+}
+
 template <typename Data>
 std::shared_ptr<goby::middleware::protobuf::SerializerTransporterMessage>
 serialize_publication(const Data& d, const Group& group, const Publisher<Data>& publisher)
 {
-    std::vector<char> bytes(SerializerParserHelper<Data, MarshallingScheme::DCCL>::serialize(d));
-    std::string* sbytes = new std::string(bytes.begin(), bytes.end());
     auto msg = std::make_shared<goby::middleware::protobuf::SerializerTransporterMessage>();
+    ContainerByteSink<std::string> sink(*msg->mutable_data());
+    serialize_to<Data, MarshallingScheme::DCCL>(d, sink);
 
     auto* key = msg->mutable_key();
     key->set_marshalling_scheme(MarshallingScheme::DCCL);
@@ -89,8 +107,8 @@ serialize_publication(const Data& d, const Group& group, const Publisher<Data>&
     key->set_group_numeric(group.numeric());
     auto now = goby::time::SystemClock::now<goby::time::MicroTime>();
     key->set_serialize_time_with_units(now);
+    key->set_publication_id(next_publication_id());
     *key->mutable_cfg() = publisher.cfg();
-    msg->set_allocated_data(sbytes);
     return msg;
 }
 
@@ -103,6 +121,7 @@ constexpr Group modem_data_out{"goby::middleware::intervehicle::modem_data_out"}
 constexpr Group modem_data_in{"goby::middleware::intervehicle::modem_data_in"};
 constexpr Group modem_ack_in{"goby::middleware::intervehicle::modem_ack_in"};
 constexpr Group modem_expire_in{"goby::middleware::intervehicle::modem_expire_in"};
+constexpr Group modem_frame_fill{"goby::middleware::intervehicle::modem_frame_fill"};
 
 constexpr Group modem_subscription_forward_tx{
     "goby::middleware::intervehicle::modem_subscription_forward_tx"};
@@ -116,7 +135,9 @@ class ModemDriverThread
                                       InterProcessForwarder<InterThreadTransporter>>
 {
   public:
-    using buffer_data_type = goby::middleware::protobuf::SerializerTransporterMessage;
+    // shared by the buffer, pending acks and expire notifications
+    using buffer_data_type =
+        std::shared_ptr<const goby::middleware::protobuf::SerializerTransporterMessage>;
     using modem_id_type = goby::acomms::DynamicBuffer<buffer_data_type>::modem_id_type;
     using subbuffer_id_type = goby::acomms::DynamicBuffer<buffer_data_type>::subbuffer_id_type;
 
@@ -126,8 +147,23 @@ class ModemDriverThread
 
   private:
     void _data_request(goby::acomms::protobuf::ModemTransmission* msg);
+    // fill the last frame of msg, returning the number of messages added
+    int _fill_frame_greedy(goby::acomms::protobuf::ModemTransmission* msg, int frame_number,
+                           int* dest);
+    int _fill_frame_packed(goby::acomms::protobuf::ModemTransmission* msg, int frame_number,
+                           int* dest);
+    void _add_to_frame(goby::acomms::protobuf::ModemTransmission* msg, int frame_number,
+                       const goby::acomms::DynamicBuffer<buffer_data_type>::Value& buffer_value);
     void _buffer_message(
         std::shared_ptr<const goby::middleware::protobuf::SerializerTransporterMessage> msg);
+    // create the subbuffers for a newly seen publication
+    void _register_publisher(const subbuffer_id_type& buffer_id,
+                             const goby::middleware::protobuf::SerializerTransporterKey& key);
+    void _push(const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value,
+               BufferJournal::id_type journal_id);
+    void _journal_remove(const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value,
+                         BufferJournal::RecordType type);
+    void _replay_journal();
     void _receive(const goby::acomms::protobuf::ModemTransmission& rx_msg);
     void _forward_subscription(intervehicle::protobuf::Subscription subscription);
     void _accept_subscription(const intervehicle::protobuf::Subscription& subscription);
@@ -157,6 +193,15 @@ class ModemDriverThread
         return (dest_id & cfg().subnet_mask()) == (cfg().modem_id() & cfg().subnet_mask());
     }
 
+    // (dest, publication_id, serialize_time): the serialize_time distinguishes replayed values
+    // from new ones given the same publication_id by a process with the same PID
+    using journal_key_type = std::tuple<modem_id_type, std::uint64_t, std::uint64_t>;
+    journal_key_type _journal_key(const goby::acomms::DynamicBuffer<buffer_data_type>::Value& value)
+    {
+        return journal_key_type(value.modem_id, value.data->key().publication_id(),
+                                value.data->key().serialize_time());
+    }
+
   private:
     std::unique_ptr<InterThreadTransporter> interthread_;
     std::unique_ptr<InterProcessForwarder<InterThreadTransporter>> interprocess_;
@@ -180,6 +225,12 @@ class ModemDriverThread
 
     std::unique_ptr<goby::acomms::ModemDriverBase> driver_;
     goby::acomms::MACManager mac_;
+
+    // only if buffer_journal is configured
+    std::unique_ptr<BufferJournal> journal_;
+    // PUSH record for each value in buffer_
+    std::map<journal_key_type, BufferJournal::id_type> journal_ids_;
+    bool replaying_journal_{false};
 };
 
 } // namespace intervehicle
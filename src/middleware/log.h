@@ -25,5 +25,7 @@
 
 #include "goby/middleware/log/log_entry.h"
 #include "goby/middleware/log/log_plugin.h"
+#include "goby/middleware/log/log_reader.h"
+#include "goby/middleware/log/log_writer.h"
 
 #endif
@@ -0,0 +1,317 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "goby/middleware/log/log_entry.h"
+#include "goby/util/debug_logger.h"
+
+#include "async_log_writer.h"
+
+using goby::glog;
+using goby::middleware::log::AsyncLogWriter;
+
+namespace
+{
+// suitable for O_DIRECT and page-sized copies
+constexpr std::size_t block_alignment{4096};
+
+#ifdef IOV_MAX
+constexpr std::size_t max_iov{IOV_MAX};
+#else
+constexpr std::size_t max_iov{1024};
+#endif
+
+template <typename Atomic, typename Value> void update_max(Atomic& a, Value v)
+{
+    auto current = a.load(std::memory_order_relaxed);
+    while (current < v && !a.compare_exchange_weak(current, v, std::memory_order_relaxed))
+    {
+    }
+}
+} // namespace
+
+AsyncLogWriter::Block::Block(std::size_t capacity) : data(nullptr, &std::free), capacity(capacity)
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, block_alignment, capacity) != 0)
+        throw(std::bad_alloc());
+    data.reset(static_cast<char*>(p));
+}
+
+AsyncLogWriter::AsyncLogWriter(const std::string& log_file, const protobuf::LogWriterConfig& cfg)
+    : std::ostream(nullptr),
+      cfg_(cfg),
+      log_file_(log_file),
+      buffer_(*this),
+      queued_(cfg.max_queued_blocks() + 1),
+      free_(cfg.max_queued_blocks() + 1)
+{
+    if (cfg_.block_size() == 0)
+        cfg_.set_block_size(block_alignment);
+
+    fd_ = ::open(log_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd_ < 0)
+        throw(LogException("Failed to open " + log_file + ": " + std::strerror(errno)));
+
+    rdbuf(&buffer_);
+    writer_thread_ = std::thread([this]() { _run(); });
+}
+
+AsyncLogWriter::~AsyncLogWriter() { close(); }
+
+void AsyncLogWriter::close(bool force_sync)
+{
+    if (fd_ < 0)
+        return;
+
+    flush();
+    closing_ = true;
+    doorbell_.ring();
+    writer_thread_.join();
+
+    if (force_sync || cfg_.sync_policy() != protobuf::LogWriterConfig::SYNC_NEVER)
+        _sync();
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+goby::middleware::protobuf::LogWriterStatus AsyncLogWriter::status() const
+{
+    protobuf::LogWriterStatus status;
+    status.set_log_file(log_file_);
+    status.set_entries_accepted(entries_accepted_);
+    status.set_entries_dropped(entries_dropped_);
+    status.set_bytes_written(bytes_written_);
+    status.set_blocks_written(blocks_written_);
+    status.set_queued_blocks(queued_blocks_);
+    status.set_max_queued_blocks_seen(max_queued_blocks_seen_);
+    status.set_syncs(syncs_);
+    status.set_write_errors(write_errors_);
+    status.set_max_write_time_us(max_write_time_us_);
+    status.set_max_sync_time_us(max_sync_time_us_);
+    return status;
+}
+
+std::unique_ptr<AsyncLogWriter::Block> AsyncLogWriter::_get_block()
+{
+    std::unique_ptr<Block> block;
+    free_.consume([&block](std::unique_ptr<Block> b) { block = std::move(b); }, 1);
+    if (!block)
+        block.reset(new Block(cfg_.block_size()));
+    return block;
+}
+
+void AsyncLogWriter::_queue(std::unique_ptr<Block> block)
+{
+    update_max(max_queued_blocks_seen_, ++queued_blocks_);
+    queued_.push(std::move(block));
+    doorbell_.ring();
+}
+
+void AsyncLogWriter::_run()
+{
+    last_sync_ = std::chrono::steady_clock::now();
+    auto sync_interval = std::chrono::milliseconds(cfg_.sync_interval_ms());
+    bool interval_sync = (cfg_.sync_policy() == protobuf::LogWriterConfig::SYNC_INTERVAL);
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    for (;;)
+    {
+        // read before consuming so that everything queued before close() is written
+        bool closing = closing_;
+        queued_.consume([&blocks](std::unique_ptr<Block> b) { blocks.push_back(std::move(b)); },
+                        max_iov);
+
+        if (!blocks.empty())
+        {
+            _write(blocks);
+            queued_blocks_ -= blocks.size();
+            for (auto& b : blocks)
+            {
+                b->size = 0;
+                // if the pool is full, let this one be freed
+                free_.try_push(b);
+            }
+            blocks.clear();
+
+            if (cfg_.sync_policy() == protobuf::LogWriterConfig::SYNC_EVERY_WRITE)
+                _sync();
+        }
+        else if (closing)
+        {
+            break;
+        }
+        else
+        {
+            auto key = doorbell_.prepare_wait();
+            if (queued_blocks_ > 0 || closing_)
+                doorbell_.cancel_wait();
+            else if (interval_sync && unsynced_)
+                doorbell_.wait(key, last_sync_ + sync_interval);
+            else
+                doorbell_.wait(key, std::chrono::steady_clock::time_point::max());
+        }
+
+        if (interval_sync && unsynced_ &&
+            std::chrono::steady_clock::now() >= last_sync_ + sync_interval)
+            _sync();
+    }
+}
+
+void AsyncLogWriter::_write(std::vector<std::unique_ptr<Block>>& blocks)
+{
+    std::vector<struct iovec> iov;
+    iov.reserve(blocks.size());
+    for (const auto& b : blocks)
+    {
+        if (b->size > 0)
+            iov.push_back({b->data.get(), b->size});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto it = iov.begin();
+    while (it != iov.end())
+    {
+        ssize_t written = ::writev(fd_, &*it, iov.end() - it);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            ++write_errors_;
+            glog.is_warn() && glog << "Failed to write to " << log_file_ << ": "
+                                   << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        bytes_written_ += written;
+        unsynced_ = true;
+
+        // advance past what was written, which may end partway through a block
+        while (it != iov.end() && static_cast<std::size_t>(written) >= it->iov_len)
+        {
+            written -= it->iov_len;
+            ++it;
+        }
+        if (it != iov.end())
+        {
+            it->iov_base = static_cast<char*>(it->iov_base) + written;
+            it->iov_len -= written;
+        }
+    }
+
+    blocks_written_ += blocks.size();
+    update_max(max_write_time_us_,
+               static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - start)
+                                              .count()));
+}
+
+void AsyncLogWriter::_sync()
+{
+    if (!unsynced_)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    if (::fdatasync(fd_) != 0)
+    {
+        ++write_errors_;
+        glog.is_warn() && glog << "Failed to sync " << log_file_ << ": " << std::strerror(errno)
+                               << std::endl;
+    }
+    last_sync_ = std::chrono::steady_clock::now();
+    unsynced_ = false;
+    ++syncs_;
+    update_max(max_sync_time_us_,
+               static_cast<std::uint64_t>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(last_sync_ - start)
+                       .count()));
+}
+
+AsyncLogWriter::BlockBuffer::int_type AsyncLogWriter::BlockBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+
+    _commit();
+    _next_block();
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize AsyncLogWriter::BlockBuffer::xsputn(const char* s, std::streamsize n)
+{
+    std::streamsize remaining = n;
+    while (remaining > 0)
+    {
+        if (pptr() == epptr())
+        {
+            _commit();
+            _next_block();
+        }
+
+        std::streamsize count = std::min<std::streamsize>(remaining, epptr() - pptr());
+        std::memcpy(pptr(), s, count);
+        pbump(count);
+        s += count;
+        remaining -= count;
+    }
+    return n;
+}
+
+int AsyncLogWriter::BlockBuffer::sync()
+{
+    _commit();
+    return 0;
+}
+
+void AsyncLogWriter::BlockBuffer::_next_block()
+{
+    block_ = writer_._get_block();
+    setp(block_->data.get(), block_->data.get() + block_->capacity);
+    commit_deadline_ = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(writer_.cfg_.commit_interval_ms());
+}
+
+void AsyncLogWriter::BlockBuffer::_commit()
+{
+    if (!block_)
+        return;
+
+    block_->size = pptr() - pbase();
+    committed_bytes_ += block_->size;
+    setp(nullptr, nullptr);
+    if (block_->size > 0)
+        writer_._queue(std::move(block_));
+    else
+        block_.reset();
+}
@@ -0,0 +1,169 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AsyncLogWriter20261018H
+#define AsyncLogWriter20261018H
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/detail/doorbell.h"
+#include "goby/middleware/detail/mailbox.h"
+#include "goby/middleware/protobuf/log_writer.pb.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Output stream for a log file that queues large, aligned blocks to be written by a
+/// separate thread, so that the thread calling LogEntry::serialize() never waits on the disk
+///
+/// Use accept_entry() before serializing each entry: once max_queued_blocks full blocks are
+/// waiting to be written, entries are dropped (whole, so the file remains readable) rather than
+/// blocking the caller.
+class AsyncLogWriter : public std::ostream
+{
+  public:
+    /// \throw LogException if the file cannot be created
+    AsyncLogWriter(const std::string& log_file,
+                   const protobuf::LogWriterConfig& cfg = protobuf::LogWriterConfig());
+    ~AsyncLogWriter();
+
+    AsyncLogWriter(const AsyncLogWriter&) = delete;
+    AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+    /// \brief Call before serializing each entry
+    ///
+    /// \return false (and counts the entry as dropped) if too many blocks are waiting to be
+    /// written
+    bool accept_entry()
+    {
+        if (queued_blocks_.load(std::memory_order_relaxed) >= cfg_.max_queued_blocks())
+        {
+            ++entries_dropped_;
+            return false;
+        }
+        ++entries_accepted_;
+        return true;
+    }
+
+    /// \brief Queue the current (partial) block if commit_interval_ms has passed since it was
+    /// started. Call periodically so that entries are written even when little is being logged.
+    void commit_if_due()
+    {
+        if (buffer_.pending() && std::chrono::steady_clock::now() >= buffer_.commit_deadline())
+            flush();
+    }
+
+    /// \brief Write everything queued, sync (unless SYNC_NEVER and not force_sync), and close the
+    /// file
+    void close(bool force_sync = false);
+
+    /// \brief Total bytes written to this stream, including those not yet written to the file
+    /// (call from the thread writing to the stream)
+    std::uint64_t size() const { return buffer_.size(); }
+
+    /// \brief Counters (may be called from any thread)
+    protobuf::LogWriterStatus status() const;
+
+  private:
+    struct Block
+    {
+        Block(std::size_t capacity);
+        std::unique_ptr<char, decltype(&std::free)> data;
+        std::size_t capacity;
+        std::size_t size{0};
+    };
+
+    class BlockBuffer : public std::streambuf
+    {
+      public:
+        BlockBuffer(AsyncLogWriter& writer) : writer_(writer) {}
+
+        bool pending() const { return pptr() != pbase(); }
+        std::uint64_t size() const { return committed_bytes_ + (pptr() - pbase()); }
+        std::chrono::steady_clock::time_point commit_deadline() const { return commit_deadline_; }
+
+      protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char* s, std::streamsize n) override;
+        int sync() override;
+
+      private:
+        void _next_block();
+        void _commit();
+
+      private:
+        AsyncLogWriter& writer_;
+        std::unique_ptr<Block> block_;
+        std::chrono::steady_clock::time_point commit_deadline_;
+        std::uint64_t committed_bytes_{0};
+    };
+
+    std::unique_ptr<Block> _get_block();
+    void _queue(std::unique_ptr<Block> block);
+    void _run();
+    void _write(std::vector<std::unique_ptr<Block>>& blocks);
+    void _sync();
+
+  private:
+    protobuf::LogWriterConfig cfg_;
+    std::string log_file_;
+    int fd_{-1};
+    BlockBuffer buffer_;
+
+    // full (or committed) blocks for the writer thread, and empty blocks coming back
+    detail::Mailbox<std::unique_ptr<Block>> queued_;
+    detail::Mailbox<std::unique_ptr<Block>> free_;
+    detail::Doorbell doorbell_;
+    std::atomic<bool> closing_{false};
+    std::thread writer_thread_;
+
+    std::atomic<std::uint32_t> queued_blocks_{0};
+    std::atomic<std::uint32_t> max_queued_blocks_seen_{0};
+    std::atomic<std::uint64_t> entries_accepted_{0};
+    std::atomic<std::uint64_t> entries_dropped_{0};
+    std::atomic<std::uint64_t> bytes_written_{0};
+    std::atomic<std::uint64_t> blocks_written_{0};
+    std::atomic<std::uint64_t> syncs_{0};
+    std::atomic<std::uint64_t> write_errors_{0};
+    std::atomic<std::uint64_t> max_write_time_us_{0};
+    std::atomic<std::uint64_t> max_sync_time_us_{0};
+
+    // writer thread only
+    std::chrono::steady_clock::time_point last_sync_;
+    bool unsynced_{false};
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
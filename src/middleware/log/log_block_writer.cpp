@@ -0,0 +1,119 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "goby/util/debug_logger.h"
+
+#include "log_block_writer.h"
+
+using goby::glog;
+using goby::middleware::log::LogBlockWriter;
+using goby::middleware::log::LogEntry;
+
+LogBlockWriter::LogBlockWriter(std::ostream& out, const protobuf::LogCompressionConfig& cfg,
+                               const LogCodec* codec, LogIndex& index)
+    : out_(out),
+      index_(index),
+      cfg_(cfg),
+      codec_(codec ? *codec : LogCodec::find(cfg.codec())),
+      block_(&block_buffer_)
+{
+    block_buffer_.str().reserve(cfg_.block_size());
+}
+
+LogBlockWriter::~LogBlockWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch (std::exception& e)
+    {
+        glog.is_warn() && glog << "Failed to write final compressed block: " << e.what()
+                               << std::endl;
+    }
+}
+
+void LogBlockWriter::write(const LogEntry& entry)
+{
+    std::string& block = block_buffer_.str();
+    auto entry_start = block.size();
+    entry.serialize(&block_, &out_, index_);
+
+    // group index from the header of the entry just written
+    auto group_pos = entry_start + LogEntry::magic_bytes_ + LogEntry::size_bytes_ +
+                     LogEntry::scheme_bytes_;
+    groups_.insert((static_cast<std::uint16_t>(block[group_pos] & 0xff) << 8) |
+                   (block[group_pos + 1] & 0xff));
+
+    std::uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  entry.timestamp().time_since_epoch())
+                                  .count();
+    if (header_.entry_count == 0)
+    {
+        header_.begin = header_.end = timestamp;
+        block_deadline_ =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(cfg_.max_block_age_ms());
+    }
+    else
+    {
+        header_.begin = std::min(header_.begin, timestamp);
+        header_.end = std::max(header_.end, timestamp);
+    }
+    ++header_.entry_count;
+
+    if (block.size() >= cfg_.block_size())
+        flush();
+}
+
+void LogBlockWriter::flush()
+{
+    if (header_.entry_count == 0)
+        return;
+
+    std::string& block = block_buffer_.str();
+    header_.codec = codec_.id();
+    header_.uncompressed_size = block.size();
+    header_.group_indices.assign(groups_.begin(), groups_.end());
+
+    block_data_.clear();
+    header_.serialize(&block_data_);
+    codec_.compress(block.data(), block.size(), &block_data_, cfg_.level());
+
+    LogEntry block_entry(std::vector<unsigned char>(), LogEntry::scheme_block_, std::string(),
+                         DynamicGroup(std::string()),
+                         goby::time::SystemClock::time_point(
+                             std::chrono::microseconds(header_.begin)));
+    block_entry._serialize(&out_, index_.version, LogEntry::scheme_block_, 0, 0,
+                           block_data_.data(), block_data_.size());
+
+    glog.is_debug2() && glog << "Wrote compressed block of " << header_.entry_count
+                             << " entries: " << block.size() << " bytes to "
+                             << block_data_.size() << " bytes" << std::endl;
+
+    ++blocks_written_;
+    uncompressed_bytes_ += block.size();
+    compressed_bytes_ += block_data_.size();
+
+    block.clear();
+    groups_.clear();
+    header_ = LogBlockHeader();
+}
@@ -0,0 +1,131 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LogBlockWriter20261018H
+#define LogBlockWriter20261018H
+
+#include <chrono>
+#include <ostream>
+#include <set>
+#include <streambuf>
+#include <string>
+
+#include "goby/middleware/log/log_codec.h"
+#include "goby/middleware/log/log_entry.h"
+#include "goby/middleware/protobuf/log_writer.pb.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Groups LogEntries into compressed blocks (see LogBlockHeader) written to a .goby file
+///
+/// Group and type index entries, and anything else written directly to the output stream (such
+/// as the file descriptors written by the ProtobufPlugin write hooks), are written immediately
+/// and uncompressed, so they always precede the blocks that refer to them.
+class LogBlockWriter
+{
+  public:
+    /// \param out the log file stream (plugin write hooks should also be registered with it)
+    /// \param codec if set, use this codec (e.g. one added with LogCodec::add()) instead of
+    /// cfg.codec()
+    /// \param index the index of the file (e.g. LogWriter::index())
+    /// \throw LogException if the codec is not available
+    LogBlockWriter(std::ostream& out, const protobuf::LogCompressionConfig& cfg,
+                   const LogCodec* codec = nullptr, LogIndex& index = LogEntry::global_index());
+    /// \brief Writes the pending block (if any)
+    ~LogBlockWriter();
+
+    LogBlockWriter(const LogBlockWriter&) = delete;
+    LogBlockWriter& operator=(const LogBlockWriter&) = delete;
+
+    /// \brief Add an entry to the pending block, writing the block if it is then full
+    void write(const LogEntry& entry);
+
+    /// \brief Compress and write the pending entries (if any) as one block
+    void flush();
+
+    /// \brief flush() if the first pending entry has waited max_block_age_ms
+    void flush_if_due()
+    {
+        if (header_.entry_count > 0 && std::chrono::steady_clock::now() >= block_deadline_)
+            flush();
+    }
+
+    std::uint32_t pending_entries() const { return header_.entry_count; }
+    std::uint64_t blocks_written() const { return blocks_written_; }
+    /// \brief Bytes of entries written in blocks so far, before and after compression
+    std::uint64_t uncompressed_bytes() const { return uncompressed_bytes_; }
+    std::uint64_t compressed_bytes() const { return compressed_bytes_; }
+
+  private:
+    // appends to a std::string, so that the pending block is never copied
+    class StringBuffer : public std::streambuf
+    {
+      public:
+        std::string& str() { return s_; }
+
+      protected:
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+                s_.push_back(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override
+        {
+            s_.append(s, n);
+            return n;
+        }
+
+      private:
+        std::string s_;
+    };
+
+  private:
+    std::ostream& out_;
+    LogIndex& index_;
+    protobuf::LogCompressionConfig cfg_;
+    const LogCodec& codec_;
+
+    // the pending block: uncompressed entries and their summary
+    StringBuffer block_buffer_;
+    std::ostream block_;
+    LogBlockHeader header_;
+    std::set<std::uint16_t> groups_;
+    std::chrono::steady_clock::time_point block_deadline_;
+
+    // header followed by the compressed entries (reused between blocks)
+    std::string block_data_;
+
+    std::uint64_t blocks_written_{0};
+    std::uint64_t uncompressed_bytes_{0};
+    std::uint64_t compressed_bytes_{0};
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,131 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "goby/middleware/protobuf/log_writer.pb.h"
+
+#include "log_codec.h"
+
+using goby::middleware::log::LogCodec;
+using goby::middleware::log::LogException;
+using goby::middleware::protobuf::LogCompressionConfig;
+
+namespace
+{
+class NullCodec : public LogCodec
+{
+  public:
+    std::uint8_t id() const override { return LogCompressionConfig::NONE; }
+    std::string name() const override { return "none"; }
+
+    void compress(const char* in, std::size_t in_size, std::string* out,
+                  int /*level*/) const override
+    {
+        out->append(in, in_size);
+    }
+
+    void decompress(const char* in, std::size_t in_size, char* out,
+                    std::size_t out_size) const override
+    {
+        if (in_size != out_size)
+            throw(LogException("Uncompressed block is " + std::to_string(in_size) +
+                               " bytes, expected " + std::to_string(out_size)));
+        std::memcpy(out, in, in_size);
+    }
+};
+
+#ifdef HAS_ZLIB
+class ZlibCodec : public LogCodec
+{
+  public:
+    std::uint8_t id() const override { return LogCompressionConfig::ZLIB; }
+    std::string name() const override { return "zlib"; }
+
+    void compress(const char* in, std::size_t in_size, std::string* out,
+                  int level) const override
+    {
+        auto start = out->size();
+        uLongf compressed_size = compressBound(in_size);
+        out->resize(start + compressed_size);
+        auto result = compress2(reinterpret_cast<Bytef*>(&(*out)[start]), &compressed_size,
+                                reinterpret_cast<const Bytef*>(in), in_size, level);
+        if (result != Z_OK)
+            throw(LogException("zlib compression failed: " + std::to_string(result)));
+        out->resize(start + compressed_size);
+    }
+
+    void decompress(const char* in, std::size_t in_size, char* out,
+                    std::size_t out_size) const override
+    {
+        uLongf size = out_size;
+        auto result = uncompress(reinterpret_cast<Bytef*>(out), &size,
+                                 reinterpret_cast<const Bytef*>(in), in_size);
+        if (result != Z_OK || size != out_size)
+            throw(LogException("zlib decompression failed: " + std::to_string(result)));
+    }
+};
+#endif
+
+std::mutex codecs_mutex;
+
+std::map<int, std::unique_ptr<LogCodec>>& codecs()
+{
+    static std::map<int, std::unique_ptr<LogCodec>> codecs = []() {
+        std::map<int, std::unique_ptr<LogCodec>> built_in;
+        built_in[LogCompressionConfig::NONE].reset(new NullCodec);
+#ifdef HAS_ZLIB
+        built_in[LogCompressionConfig::ZLIB].reset(new ZlibCodec);
+#endif
+        return built_in;
+    }();
+    return codecs;
+}
+} // namespace
+
+const LogCodec& LogCodec::find(int id)
+{
+    std::lock_guard<std::mutex> lock(codecs_mutex);
+    auto it = codecs().find(id);
+    if (it == codecs().end())
+    {
+        std::string name = LogCompressionConfig::Codec_IsValid(id)
+                               ? LogCompressionConfig::Codec_Name(
+                                     static_cast<LogCompressionConfig::Codec>(id))
+                               : std::to_string(id);
+        throw(LogException("Compression codec " + name + " is not available in this build"));
+    }
+    return *it->second;
+}
+
+void LogCodec::add(std::unique_ptr<LogCodec> codec)
+{
+    std::lock_guard<std::mutex> lock(codecs_mutex);
+    auto id = codec->id();
+    codecs()[id] = std::move(codec);
+}
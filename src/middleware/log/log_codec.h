@@ -0,0 +1,75 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LogCodec20261018H
+#define LogCodec20261018H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "goby/middleware/log/log_entry.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Compression used for the compressed blocks of a .goby file (see LogBlockHeader)
+///
+/// Codecs are identified in each block header by id(). Ids below 128 are reserved for the codecs
+/// provided by Goby (which match goby::middleware::protobuf::LogCompressionConfig::Codec); others
+/// may be registered with add().
+class LogCodec
+{
+  public:
+    virtual ~LogCodec() = default;
+
+    virtual std::uint8_t id() const = 0;
+    virtual std::string name() const = 0;
+
+    /// \brief Append the compressed form of [in, in + in_size) to out
+    ///
+    /// \param level codec-specific compression level (higher is smaller but slower)
+    virtual void compress(const char* in, std::size_t in_size, std::string* out,
+                          int level) const = 0;
+
+    /// \brief Decompress [in, in + in_size) into exactly out_size bytes at out
+    ///
+    /// \throw LogException if the input is corrupt or does not decompress to out_size bytes
+    virtual void decompress(const char* in, std::size_t in_size, char* out,
+                            std::size_t out_size) const = 0;
+
+    /// \brief Find the codec with the given id
+    /// \throw LogException if there is no such codec (in this build)
+    static const LogCodec& find(int id);
+
+    /// \brief Register a codec (before reading or writing any blocks that use it)
+    static void add(std::unique_ptr<LogCodec> codec);
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
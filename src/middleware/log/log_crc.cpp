@@ -0,0 +1,133 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define GOBY_LOG_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define GOBY_LOG_CRC32C_ARMV8
+#endif
+
+#include "log_crc.h"
+
+namespace
+{
+// reflected Castagnoli polynomial
+constexpr std::uint32_t crc32c_poly{0x82F63B78};
+
+// "slicing-by-8": table[k][b] is the CRC of byte b followed by k zero bytes
+using Crc32cTables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+const Crc32cTables& crc32c_tables()
+{
+    static const Crc32cTables tables = []() {
+        Crc32cTables t;
+        for (std::uint32_t b = 0; b < 256; ++b)
+        {
+            std::uint32_t crc = b;
+            for (int i = 0; i < 8; ++i) crc = (crc >> 1) ^ ((crc & 1) ? crc32c_poly : 0);
+            t[0][b] = crc;
+        }
+        for (std::uint32_t b = 0; b < 256; ++b)
+        {
+            for (int k = 1; k < 8; ++k) t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+        }
+        return t;
+    }();
+    return tables;
+}
+
+std::uint32_t crc32c_software(std::uint32_t crc, const unsigned char* p, std::size_t size)
+{
+    const auto& t = crc32c_tables();
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8)
+    {
+        std::uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 |
+                                  static_cast<std::uint32_t>(p[3]) << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+              t[4][lo >> 24] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; --size, ++p) crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    return ~crc;
+}
+
+#if defined(GOBY_LOG_CRC32C_SSE42)
+__attribute__((target("sse4.2"))) std::uint32_t
+crc32c_hardware_impl(std::uint32_t crc, const unsigned char* p, std::size_t size)
+{
+    std::uint64_t crc64 = ~crc;
+    for (; size >= 8; size -= 8, p += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    std::uint32_t crc32 = crc64;
+    for (; size > 0; --size, ++p) crc32 = _mm_crc32_u8(crc32, *p);
+    return ~crc32;
+}
+
+bool cpu_has_crc32c() { return __builtin_cpu_supports("sse4.2"); }
+#elif defined(GOBY_LOG_CRC32C_ARMV8)
+std::uint32_t crc32c_hardware_impl(std::uint32_t crc, const unsigned char* p, std::size_t size)
+{
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for (; size > 0; --size, ++p) crc = __crc32cb(crc, *p);
+    return ~crc;
+}
+
+// the compiler was told the CPU has the CRC32 extension
+bool cpu_has_crc32c() { return true; }
+#else
+bool cpu_has_crc32c() { return false; }
+#endif
+
+using Crc32cFunction = std::uint32_t (*)(std::uint32_t, const unsigned char*, std::size_t);
+
+Crc32cFunction select_crc32c()
+{
+#if defined(GOBY_LOG_CRC32C_SSE42) || defined(GOBY_LOG_CRC32C_ARMV8)
+    if (cpu_has_crc32c())
+        return &crc32c_hardware_impl;
+#endif
+    return &crc32c_software;
+}
+} // namespace
+
+std::uint32_t goby::middleware::log::crc32c(std::uint32_t crc, const void* data, std::size_t size)
+{
+    static const Crc32cFunction f = select_crc32c();
+    return f(crc, static_cast<const unsigned char*>(data), size);
+}
+
+bool goby::middleware::log::crc32c_hardware() { return cpu_has_crc32c(); }
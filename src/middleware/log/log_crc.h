@@ -0,0 +1,75 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LogCrc20261018H
+#define LogCrc20261018H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/crc.hpp>
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief CRC-32C (Castagnoli) of size bytes, continuing from crc (the result for the preceding
+/// bytes, or 0 to start)
+///
+/// Uses the SSE4.2 (x86-64) or ARMv8 CRC32 instructions when the CPU has them.
+std::uint32_t crc32c(std::uint32_t crc, const void* data, std::size_t size);
+
+/// \brief true if crc32c() uses CPU instructions rather than lookup tables
+bool crc32c_hardware();
+
+/// \brief Checksum of a log entry: CRC-32 for file versions 1 to 3, and CRC-32C (see crc32c())
+/// from version 4
+class LogCrc
+{
+  public:
+    static constexpr std::uint32_t first_crc32c_version{4};
+
+    explicit LogCrc(std::uint32_t version) : castagnoli_(version >= first_crc32c_version) {}
+
+    void process_bytes(const void* data, std::size_t size)
+    {
+        if (castagnoli_)
+            crc32c_ = crc32c(crc32c_, data, size);
+        else
+            crc32_.process_bytes(data, size);
+    }
+
+    std::uint32_t checksum() const { return castagnoli_ ? crc32c_ : crc32_.checksum(); }
+
+  private:
+    bool castagnoli_;
+    std::uint32_t crc32c_{0};
+    boost::crc_32_type crc32_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -20,335 +20,478 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "log_codec.h"
 #include "log_entry.h"
 
 using goby::middleware::log::LogEntry;
 
-std::map<int, boost::bimap<std::string,
-                           goby::middleware::log::uint<LogEntry::group_bytes_>::type> >
-    LogEntry::groups_;
-std::map<int, boost::bimap<std::string,
-                           goby::middleware::log::uint<LogEntry::type_bytes_>::type> >
-    LogEntry::types_;
+goby::middleware::log::LogIndex LogEntry::global_index_;
 
-std::map<int, std::function<void(const std::string& type)> >
-    LogEntry::new_type_hook;
-std::map<int, std::function<void(const goby::middleware::Group& group)> >
-    LogEntry::new_group_hook;
+goby::middleware::log::uint<LogEntry::version_bytes_>::type& LogEntry::version_(
+    LogEntry::global_index_.version);
 
-std::map<goby::middleware::log::LogFilter, std::function<void(const std::vector<unsigned char>& data)> >
-    LogEntry::filter_hook;
+std::map<int, std::function<void(const std::string& type)> >& LogEntry::new_type_hook(
+    LogEntry::global_index_.hooks.new_type);
+std::map<int, std::function<void(const goby::middleware::Group& group)> >&
+    LogEntry::new_group_hook(LogEntry::global_index_.hooks.new_group);
 
-goby::middleware::log::uint<LogEntry::group_bytes_>::type
-    LogEntry::group_index_(1);
-goby::middleware::log::uint<LogEntry::type_bytes_>::type
-    LogEntry::type_index_(1);
+std::map<goby::middleware::log::LogFilter,
+         std::function<void(const std::vector<unsigned char>& data)> >&
+    LogEntry::filter_hook(LogEntry::global_index_.hooks.filter);
 
-goby::middleware::log::uint<LogEntry::version_bytes_>::type
-    LogEntry::version_(LogEntry::invalid_version);
+std::function<bool(const goby::middleware::log::LogBlockHeader& header)>&
+    LogEntry::block_filter(LogEntry::global_index_.hooks.block_filter);
 
-void LogEntry::parse_version(std::istream* s)
+const std::string LogEntry::magic_{"GBY3"};
+
+void LogEntry::reset()
+{
+    global_index_.hooks.clear();
+    reset_index();
+}
+
+void LogEntry::reset_index() { global_index_.reset(); }
+
+void goby::middleware::log::LogIndex::reset()
 {
-    version_ = read_one<uint<version_bytes_>::type>(s);
+    groups_.clear();
+    types_.clear();
+
+    block_stream_.str(std::string());
+    block_stream_.clear();
+
+    group_index_ = 1;
+    type_index_ = 1;
+    version = LogEntry::invalid_version;
+}
+
+void LogEntry::parse_version(std::istream* s, LogIndex& index)
+{
+    index.version = read_one<uint<version_bytes_>::type>(s);
 
     // Original file format didn't have a version, so "GB" would be the version bytes
     // (first two characters of the magic word)
-    if (version_ == string_to_netint<decltype(version_)>(magic_))
+    if (index.version == string_to_netint<decltype(index.version)>(magic_))
     {
-        version_ = 1;
+        index.version = 1;
         // rewind
         s->seekg(s->tellg() - std::ios::streamoff(version_bytes_));
     }
-    else if (version_ > current_version)
+    else if (index.version > current_version)
     {
-        glog.is_warn() && glog << "Version 0x" << std::hex << version_
+        glog.is_warn() && glog << "Version 0x" << std::hex << index.version
                                << " is invalid. Will try to read file using current version ("
                                << std::dec << current_version << ")" << std::endl;
-        version_ = current_version;
+        index.version = current_version;
     }
 
-    glog.is_verbose() && glog << "File version is " << version_ << std::endl;
+    glog.is_verbose() && glog << "File version is " << index.version << std::endl;
 }
 
-void LogEntry::parse(std::istream* s)
+void LogEntry::parse(std::istream* s, LogIndex& index)
 {
-    using namespace goby::util::logger;
-    using goby::glog;
-
-    if (version_ == invalid_version)
-        parse_version(s);
+    if (index.version == invalid_version)
+        parse_version(s, index);
 
     auto old_except_mask = s->exceptions();
     s->exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
+    index.block_stream_.exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
+
+    for (;;)
+    {
+        // finish the current compressed block before reading more of the file
+        if (index.block_stream_.rdbuf()->in_avail() > 0)
+        {
+            try
+            {
+                if (_parse_frame(&index.block_stream_, index))
+                    break;
+            }
+            catch (std::ios_base::failure& e)
+            {
+                index.block_stream_.str(std::string());
+                index.block_stream_.clear();
+                throw(log::LogException("Compressed block ended partway through an entry"));
+            }
+        }
+        else if (_parse_frame(s, index))
+        {
+            break;
+        }
+    }
+
+    s->exceptions(old_except_mask);
+}
+
+bool LogEntry::_parse_frame(std::istream* s, LogIndex& index)
+{
+    using namespace goby::util::logger;
+    using goby::glog;
 
     int legacy_scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
 
-    uint<scheme_bytes_>::type scheme(0);
+    char next_char = s->peek();
+    if (next_char != magic_[0])
+    {
+        glog.is(WARN) && glog << "Next byte [0x" << std::hex
+                              << (static_cast<int>(next_char) & 0xFF) << std::dec
+                              << "] is not the start of the expected magic word [" << magic_
+                              << "]. Seeking until next magic word." << std::endl;
+    }
+
+    char magic_read[magic_bytes_];
+    int discarded = 0;
 
-    bool filter_matched = false;
-    do
+    for (;;)
     {
-        char next_char = s->peek();
-        if (next_char != magic_[0])
+        s->read(magic_read, magic_bytes_);
+        if (magic_.compare(0, magic_bytes_, magic_read, magic_bytes_) == 0)
         {
-            glog.is(WARN) && glog << "Next byte [0x" << std::hex
-                                  << (static_cast<int>(next_char) & 0xFF) << std::dec
-                                  << "] is not the start of the expected magic word [" << magic_
-                                  << "]. Seeking until next magic word." << std::endl;
+            break;
         }
-
-        std::string magic_read(magic_.size(), '\0');
-        int discarded = 0;
-
-        for (;;)
+        else
         {
-            s->read(&magic_read[0], magic_.size());
-            if (magic_read == magic_)
-            {
-                break;
-            }
-            else
-            {
-                ++discarded;
-                // rewind to read the next byte
-                s->seekg(s->tellg() - std::ios::streamoff(magic_.size() - 1));
-            }
+            ++discarded;
+            // rewind to read the next byte
+            s->seekg(s->tellg() - std::ios::streamoff(magic_.size() - 1));
         }
+    }
 
-        if (discarded != 0)
-            glog.is(WARN) && glog << "Found next magic word after skipping " << discarded
-                                  << " bytes" << std::endl;
+    if (discarded != 0)
+        glog.is(WARN) && glog << "Found next magic word after skipping " << discarded
+                              << " bytes" << std::endl;
 
-        boost::crc_32_type crc;
-        crc.process_bytes(&magic_read[0], magic_.size());
+    LogCrc crc(index.version);
+    crc.process_bytes(magic_read, magic_bytes_);
 
-        auto size(read_one<uint<size_bytes_>::type>(s, &crc));
-        decltype(size) fixed_field_size = scheme_bytes_ + group_bytes_ + type_bytes_ + crc_bytes_;
+    auto size(read_one<uint<size_bytes_>::type>(s, &crc));
+    decltype(size) fixed_field_size = scheme_bytes_ + group_bytes_ + type_bytes_ + crc_bytes_;
+    if (index.version >= 3)
+        fixed_field_size += timestamp_bytes_;
 
-        if (size < fixed_field_size)
-            throw(log::LogException("Invalid size read: " + std::to_string(size) +
-                                    " as message must be at least " +
-                                    std::to_string(fixed_field_size) + " bytes long"));
+    if (size < fixed_field_size)
+        throw(log::LogException("Invalid size read: " + std::to_string(size) +
+                                " as message must be at least " +
+                                std::to_string(fixed_field_size) + " bytes long"));
 
-        auto data_size = size - fixed_field_size;
-        glog.is(DEBUG2) && glog << "Reading entry of " << size << " bytes (" << data_size
-                                << " bytes data)" << std::endl;
+    auto data_size = size - fixed_field_size;
+    glog.is(DEBUG2) && glog << "Reading entry of " << size << " bytes (" << data_size
+                            << " bytes data)" << std::endl;
 
-        scheme = read_one<uint<scheme_bytes_>::type>(s, &crc);
-        auto group_index(read_one<uint<group_bytes_>::type>(s, &crc));
-        auto type_index(read_one<uint<type_bytes_>::type>(s, &crc));
+    auto scheme = read_one<uint<scheme_bytes_>::type>(s, &crc);
+    auto group_index(read_one<uint<group_bytes_>::type>(s, &crc));
+    auto type_index(read_one<uint<type_bytes_>::type>(s, &crc));
 
-        auto data_start_pos = s->tellg();
-        try
-        {
-            data_.resize(data_size);
-            s->read(reinterpret_cast<char*>(&data_[0]), data_size);
+    timestamp_ = goby::time::SystemClock::time_point();
+    if (index.version >= 3)
+        timestamp_ += std::chrono::microseconds(
+            read_one<uint<timestamp_bytes_>::type>(s, &crc));
 
-            crc.process_bytes(&data_[0], data_.size());
+    auto data_start_pos = s->tellg();
+    try
+    {
+        data_.resize(data_size);
+        s->read(reinterpret_cast<char*>(&data_[0]), data_size);
 
-            auto calculated_crc = crc.checksum();
-            auto given_crc(read_one<uint<crc_bytes_>::type>(s));
+        crc.process_bytes(&data_[0], data_.size());
 
-            if (calculated_crc != given_crc)
-            {
-                // return to where we started reading data as the size might have been corrupt
-                s->seekg(data_start_pos);
-                data_.clear();
-                throw(
-                    log::LogException("Invalid CRC on packet: given: " + std::to_string(given_crc) +
-                                      ", calculated: " + std::to_string(calculated_crc)));
-            }
-        }
-        catch (std::ios_base::failure& e)
+        auto calculated_crc = crc.checksum();
+        auto given_crc(read_one<uint<crc_bytes_>::type>(s));
+
+        if (calculated_crc != given_crc)
         {
-            // clear EOF, etc.
-            s->clear();
-            // return to where data reading starting in case size was corrupted
+            // return to where we started reading data as the size might have been corrupt
             s->seekg(data_start_pos);
-            throw(log::LogException("Failed to read " + std::to_string(size) +
-                                    " bytes of data; seeking back to start of data read in hopes "
-                                    "of finding valid next message."));
+            data_.clear();
+            throw(
+                log::LogException("Invalid CRC on packet: given: " + std::to_string(given_crc) +
+                                  ", calculated: " + std::to_string(calculated_crc)));
         }
+    }
+    catch (std::ios_base::failure& e)
+    {
+        // clear EOF, etc.
+        s->clear();
+        // return to where data reading starting in case size was corrupted
+        s->seekg(data_start_pos);
+        throw(log::LogException("Failed to read " + std::to_string(size) +
+                                " bytes of data; seeking back to start of data read in hopes "
+                                "of finding valid next message."));
+    }
 
-        if (scheme == scheme_group_index_)
+    if (scheme == scheme_block_)
+    {
+        if (s == &index.block_stream_)
+        {
+            data_.clear();
+            throw(log::LogException("Compressed block found inside another compressed block"));
+        }
+        _read_block(index);
+        data_.clear();
+        return false;
+    }
+    else if (scheme == scheme_group_index_)
+    {
+        switch (index.version)
         {
-            switch (version_)
+            case 1:
             {
-                case 1:
-                {
-                    std::string group(data_.begin(), data_.end());
+                std::string group(data_.begin(), data_.end());
 
-                    // The first type of .goby files that used a single mapping of type/group
-                    // string for all schemes. This worked fine unless the two schemes are in use that had a common type name.
-                    glog.is(DEBUG1) && glog << "Mapping group [" << group
-                                            << "] to index: " << group_index << std::endl;
+                // The first type of .goby files that used a single mapping of type/group
+                // string for all schemes. This worked fine unless the two schemes are in use that had a common type name.
+                glog.is(DEBUG1) && glog << "Mapping group [" << group
+                                        << "] to index: " << group_index << std::endl;
 
-                    groups_[legacy_scheme].left.insert({group, group_index});
-                    break;
-                }
-
-                case 2:
-                {
-                    std::string group_scheme_str(data_.begin(), data_.begin() + scheme_bytes_);
-                    auto group_scheme =
-                        string_to_netint<uint<scheme_bytes_>::type>(group_scheme_str);
-
-                    std::string group(data_.begin() + scheme_bytes_, data_.end());
-                    glog.is(DEBUG1) && glog << "For scheme [" << group_scheme
-                                            << "], mapping group [" << group
-                                            << "] to index: " << group_index << std::endl;
-                    groups_[group_scheme].left.insert({group, group_index});
-
-                    if (new_group_hook[group_scheme])
-                        new_group_hook[group_scheme](goby::middleware::DynamicGroup(group));
-                    break;
-                }
+                index.groups_[legacy_scheme].left.insert({group, group_index});
+                break;
+            }
+
+            case 2:
+            case 3:
+            case 4:
+            {
+                auto group_scheme = array_to_netint<uint<scheme_bytes_>::type>(
+                    reinterpret_cast<const char*>(data_.data()));
+
+                std::string group(data_.begin() + scheme_bytes_, data_.end());
+                glog.is(DEBUG1) && glog << "For scheme [" << group_scheme
+                                        << "], mapping group [" << group
+                                        << "] to index: " << group_index << std::endl;
+                index.groups_[group_scheme].left.insert({group, group_index});
+
+                if (index.hooks.new_group[group_scheme])
+                    index.hooks.new_group[group_scheme](goby::middleware::DynamicGroup(group));
+                break;
             }
-            data_.clear();
         }
-        else if (scheme == scheme_type_index_)
+        data_.clear();
+        return false;
+    }
+    else if (scheme == scheme_type_index_)
+    {
+        switch (index.version)
         {
-            switch (version_)
+            case 1:
             {
-                case 1:
-                {
-                    std::string type(data_.begin(), data_.end());
-                    glog.is(DEBUG1) && glog << "Mapping type [" << type
-                                            << "] to index: " << type_index << std::endl;
-                    types_[legacy_scheme].left.insert({type, type_index});
-                    break;
-                }
-                case 2:
-                {
-                    std::string type_scheme_str(data_.begin(), data_.begin() + scheme_bytes_);
-                    auto type_scheme = string_to_netint<uint<scheme_bytes_>::type>(type_scheme_str);
-
-                    std::string type(data_.begin() + scheme_bytes_, data_.end());
-                    glog.is(DEBUG1) && glog << "For scheme [" << type_scheme << "], mapping type ["
-                                            << type << "] to index: " << type_index << std::endl;
-                    types_[type_scheme].left.insert({type, type_index});
-
-                    if (new_type_hook[type_scheme])
-                        new_type_hook[type_scheme](type);
-                    break;
-                }
+                std::string type(data_.begin(), data_.end());
+                glog.is(DEBUG1) && glog << "Mapping type [" << type
+                                        << "] to index: " << type_index << std::endl;
+                index.types_[legacy_scheme].left.insert({type, type_index});
+                break;
             }
+            case 2:
+            case 3:
+            case 4:
+            {
+                auto type_scheme = array_to_netint<uint<scheme_bytes_>::type>(
+                    reinterpret_cast<const char*>(data_.data()));
 
-            data_.clear();
+                std::string type(data_.begin() + scheme_bytes_, data_.end());
+                glog.is(DEBUG1) && glog << "For scheme [" << type_scheme << "], mapping type ["
+                                        << type << "] to index: " << type_index << std::endl;
+                index.types_[type_scheme].left.insert({type, type_index});
+
+                if (index.hooks.new_type[type_scheme])
+                    index.hooks.new_type[type_scheme](type);
+                break;
+            }
         }
-        else
-        {
-            scheme_ = scheme;
 
-            std::string type = "_unknown" + std::to_string(type_index) + "_";
-            auto type_it = types_[scheme].right.find(type_index),
-                 type_end_it = types_[scheme].right.end();
+        data_.clear();
+        return false;
+    }
+    else
+    {
+        scheme_ = scheme;
+
+        std::string type = "_unknown" + std::to_string(type_index) + "_";
+        auto type_it = index.types_[scheme].right.find(type_index),
+             type_end_it = index.types_[scheme].right.end();
 
-            switch (version_)
+        switch (index.version)
+        {
+            case 1:
             {
-                case 1:
-                {
-                    type_it = types_[legacy_scheme].right.find(type_index);
-                    type_end_it = types_[legacy_scheme].right.end();
-                }
-                case 2: break;
+                type_it = index.types_[legacy_scheme].right.find(type_index);
+                type_end_it = index.types_[legacy_scheme].right.end();
             }
+            case 2:
+            case 3:
+            case 4: break;
+        }
 
-            if (type_it != type_end_it)
-                type = type_it->second;
-            else
-                glog.is(WARN) && glog << "No type entry in file for type index: " << type_index
-                                      << std::endl;
+        if (type_it != type_end_it)
+            type = type_it->second;
+        else
+            glog.is(WARN) && glog << "No type entry in file for type index: " << type_index
+                                  << std::endl;
 
-            type_ = type;
+        type_ = type;
 
-            std::string group = "_unknown" + std::to_string(group_index) + "_";
-            auto group_it = groups_[scheme].right.find(group_index),
-                 group_end_it = groups_[scheme].right.end();
+        std::string group = "_unknown" + std::to_string(group_index) + "_";
+        auto group_it = index.groups_[scheme].right.find(group_index),
+             group_end_it = index.groups_[scheme].right.end();
 
-            switch (version_)
+        switch (index.version)
+        {
+            case 1:
             {
-                case 1:
-                {
-                    group_it = groups_[legacy_scheme].right.find(group_index);
-                    group_end_it = groups_[legacy_scheme].right.end();
-                }
-                case 2: break;
+                group_it = index.groups_[legacy_scheme].right.find(group_index);
+                group_end_it = index.groups_[legacy_scheme].right.end();
             }
+            case 2:
+            case 3:
+            case 4: break;
+        }
 
-            if (group_it != group_end_it)
-                group = group_it->second;
-            else
-                glog.is(WARN) && glog << "No group entry in file for group index: " << group_index
-                                      << std::endl;
+        if (group_it != group_end_it)
+            group = group_it->second;
+        else
+            glog.is(WARN) && glog << "No group entry in file for group index: " << group_index
+                                  << std::endl;
 
-            group_ = goby::middleware::DynamicGroup(group);
+        group_ = goby::middleware::DynamicGroup(group);
 
-            LogFilter filt{scheme_, group, type_};
-            if (filter_hook.count(filt))
-            {
-                filter_matched = true;
-                filter_hook[filt](data_);
-            }
-            else
-            {
-                filter_matched = false;
-            }
+        LogFilter filt{scheme_, group, type_};
+        if (index.hooks.filter.count(filt))
+        {
+            index.hooks.filter[filt](data_);
+            return false;
         }
-    } while (scheme == scheme_group_index_ || scheme == scheme_type_index_ || filter_matched);
+        return true;
+    }
+}
 
-    s->exceptions(old_except_mask);
+void LogEntry::_read_block(LogIndex& index)
+{
+    auto header = LogBlockHeader::parse(data_.data(), data_.size());
+    if (index.hooks.block_filter && !index.hooks.block_filter(header))
+    {
+        glog.is_debug2() && glog << "Skipping compressed block of " << header.entry_count
+                                 << " entries" << std::endl;
+        return;
+    }
+
+    std::string block(header.uncompressed_size, '\0');
+    LogCodec::find(header.codec)
+        .decompress(reinterpret_cast<const char*>(data_.data()) + header.size(),
+                    data_.size() - header.size(), &block[0], block.size());
+    glog.is_debug2() && glog << "Reading compressed block of " << header.entry_count
+                             << " entries (" << block.size() << " bytes)" << std::endl;
+    index.block_stream_.str(block);
+    index.block_stream_.clear();
 }
 
-void LogEntry::serialize(std::ostream* s) const
+std::set<std::string> LogEntry::block_groups(const LogBlockHeader& header)
+{
+    return global_index_.block_groups(header);
+}
+
+std::set<std::string>
+goby::middleware::log::LogIndex::block_groups(const LogBlockHeader& header) const
+{
+    std::set<std::string> names;
+    for (auto index : header.group_indices)
+    {
+        for (const auto& scheme_groups : groups_)
+        {
+            auto it = scheme_groups.second.right.find(index);
+            if (it != scheme_groups.second.right.end())
+                names.insert(it->second);
+        }
+    }
+    return names;
+}
+
+void LogEntry::serialize(std::ostream* s, std::ostream* index_s, LogIndex& index) const
 {
     auto old_except_mask = s->exceptions();
     s->exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
+    auto old_index_except_mask = index_s->exceptions();
+    index_s->exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
 
     // write version
-    if (version_ == invalid_version)
+    if (index.version == invalid_version)
     {
-        version_ = current_version;
-        std::string version_str(netint_to_string(version_));
-        s->write(version_str.data(), version_str.size());
+        index.version = current_version;
+        std::string version_str(netint_to_string(index.version));
+        index_s->write(version_str.data(), version_str.size());
     }
 
     std::string group(group_);
 
     // insert indexing entry if the first time we saw this group
-    if (groups_[scheme_].left.count(group) == 0)
+    if (index.groups_[scheme_].left.count(group) == 0)
     {
-        auto index = group_index_++;
-        groups_[scheme_].left.insert({group, index});
+        auto group_index = index.group_index_++;
+        index.groups_[scheme_].left.insert({group, group_index});
 
         std::string scheme_str(netint_to_string(scheme_));
         std::string scheme_plus_group = scheme_str + group;
-        _serialize(s, scheme_group_index_, index, 0, scheme_plus_group.data(),
-                   scheme_plus_group.size());
+        _serialize(index_s, index.version, scheme_group_index_, group_index, 0,
+                   scheme_plus_group.data(), scheme_plus_group.size());
 
-        if (new_group_hook[scheme_])
-            new_group_hook[scheme_](group_);
+        if (index.hooks.new_group[scheme_])
+            index.hooks.new_group[scheme_](group_);
     }
-    if (types_[scheme_].left.count(type_) == 0)
+    if (index.types_[scheme_].left.count(type_) == 0)
     {
-        auto index = type_index_++;
-        types_[scheme_].left.insert({type_, index});
+        auto type_index = index.type_index_++;
+        index.types_[scheme_].left.insert({type_, type_index});
 
         std::string scheme_str(netint_to_string(scheme_));
         std::string scheme_plus_type = scheme_str + type_;
-        _serialize(s, scheme_type_index_, 0, index, scheme_plus_type.data(),
-                   scheme_plus_type.size());
+        _serialize(index_s, index.version, scheme_type_index_, 0, type_index,
+                   scheme_plus_type.data(), scheme_plus_type.size());
 
-        if (new_type_hook[scheme_])
-            new_type_hook[scheme_](type_);
+        if (index.hooks.new_type[scheme_])
+            index.hooks.new_type[scheme_](type_);
     }
 
-    auto group_index = groups_[scheme_].left.at(group);
-    auto type_index = types_[scheme_].left.at(type_);
+    auto group_index = index.groups_[scheme_].left.at(group);
+    auto type_index = index.types_[scheme_].left.at(type_);
 
     // insert actual data
-    _serialize(s, scheme_, group_index, type_index, reinterpret_cast<const char*>(&data_[0]),
-               data_.size());
+    _serialize(s, index.version, scheme_, group_index, type_index,
+               reinterpret_cast<const char*>(&data_[0]), data_.size());
 
+    index_s->exceptions(old_index_except_mask);
     s->exceptions(old_except_mask);
 }
+
+void goby::middleware::log::LogBlockHeader::serialize(std::string* s) const
+{
+    auto append = [s](std::uint64_t u, int bytes) {
+        for (int i = bytes - 1; i >= 0; --i) s->push_back(static_cast<char>((u >> (i * 8)) & 0xff));
+    };
+    append(codec, 1);
+    append(entry_count, 4);
+    append(uncompressed_size, 4);
+    append(begin, 8);
+    append(end, 8);
+    append(group_indices.size(), 2);
+    for (auto index : group_indices) append(index, 2);
+}
+
+goby::middleware::log::LogBlockHeader
+goby::middleware::log::LogBlockHeader::parse(const unsigned char* data, std::size_t size)
+{
+    std::size_t pos = 0;
+    auto read = [&](int bytes) {
+        if (pos + bytes > size)
+            throw(LogException("Compressed block header is truncated"));
+        std::uint64_t u = 0;
+        for (int i = 0; i < bytes; ++i) u = (u << 8) | data[pos++];
+        return u;
+    };
+
+    LogBlockHeader header;
+    header.codec = read(1);
+    header.entry_count = read(4);
+    header.uncompressed_size = read(4);
+    header.begin = read(8);
+    header.end = read(8);
+    for (auto n = read(2); n > 0; --n) header.group_indices.push_back(read(2));
+    return header;
+}
@@ -23,15 +23,20 @@
 #ifndef LogEntry20171127H
 #define LogEntry20171127H
 
+#include <algorithm>
 #include <boost/bimap.hpp>
 #include <boost/crc.hpp>
 #include <cstdint>
+#include <set>
+#include <sstream>
 
 #include "goby/exception.h"
 #include "goby/util/debug_logger.h"
 
 #include "goby/middleware/group.h"
+#include "goby/middleware/log/log_crc.h"
 #include "goby/middleware/marshalling/interface.h"
+#include "goby/time/system_clock.h"
 
 namespace goby
 {
@@ -90,6 +95,59 @@ inline bool operator<(const LogFilter& a, const LogFilter& b)
 //inline bool operator==(const LogFilter& a, const LogFilter& b)
 //{ return a.scheme == b.scheme && a.group == b.group && a.type == b.type; }
 
+/// \brief Header of a compressed block of entries (version 3 and newer)
+///
+/// A block is stored as the data of an entry with scheme LogEntry::scheme_block_:
+/// [codec: 1][entries: 4][uncompressed size: 4][begin: 8][end: 8][groups: 2][group index: 2]...
+/// followed by the compressed entries, each serialized as usual. Group and type index entries
+/// are never compressed, so readers can skip blocks without losing them.
+struct LogBlockHeader
+{
+    /// LogCodec::id() of the codec used to compress the block
+    std::uint8_t codec{0};
+    std::uint32_t entry_count{0};
+    std::uint32_t uncompressed_size{0};
+    /// timestamps (microseconds since the UNIX epoch) of the earliest and latest entries
+    std::uint64_t begin{0};
+    std::uint64_t end{0};
+    /// indices (as in the entry headers) of the groups of the entries in the block
+    std::vector<std::uint16_t> group_indices;
+
+    static constexpr std::size_t fixed_size{1 + 4 + 4 + 8 + 8 + 2};
+    std::size_t size() const { return fixed_size + 2 * group_indices.size(); }
+
+    void serialize(std::string* s) const;
+    /// \throw LogException if size is too small to hold the header
+    static LogBlockHeader parse(const unsigned char* data, std::size_t size);
+};
+
+/// \brief Functions called while a log is read or written
+struct LogHooks
+{
+    /// \brief By scheme: called for each new type as its index entry is read or written
+    std::map<int, std::function<void(const std::string& type)> > new_type;
+    /// \brief By scheme: called for each new group as its index entry is read or written
+    std::map<int, std::function<void(const Group& group)> > new_group;
+    /// \brief Entries matching a filter are passed to its function rather than returned by
+    /// LogEntry::parse()
+    std::map<LogFilter, std::function<void(const std::vector<unsigned char>& data)> > filter;
+    /// \brief If set, compressed blocks for which this returns false are skipped by
+    /// LogEntry::parse() without being decompressed
+    std::function<bool(const LogBlockHeader& header)> block_filter;
+
+    void clear()
+    {
+        new_type.clear();
+        new_group.clear();
+        filter.clear();
+        block_filter = nullptr;
+    }
+};
+
+class LogIndex;
+class MappedLogReader;
+class LogBlockWriter;
+
 class LogEntry
 {
   public:
@@ -98,89 +156,158 @@ class LogEntry
     static constexpr int scheme_bytes_{2};
     static constexpr int group_bytes_{2};
     static constexpr int type_bytes_{2};
+    // version 3 and newer
+    static constexpr int timestamp_bytes_{8};
     static constexpr int crc_bytes_{4};
     static constexpr uint<scheme_bytes_>::type scheme_group_index_{0xFFFF};
     static constexpr uint<scheme_bytes_>::type scheme_type_index_{0xFFFE};
+    static constexpr uint<scheme_bytes_>::type scheme_block_{0xFFFD};
 
     static constexpr int version_bytes_{4};
-    static constexpr int current_version{2};
-    // "invalid_version" until version is read or written
-    static uint<version_bytes_>::type version_;
-    static constexpr decltype(version_) invalid_version{0};
+    // 4: CRC-32C rather than CRC-32 (see LogCrc)
+    static constexpr int current_version{4};
+    static constexpr uint<version_bytes_>::type invalid_version{0};
 
-    static std::map<int, std::function<void(const std::string& type)> > new_type_hook;
-    static std::map<int, std::function<void(const Group& group)> > new_group_hook;
+    // the version and hooks of global_index(), used by the functions without a LogIndex
+    // parameter: "invalid_version" until version is read or written
+    static uint<version_bytes_>::type& version_;
 
-    static std::map<LogFilter, std::function<void(const std::vector<unsigned char>& data)> >
+    static std::map<int, std::function<void(const std::string& type)> >& new_type_hook;
+    static std::map<int, std::function<void(const Group& group)> >& new_group_hook;
+
+    static std::map<LogFilter, std::function<void(const std::vector<unsigned char>& data)> >&
         filter_hook;
 
+    /// \brief If set, compressed blocks for which this returns false are skipped by parse()
+    /// without being decompressed
+    static std::function<bool(const LogBlockHeader& header)>& block_filter;
+
+    /// \brief The process-wide index and hooks, for reading or writing one log at a time
+    /// (use a LogReader or LogWriter for more)
+    static LogIndex& global_index() { return global_index_; }
+
   public:
-    LogEntry(const std::vector<unsigned char>& data, int scheme, const std::string& type,
-             const Group& group)
-        : data_(data), scheme_(scheme), type_(type), group_(std::string(group))
+    LogEntry(std::vector<unsigned char> data, int scheme, const std::string& type,
+             const Group& group,
+             goby::time::SystemClock::time_point timestamp = goby::time::SystemClock::now())
+        : data_(std::move(data)),
+          scheme_(scheme),
+          type_(type),
+          group_(std::string(group)),
+          timestamp_(timestamp)
     {
     }
 
     LogEntry() : group_("") {}
-    void parse_version(std::istream* s);
-    void parse(std::istream* s);
-
-    // [GBY3][size: 4][scheme: 2][group: 2][type: 2][data][crc32: 4]
+    void parse_version(std::istream* s) { parse_version(s, global_index_); }
+    void parse_version(std::istream* s, LogIndex& index);
+    void parse(std::istream* s) { parse(s, global_index_); }
+    /// \brief Read the next data entry, updating (and calling the hooks of) index, which must be
+    /// used for every entry of the file
+    void parse(std::istream* s, LogIndex& index);
+
+    // [GBY3][size: 4][scheme: 2][group: 2][type: 2][timestamp: 8][data][crc: 4]
+    // (no timestamp for versions 1 and 2; size counts everything after itself; crc is CRC-32
+    // before version 4 and CRC-32C from version 4)
     // if scheme == 0xFFFF what follows is not data, but the string value for the group index
     // if scheme == 0xFFFE what follows is not data, but the string value for the group index
-    void serialize(std::ostream* s) const;
+    // if scheme == 0xFFFD what follows is a compressed block of entries (see LogBlockHeader)
+    void serialize(std::ostream* s) const { serialize(s, s, global_index_); }
+
+    /// \brief Serialize the data entry to s, but the file version and any new group and type
+    /// index entries to index_s
+    void serialize(std::ostream* s, std::ostream* index_s) const
+    {
+        serialize(s, index_s, global_index_);
+    }
+
+    /// \brief As above, using (and updating) index, which must be used for every entry of the
+    /// file
+    void serialize(std::ostream* s, std::ostream* index_s, LogIndex& index) const;
+
+    /// \brief Names of the groups in a block, from the group index entries parsed so far
+    static std::set<std::string> block_groups(const LogBlockHeader& header);
 
     const std::vector<unsigned char>& data() const { return data_; }
     int scheme() const { return scheme_; }
     const std::string& type() const { return type_; }
     const Group& group() const { return group_; }
-    static void reset()
-    {
-        groups_.clear();
-        types_.clear();
-        new_type_hook.clear();
-        new_group_hook.clear();
-        filter_hook.clear();
-
-        group_index_ = 1;
-        type_index_ = 1;
-        version_ = invalid_version;
-    }
+    /// \brief Time the entry was logged (zero for files older than version 3)
+    goby::time::SystemClock::time_point timestamp() const { return timestamp_; }
+    /// \brief Clear the hooks and reset_index() of global_index()
+    static void reset();
+
+    /// \brief Forget the file version and the group and type indices written or read so far, but
+    /// keep the hooks: use before writing a new file, which then gets its own index entries
+    static void reset_index();
 
   private:
-    void _serialize(std::ostream* s, uint<scheme_bytes_>::type scheme,
-                    uint<group_bytes_>::type group_index, uint<type_bytes_>::type type_index,
-                    const char* data, int data_size) const
+    // reads one entry; returns true if it is a data entry to return from parse()
+    bool _parse_frame(std::istream* s, LogIndex& index);
+    // makes the block in data_ the source of the next entries (unless block_filter rejects it)
+    void _read_block(LogIndex& index);
+
+    void _serialize(std::ostream* s, uint<version_bytes_>::type version,
+                    uint<scheme_bytes_>::type scheme, uint<group_bytes_>::type group_index,
+                    uint<type_bytes_>::type type_index, const char* data, int data_size) const
     {
-        std::string group_str(netint_to_string(group_index));
-        std::string type_str(netint_to_string(type_index));
-        std::string scheme_str(netint_to_string(scheme));
-
+        int timestamp_size = (version >= 3) ? timestamp_bytes_ : 0;
         uint<size_bytes_>::type size =
-            scheme_bytes_ + group_bytes_ + type_bytes_ + data_size + crc_bytes_;
-        std::string size_str(netint_to_string(size));
-
-        auto header = magic_ + size_str + scheme_str + group_str + type_str;
-        s->write(header.data(), header.size());
+            scheme_bytes_ + group_bytes_ + type_bytes_ + timestamp_size + data_size + crc_bytes_;
+
+        // build the header in place rather than from temporary strings
+        constexpr int max_header_size = magic_bytes_ + size_bytes_ + scheme_bytes_ +
+                                        group_bytes_ + type_bytes_ + timestamp_bytes_;
+        char header[max_header_size];
+        char* h = std::copy(magic_.begin(), magic_.end(), header);
+        h = netint_to_array(size, h);
+        h = netint_to_array(scheme, h);
+        h = netint_to_array(group_index, h);
+        h = netint_to_array(type_index, h);
+        if (timestamp_size)
+            h = netint_to_array(static_cast<uint<timestamp_bytes_>::type>(
+                                    timestamp_.time_since_epoch() / std::chrono::microseconds(1)),
+                                h);
+        int header_size = h - header;
+
+        s->write(header, header_size);
         s->write(data, data_size);
 
-        boost::crc_32_type crc;
-        crc.process_bytes(header.data(), header.size());
+        LogCrc crc(version);
+        crc.process_bytes(header, header_size);
         crc.process_bytes(data, data_size);
 
-        uint<crc_bytes_>::type cs(crc.checksum());
-        std::string cs_str(netint_to_string(cs));
-        s->write(cs_str.data(), cs_str.size());
+        char cs[crc_bytes_];
+        netint_to_array(static_cast<uint<crc_bytes_>::type>(crc.checksum()), cs);
+        s->write(cs, crc_bytes_);
     }
 
-    template <typename Unsigned> Unsigned read_one(std::istream* s, boost::crc_32_type* crc = 0)
+    // writes u big-endian to out, returning the end of what was written
+    template <typename Unsigned> static char* netint_to_array(Unsigned u, char* out)
     {
-        auto size = std::numeric_limits<Unsigned>::digits / 8;
-        std::string str(size, '\0');
-        s->read(&str[0], size);
+        constexpr int size = std::numeric_limits<Unsigned>::digits / 8;
+        for (int i = 0; i < size; ++i) out[i] = (u >> (size - (i + 1)) * 8) & 0xff;
+        return out + size;
+    }
+
+    template <typename Unsigned> Unsigned read_one(std::istream* s, LogCrc* crc = 0)
+    {
+        constexpr int size = std::numeric_limits<Unsigned>::digits / 8;
+        char bytes[size];
+        s->read(bytes, size);
         if (crc)
-            crc->process_bytes(&str[0], size);
-        return string_to_netint<Unsigned>(str);
+            crc->process_bytes(bytes, size);
+        return array_to_netint<Unsigned>(bytes);
+    }
+
+    // reads a big-endian Unsigned from in
+    template <typename Unsigned> static Unsigned array_to_netint(const char* in)
+    {
+        constexpr int size = std::numeric_limits<Unsigned>::digits / 8;
+        Unsigned u(0);
+        for (int i = 0; i < size; ++i)
+            u |= static_cast<Unsigned>(in[i] & 0xff) << ((size - (i + 1)) * 8);
+        return u;
     }
 
     template <typename Unsigned> std::string netint_to_string(Unsigned u) const
@@ -191,16 +318,13 @@ class LogEntry
         return s;
     }
 
-    template <typename Unsigned> Unsigned string_to_netint(std::string s) const
+    // as if s were truncated, or padded with leading zeros, to the size of Unsigned
+    template <typename Unsigned> Unsigned string_to_netint(const std::string& s) const
     {
-        Unsigned u(0);
         std::string::size_type size = std::numeric_limits<Unsigned>::digits / 8;
-        if (s.size() > size)
-            s.erase(0, s.size() - size);
-        if (s.size() < size)
-            s.insert(0, size - s.size(), '\0');
-
-        for (decltype(size) i = 0; i < size; ++i) u |= (s[i] & 0xff) << ((size - (i + 1)) * 8);
+        Unsigned u(0);
+        for (auto i = (s.size() > size) ? s.size() - size : 0; i < s.size(); ++i)
+            u = static_cast<Unsigned>(u << 8) | static_cast<Unsigned>(s[i] & 0xff);
         return u;
     }
 
@@ -209,16 +333,47 @@ class LogEntry
     uint<scheme_bytes_>::type scheme_;
     std::string type_;
     DynamicGroup group_;
+    goby::time::SystemClock::time_point timestamp_;
 
-    // map (scheme -> map (group_name -> group_index)
-    static std::map<int, boost::bimap<std::string, uint<group_bytes_>::type> > groups_;
-    static uint<group_bytes_>::type group_index_;
+    static const std::string magic_;
+
+    static LogIndex global_index_;
+
+    friend class MappedLogReader;
+    friend class LogBlockWriter;
+};
+
+/// \brief The state of one log file being read or written: its version, the group and type
+/// index tables, and the hooks
+///
+/// Each file read or written needs its own, used for all of its entries (LogReader and LogWriter
+/// each own one). Separate LogIndex objects may be used from separate threads.
+class LogIndex
+{
+  public:
+    LogHooks hooks;
+    /// LogEntry::invalid_version until the version is read or written
+    uint<LogEntry::version_bytes_>::type version{LogEntry::invalid_version};
+
+    /// \brief Names of the groups in a block, from the group index entries parsed so far
+    std::set<std::string> block_groups(const LogBlockHeader& header) const;
+
+    /// \brief Forget the version and the group and type indices, but keep the hooks
+    void reset();
+
+  private:
+    friend class LogEntry;
 
     // map (scheme -> map (group_name -> group_index)
-    static std::map<int, boost::bimap<std::string, uint<type_bytes_>::type> > types_;
-    static uint<type_bytes_>::type type_index_;
+    std::map<int, boost::bimap<std::string, uint<LogEntry::group_bytes_>::type> > groups_;
+    uint<LogEntry::group_bytes_>::type group_index_{1};
+
+    // map (scheme -> map (type_name -> type_index)
+    std::map<int, boost::bimap<std::string, uint<LogEntry::type_bytes_>::type> > types_;
+    uint<LogEntry::type_bytes_>::type type_index_{1};
 
-    const std::string magic_{"GBY3"};
+    // remaining entries of the compressed block being read
+    std::istringstream block_stream_;
 };
 
 } // namespace middleware
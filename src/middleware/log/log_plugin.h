@@ -39,7 +39,9 @@ class LogPlugin
     LogPlugin() {}
     virtual ~LogPlugin() {}
 
-    virtual void register_write_hooks(std::ofstream& out_log_file) = 0;
+    /// \brief Register the hooks that write any metadata needed to read this scheme's entries
+    /// (called again for each new file, which must then get its own copy of the metadata)
+    virtual void register_write_hooks(std::ostream& out_log_file) = 0;
     virtual void register_read_hooks(const std::ifstream& in_log_file) = 0;
 
     virtual std::string debug_text_message(LogEntry& log_entry)
@@ -0,0 +1,73 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LogReader20261018H
+#define LogReader20261018H
+
+#include <istream>
+
+#include "goby/middleware/log/log_entry.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Reads the entries of one .goby file using its own index tables and hooks
+///
+/// Unlike LogEntry::parse(std::istream*), which uses LogEntry::global_index(), any number of
+/// LogReader and LogWriter objects may be in use at once (each by one thread at a time).
+class LogReader
+{
+  public:
+    explicit LogReader(std::istream& in) : in_(in) {}
+
+    /// \brief Read the next data entry (index entries and those consumed by a filter hook are
+    /// handled along the way)
+    ///
+    /// \throw LogException if an entry is corrupt: the next read() resumes after it
+    /// \throw std::ios_base::failure at the end of the input
+    LogEntry read()
+    {
+        LogEntry entry;
+        entry.parse(&in_, index_);
+        return entry;
+    }
+
+    /// \brief Hooks for this file only (e.g. for LogPlugin::register_read_hooks())
+    LogHooks& hooks() { return index_.hooks; }
+    LogIndex& index() { return index_; }
+
+    /// \brief File version (LogEntry::invalid_version until the first read())
+    int version() const { return index_.version; }
+
+  private:
+    std::istream& in_;
+    LogIndex index_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
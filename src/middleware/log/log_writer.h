@@ -0,0 +1,64 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LogWriter20261018H
+#define LogWriter20261018H
+
+#include <ostream>
+
+#include "goby/middleware/log/log_entry.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Writes the entries of one .goby file using its own index tables and hooks
+///
+/// Unlike LogEntry::serialize(std::ostream*), which uses LogEntry::global_index(), any number of
+/// LogReader and LogWriter objects may be in use at once (each by one thread at a time). To write
+/// compressed blocks, pass index() to the LogBlockWriter.
+class LogWriter
+{
+  public:
+    explicit LogWriter(std::ostream& out) : out_(out) {}
+
+    /// \brief Write the entry, preceded by the file version and any new group and type index
+    /// entries
+    void write(const LogEntry& entry) { entry.serialize(&out_, &out_, index_); }
+
+    /// \brief Hooks for this file only (e.g. for LogPlugin::register_write_hooks())
+    LogHooks& hooks() { return index_.hooks; }
+    LogIndex& index() { return index_; }
+    std::ostream& stream() { return out_; }
+
+  private:
+    std::ostream& out_;
+    LogIndex index_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,723 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_codec.h"
+#include "mapped_log_reader.h"
+
+using goby::glog;
+using goby::middleware::log::LogBlockHeader;
+using goby::middleware::log::LogCodec;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogException;
+using goby::middleware::log::MappedLogReader;
+
+namespace
+{
+const std::string sidecar_magic{"GBYI"};
+constexpr std::uint32_t sidecar_version{2};
+// the CRC of (up to) this many bytes at the start of the log identifies it in the sidecar file
+constexpr std::uint64_t max_prefix_size{4096};
+
+template <typename Unsigned> Unsigned read_netint(const unsigned char* p)
+{
+    Unsigned u(0);
+    for (int i = 0, n = std::numeric_limits<Unsigned>::digits / 8; i < n; ++i)
+        u = (u << 8) | p[i];
+    return u;
+}
+
+template <typename Unsigned> void append_netint(std::string& s, Unsigned u)
+{
+    for (int i = std::numeric_limits<Unsigned>::digits / 8 - 1; i >= 0; --i)
+        s.push_back(static_cast<char>((u >> (i * 8)) & 0xff));
+}
+
+// reads big-endian integers and strings from the sidecar file, throwing on overrun
+class SidecarParser
+{
+  public:
+    SidecarParser(const std::string& s) : s_(s) {}
+
+    template <typename Unsigned> Unsigned read()
+    {
+        auto size = std::numeric_limits<Unsigned>::digits / 8;
+        check(size);
+        auto u = read_netint<Unsigned>(reinterpret_cast<const unsigned char*>(&s_[pos_]));
+        pos_ += size;
+        return u;
+    }
+
+    std::string read_string(std::size_t size)
+    {
+        check(size);
+        std::string r(s_.substr(pos_, size));
+        pos_ += size;
+        return r;
+    }
+
+  private:
+    void check(std::size_t size)
+    {
+        if (pos_ + size > s_.size())
+            throw(LogException("Sidecar index file is truncated"));
+    }
+
+    const std::string& s_;
+    std::size_t pos_{0};
+};
+} // namespace
+
+MappedLogReader::MappedLogReader(const std::string& log_file, bool use_sidecar,
+                                 const LogHooks& hooks)
+    : sidecar_file_(use_sidecar ? log_file + ".idx" : "")
+{
+    _map(log_file);
+    _read_version();
+
+    bool from_sidecar = false;
+    if (use_sidecar)
+    {
+        try
+        {
+            from_sidecar = _load_sidecar();
+        }
+        catch (LogException& e)
+        {
+            glog.is_warn() && glog << "Ignoring sidecar index " << sidecar_file_ << ": " << e.what()
+                                   << std::endl;
+        }
+    }
+
+    if (!from_sidecar)
+    {
+        groups_.clear();
+        types_.clear();
+        all_entries_.clear();
+        blocks_.clear();
+        bytes_skipped_ = 0;
+        indexed_bytes_ = (version_ == 1) ? 0 : LogEntry::version_bytes_;
+        index_source_ = IndexSource::BUILT;
+        _scan(indexed_bytes_);
+    }
+
+    if (use_sidecar && index_source_ != IndexSource::SIDECAR)
+        _write_sidecar();
+
+    _finalize(hooks);
+}
+
+MappedLogReader::~MappedLogReader()
+{
+    if (map_)
+        munmap(const_cast<unsigned char*>(map_), map_size_);
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void MappedLogReader::_map(const std::string& log_file)
+{
+    fd_ = open(log_file.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        throw(LogException("Failed to open " + log_file + ": " + std::strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0)
+        throw(LogException("Failed to stat " + log_file + ": " + std::strerror(errno)));
+    map_size_ = st.st_size;
+
+    // mmap() of zero bytes is invalid, and there's nothing to read anyway
+    if (map_size_ == 0)
+        return;
+
+    void* addr = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED)
+        throw(LogException("Failed to mmap " + log_file + ": " + std::strerror(errno)));
+    map_ = static_cast<const unsigned char*>(addr);
+}
+
+void MappedLogReader::_read_version()
+{
+    if (map_size_ < LogEntry::version_bytes_)
+    {
+        version_ = LogEntry::current_version;
+        return;
+    }
+
+    version_ = read_netint<decltype(version_)>(map_);
+
+    // Original file format didn't have a version, so the version bytes are the magic word
+    if (version_ == read_netint<decltype(version_)>(
+                        reinterpret_cast<const unsigned char*>(LogEntry::magic_.data())))
+    {
+        version_ = 1;
+    }
+    else if (version_ > LogEntry::current_version)
+    {
+        glog.is_warn() && glog << "Version 0x" << std::hex << version_
+                               << " is invalid. Will try to read file using current version ("
+                               << std::dec << LogEntry::current_version << ")" << std::endl;
+        version_ = LogEntry::current_version;
+    }
+}
+
+void MappedLogReader::_scan(std::uint64_t from)
+{
+    indexed_bytes_ = _scan_entries(map_, map_size_, from, 0);
+}
+
+std::uint64_t MappedLogReader::_scan_entries(const unsigned char* base, std::uint64_t base_size,
+                                             std::uint64_t from, std::uint32_t block)
+{
+    const auto& magic = LogEntry::magic_;
+    const auto* magic_begin = reinterpret_cast<const unsigned char*>(magic.data());
+    const auto* magic_end = magic_begin + magic.size();
+
+    constexpr std::uint64_t header_size = LogEntry::magic_bytes_ + LogEntry::size_bytes_;
+    const std::uint64_t timestamp_size = (version_ >= 3) ? LogEntry::timestamp_bytes_ : 0;
+    const std::uint64_t fixed_field_size = LogEntry::scheme_bytes_ + LogEntry::group_bytes_ +
+                                           LogEntry::type_bytes_ + timestamp_size +
+                                           LogEntry::crc_bytes_;
+
+    const unsigned char* end = base + base_size;
+    std::uint64_t pos = from;
+    std::uint64_t indexed = from;
+    while (pos < base_size)
+    {
+        const unsigned char* start = std::search(base + pos, end, magic_begin, magic_end);
+        if (start == end)
+            break;
+
+        if (start != base + pos)
+        {
+            glog.is_warn() && glog << "Found next magic word after skipping "
+                                   << (start - (base + pos)) << " bytes" << std::endl;
+            bytes_skipped_ += start - (base + pos);
+        }
+
+        std::uint64_t entry_pos = start - base;
+        // incomplete (possibly still being written)
+        if (entry_pos + header_size > base_size)
+            break;
+
+        auto size = read_netint<uint<LogEntry::size_bytes_>::type>(start + LogEntry::magic_bytes_);
+        pos = entry_pos + header_size;
+
+        if (size < fixed_field_size)
+        {
+            glog.is_warn() && glog << "Invalid size read: " << size
+                                   << " as message must be at least " << fixed_field_size
+                                   << " bytes long" << std::endl;
+            continue;
+        }
+
+        // either still being written or a corrupt size: look for a later entry
+        if (entry_pos + header_size + size > base_size)
+            continue;
+
+        const unsigned char* crc_pos = start + header_size + size - LogEntry::crc_bytes_;
+        LogCrc crc(version_);
+        crc.process_bytes(start, crc_pos - start);
+        auto given_crc = read_netint<uint<LogEntry::crc_bytes_>::type>(crc_pos);
+        if (crc.checksum() != given_crc)
+        {
+            glog.is_warn() && glog << "Invalid CRC on entry at byte " << entry_pos << ": given: "
+                                   << given_crc << ", calculated: " << crc.checksum() << std::endl;
+            continue;
+        }
+
+        const unsigned char* p = start + header_size;
+        LogIndexEntry e;
+        e.scheme = read_netint<decltype(e.scheme)>(p);
+        p += LogEntry::scheme_bytes_;
+        e.group_index = read_netint<decltype(e.group_index)>(p);
+        p += LogEntry::group_bytes_;
+        e.type_index = read_netint<decltype(e.type_index)>(p);
+        p += LogEntry::type_bytes_;
+        e.timestamp = 0;
+        if (timestamp_size)
+            e.timestamp = read_netint<uint<LogEntry::timestamp_bytes_>::type>(p);
+        p += timestamp_size;
+        e.offset = p - base;
+        e.data_size = size - fixed_field_size;
+        e.block = block;
+
+        if (e.scheme == LogEntry::scheme_block_)
+        {
+            if (block == 0)
+                _scan_block(e.offset, e.data_size);
+            else
+                glog.is_warn() && glog << "Ignoring compressed block inside compressed block "
+                                       << block << std::endl;
+        }
+        else
+        {
+            _add_index_record(e, LogDataView(p, e.data_size));
+        }
+
+        pos = indexed = entry_pos + header_size + size;
+    }
+    return indexed;
+}
+
+void MappedLogReader::_scan_block(std::uint64_t offset, std::uint32_t size)
+{
+    BlockInfo info{offset, size};
+    std::string block;
+    try
+    {
+        block = _decompress(info);
+    }
+    catch (LogException& e)
+    {
+        glog.is_warn() && glog << "Skipping compressed block at byte " << offset << ": "
+                               << e.what() << std::endl;
+        bytes_skipped_ += size;
+        return;
+    }
+
+    blocks_.push_back(info);
+    const auto* begin = reinterpret_cast<const unsigned char*>(block.data());
+    auto indexed = _scan_entries(begin, block.size(), 0, blocks_.size());
+    if (indexed != block.size())
+    {
+        glog.is_warn() && glog << "Compressed block at byte " << offset << " ends partway through "
+                               << "an entry" << std::endl;
+        bytes_skipped_ += block.size() - indexed;
+    }
+}
+
+std::string MappedLogReader::_decompress(const BlockInfo& block) const
+{
+    auto header = LogBlockHeader::parse(map_ + block.offset, block.size);
+    std::string uncompressed(header.uncompressed_size, '\0');
+    LogCodec::find(header.codec)
+        .decompress(reinterpret_cast<const char*>(map_ + block.offset) + header.size(),
+                    block.size - header.size(), &uncompressed[0], uncompressed.size());
+    return uncompressed;
+}
+
+std::shared_ptr<const std::string> MappedLogReader::_block(std::uint32_t block) const
+{
+    // moves the block to the front if it is cached (block_cache_mutex_ must be held)
+    auto find_cached = [this, block]() -> std::shared_ptr<const std::string> {
+        for (auto it = block_cache_.begin(), end = block_cache_.end(); it != end; ++it)
+        {
+            if (it->first == block)
+            {
+                auto cached = *it;
+                block_cache_.erase(it);
+                block_cache_.push_front(cached);
+                return cached.second;
+            }
+        }
+        return nullptr;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(block_cache_mutex_);
+        if (auto cached = find_cached())
+            return cached;
+    }
+
+    // decompress without holding the lock; if another thread got there first, use theirs
+    auto uncompressed = std::make_shared<const std::string>(_decompress(blocks_.at(block - 1)));
+    std::lock_guard<std::mutex> lock(block_cache_mutex_);
+    if (auto cached = find_cached())
+        return cached;
+    block_cache_.emplace_front(block, uncompressed);
+    while (block_cache_.size() > max_cached_blocks_) block_cache_.pop_back();
+    return uncompressed;
+}
+
+void MappedLogReader::set_max_cached_blocks(std::size_t n)
+{
+    std::lock_guard<std::mutex> lock(block_cache_mutex_);
+    max_cached_blocks_ = std::max<std::size_t>(n, 1);
+    while (block_cache_.size() > max_cached_blocks_) block_cache_.pop_back();
+}
+
+goby::middleware::log::LogDataView MappedLogReader::_data(const LogIndexEntry& e) const
+{
+    if (e.block == 0)
+        return LogDataView(map_ + e.offset, e.data_size);
+
+    auto block = _block(e.block);
+    const auto* base = reinterpret_cast<const unsigned char*>(block->data());
+    return LogDataView(base + e.offset, e.data_size, std::move(block));
+}
+
+void MappedLogReader::_add_index_record(const LogIndexEntry& e, LogDataView data)
+{
+    bool is_group = (e.scheme == LogEntry::scheme_group_index_);
+    bool is_type = (e.scheme == LogEntry::scheme_type_index_);
+
+    if (!is_group && !is_type)
+    {
+        all_entries_.push_back(e);
+        return;
+    }
+
+    int scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+    const unsigned char* name_begin = data.begin();
+    if (version_ != 1)
+    {
+        if (data.size() < LogEntry::scheme_bytes_)
+        {
+            glog.is_warn() && glog << "Index entry too short to contain a scheme" << std::endl;
+            return;
+        }
+        scheme = read_netint<uint<LogEntry::scheme_bytes_>::type>(name_begin);
+        name_begin += LogEntry::scheme_bytes_;
+    }
+
+    std::string name(name_begin, data.end());
+    if (is_group)
+        groups_[scheme].emplace(e.group_index, name);
+    else
+        types_[scheme].emplace(e.type_index, name);
+}
+
+const std::string& MappedLogReader::_lookup(const std::map<int, std::map<int, std::string>>& names,
+                                            int scheme, int index, const std::string& kind) const
+{
+    static const std::string unknown_prefix("_unknown");
+    // v1 used one mapping for all schemes
+    if (version_ == 1)
+        scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+
+    auto scheme_it = names.find(scheme);
+    if (scheme_it != names.end())
+    {
+        auto it = scheme_it->second.find(index);
+        if (it != scheme_it->second.end())
+            return it->second;
+    }
+
+    // same placeholder as LogEntry::parse(); stored so that we can return a reference
+    static thread_local std::map<int, std::string> unknown;
+    auto it = unknown.find(index);
+    if (it == unknown.end())
+    {
+        glog.is_warn() && glog << "No " << kind << " entry in file for " << kind
+                               << " index: " << index << std::endl;
+        it = unknown.emplace(index, unknown_prefix + std::to_string(index) + "_").first;
+    }
+    return it->second;
+}
+
+void MappedLogReader::_finalize(const LogHooks& hooks)
+{
+    if (version_ != 1)
+    {
+        for (const auto& scheme_groups : groups_)
+        {
+            auto hook = hooks.new_group.find(scheme_groups.first);
+            if (hook != hooks.new_group.end() && hook->second)
+                for (const auto& group : scheme_groups.second)
+                    hook->second(goby::middleware::DynamicGroup(group.second));
+        }
+        for (const auto& scheme_types : types_)
+        {
+            auto hook = hooks.new_type.find(scheme_types.first);
+            if (hook != hooks.new_type.end() && hook->second)
+                for (const auto& type : scheme_types.second) hook->second(type.second);
+        }
+    }
+
+    // resolve the names once per distinct (scheme, group index, type index)
+    using IndexKey = std::tuple<int, int, int>;
+    std::map<IndexKey, std::pair<LogFilter, bool>> keys;
+    for (const auto& e : all_entries_)
+    {
+        IndexKey key(e.scheme, e.group_index, e.type_index);
+        if (keys.count(key))
+            continue;
+
+        LogFilter filter{e.scheme, group_name(e), type_name(e)};
+        auto hook = hooks.filter.find(filter);
+        keys.emplace(key, std::make_pair(filter, hook != hooks.filter.end()));
+    }
+
+    entries_.clear();
+    by_filter_.clear();
+    for (const auto& e : all_entries_)
+    {
+        const auto& filter_hooked = keys.at(IndexKey(e.scheme, e.group_index, e.type_index));
+        if (filter_hooked.second)
+        {
+            auto d = _data(e);
+            std::vector<unsigned char> data(d.begin(), d.end());
+            hooks.filter.at(filter_hooked.first)(data);
+        }
+        else
+        {
+            by_filter_[filter_hooked.first].push_back(entries_.size());
+            entries_.push_back(e);
+        }
+    }
+
+    by_time_.resize(entries_.size());
+    for (std::size_t i = 0, n = entries_.size(); i < n; ++i) by_time_[i] = i;
+    std::stable_sort(by_time_.begin(), by_time_.end(), [this](std::size_t a, std::size_t b) {
+        return entries_[a].timestamp < entries_[b].timestamp;
+    });
+}
+
+const std::string& MappedLogReader::group(std::size_t i) const
+{
+    return group_name(entries_.at(i));
+}
+
+const std::string& MappedLogReader::type(std::size_t i) const { return type_name(entries_.at(i)); }
+
+const std::string& MappedLogReader::group_name(const LogIndexEntry& e) const
+{
+    return _lookup(groups_, e.scheme, e.group_index, "group");
+}
+
+const std::string& MappedLogReader::type_name(const LogIndexEntry& e) const
+{
+    return _lookup(types_, e.scheme, e.type_index, "type");
+}
+
+LogEntry MappedLogReader::entry(std::size_t i) const
+{
+    auto d = data(i);
+    return LogEntry(std::vector<unsigned char>(d.begin(), d.end()), scheme(i), type(i),
+                    goby::middleware::DynamicGroup(group(i)),
+                    goby::time::SystemClock::time_point(std::chrono::microseconds(timestamp(i))));
+}
+
+const std::vector<std::size_t>& MappedLogReader::find(int scheme, const std::string& group,
+                                                      const std::string& type) const
+{
+    static const std::vector<std::size_t> none;
+    auto it = by_filter_.find(LogFilter{scheme, group, type});
+    return it != by_filter_.end() ? it->second : none;
+}
+
+std::vector<std::size_t> MappedLogReader::time_range(std::uint64_t begin, std::uint64_t end) const
+{
+    auto first = std::lower_bound(
+        by_time_.begin(), by_time_.end(), begin,
+        [this](std::size_t i, std::uint64_t t) { return entries_[i].timestamp < t; });
+    auto last = std::lower_bound(
+        first, by_time_.end(), end,
+        [this](std::size_t i, std::uint64_t t) { return entries_[i].timestamp < t; });
+    return std::vector<std::size_t>(first, last);
+}
+
+std::vector<goby::middleware::log::LogFilter> MappedLogReader::filters() const
+{
+    std::vector<LogFilter> filters;
+    for (const auto& f : by_filter_) filters.push_back(f.first);
+    return filters;
+}
+
+std::uint32_t MappedLogReader::_prefix_crc(std::uint64_t prefix_size) const
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(map_, prefix_size);
+    return crc.checksum();
+}
+
+void MappedLogReader::_write_sidecar() const
+{
+    std::string s(sidecar_magic);
+    append_netint<std::uint32_t>(s, sidecar_version);
+    append_netint<std::uint32_t>(s, version_);
+    auto prefix_size = std::min(map_size_, max_prefix_size);
+    append_netint<std::uint32_t>(s, prefix_size);
+    append_netint<std::uint32_t>(s, _prefix_crc(prefix_size));
+    append_netint<std::uint64_t>(s, indexed_bytes_);
+    append_netint<std::uint64_t>(s, bytes_skipped_);
+
+    auto append_names = [&s](const std::map<int, std::map<int, std::string>>& names) {
+        std::uint32_t n = 0;
+        for (const auto& scheme_names : names) n += scheme_names.second.size();
+        append_netint<std::uint32_t>(s, n);
+        for (const auto& scheme_names : names)
+        {
+            for (const auto& name : scheme_names.second)
+            {
+                // NULL_SCHEME (v1) is stored as 0xFFFF
+                append_netint<std::uint16_t>(s, scheme_names.first);
+                append_netint<std::uint16_t>(s, name.first);
+                append_netint<std::uint32_t>(s, name.second.size());
+                s.append(name.second);
+            }
+        }
+    };
+    append_names(groups_);
+    append_names(types_);
+
+    append_netint<std::uint64_t>(s, blocks_.size());
+    for (const auto& b : blocks_)
+    {
+        append_netint(s, b.offset);
+        append_netint(s, b.size);
+    }
+
+    append_netint<std::uint64_t>(s, all_entries_.size());
+    for (const auto& e : all_entries_)
+    {
+        append_netint(s, e.offset);
+        append_netint(s, e.timestamp);
+        append_netint(s, e.data_size);
+        append_netint(s, e.scheme);
+        append_netint(s, e.group_index);
+        append_netint(s, e.type_index);
+        append_netint(s, e.block);
+    }
+
+    boost::crc_32_type crc;
+    crc.process_bytes(s.data(), s.size());
+    append_netint<std::uint32_t>(s, crc.checksum());
+
+    // write then rename so that readers never see a partial sidecar file
+    std::string tmp_file = sidecar_file_ + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(tmp_file.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(s.data(), s.size());
+        if (!out)
+        {
+            glog.is_warn() && glog << "Failed to write sidecar index " << sidecar_file_
+                                   << std::endl;
+            std::remove(tmp_file.c_str());
+            return;
+        }
+    }
+
+    if (std::rename(tmp_file.c_str(), sidecar_file_.c_str()) != 0)
+    {
+        glog.is_warn() && glog << "Failed to write sidecar index " << sidecar_file_ << ": "
+                               << std::strerror(errno) << std::endl;
+        std::remove(tmp_file.c_str());
+    }
+}
+
+bool MappedLogReader::_load_sidecar()
+{
+    std::ifstream in(sidecar_file_.c_str(), std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string s(ss.str());
+
+    if (s.size() < sidecar_magic.size() + 4 || s.compare(0, sidecar_magic.size(), sidecar_magic))
+        throw(LogException("Not a sidecar index file"));
+
+    boost::crc_32_type crc;
+    crc.process_bytes(s.data(), s.size() - 4);
+    if (crc.checksum() !=
+        read_netint<std::uint32_t>(reinterpret_cast<const unsigned char*>(&s[s.size() - 4])))
+        throw(LogException("Invalid CRC"));
+
+    SidecarParser parser(s);
+    parser.read_string(sidecar_magic.size());
+    if (parser.read<std::uint32_t>() != sidecar_version)
+        throw(LogException("Unsupported sidecar index version"));
+    if (parser.read<std::uint32_t>() != version_)
+        throw(LogException("Log file version does not match"));
+
+    auto prefix_size = parser.read<std::uint32_t>();
+    auto prefix_crc = parser.read<std::uint32_t>();
+    auto indexed_bytes = parser.read<std::uint64_t>();
+    if (prefix_size > map_size_ || indexed_bytes > map_size_ ||
+        _prefix_crc(prefix_size) != prefix_crc)
+        throw(LogException("Log file has been modified"));
+    indexed_bytes_ = indexed_bytes;
+    bytes_skipped_ = parser.read<std::uint64_t>();
+
+    auto read_names = [&parser](std::map<int, std::map<int, std::string>>& names) {
+        names.clear();
+        for (auto n = parser.read<std::uint32_t>(); n > 0; --n)
+        {
+            std::uint16_t scheme = parser.read<std::uint16_t>();
+            std::uint16_t index = parser.read<std::uint16_t>();
+            std::string name = parser.read_string(parser.read<std::uint32_t>());
+            names[scheme == 0xFFFF ? goby::middleware::MarshallingScheme::NULL_SCHEME : scheme]
+                .emplace(index, name);
+        }
+    };
+    read_names(groups_);
+    read_names(types_);
+
+    blocks_.clear();
+    std::vector<std::uint32_t> block_sizes;
+    for (auto n = parser.read<std::uint64_t>(); n > 0; --n)
+    {
+        BlockInfo b;
+        b.offset = parser.read<decltype(b.offset)>();
+        b.size = parser.read<decltype(b.size)>();
+        if (b.offset + b.size > indexed_bytes_)
+            throw(LogException("Compressed block beyond the indexed bytes"));
+        block_sizes.push_back(LogBlockHeader::parse(map_ + b.offset, b.size).uncompressed_size);
+        blocks_.push_back(b);
+    }
+
+    all_entries_.clear();
+    auto n = parser.read<std::uint64_t>();
+    all_entries_.reserve(n);
+    for (; n > 0; --n)
+    {
+        LogIndexEntry e;
+        e.offset = parser.read<decltype(e.offset)>();
+        e.timestamp = parser.read<decltype(e.timestamp)>();
+        e.data_size = parser.read<decltype(e.data_size)>();
+        e.scheme = parser.read<decltype(e.scheme)>();
+        e.group_index = parser.read<decltype(e.group_index)>();
+        e.type_index = parser.read<decltype(e.type_index)>();
+        e.block = parser.read<decltype(e.block)>();
+        if (e.block > blocks_.size())
+            throw(LogException("Entry in an unknown compressed block"));
+        if (e.offset + e.data_size > (e.block == 0 ? indexed_bytes_ : block_sizes[e.block - 1]))
+            throw(LogException("Entry beyond the indexed bytes"));
+        all_entries_.push_back(e);
+    }
+
+    if (indexed_bytes_ < map_size_)
+    {
+        index_source_ = IndexSource::SIDECAR_EXTENDED;
+        _scan(indexed_bytes_);
+    }
+    else
+    {
+        index_source_ = IndexSource::SIDECAR;
+    }
+    return true;
+}
@@ -0,0 +1,222 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MappedLogReader20261018H
+#define MappedLogReader20261018H
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "goby/middleware/log/log_entry.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Read-only view of bytes within a memory-mapped log file (valid while the
+/// MappedLogReader exists) or a decompressed block (which the view keeps alive, so it stays valid
+/// after the reader drops the block from its cache)
+class LogDataView
+{
+  public:
+    LogDataView(const unsigned char* data = nullptr, std::size_t size = 0,
+                std::shared_ptr<const std::string> block = nullptr)
+        : data_(data), size_(size), block_(std::move(block))
+    {
+    }
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const unsigned char* begin() const { return data_; }
+    const unsigned char* end() const { return data_ + size_; }
+
+  private:
+    const unsigned char* data_;
+    std::size_t size_;
+    std::shared_ptr<const std::string> block_;
+};
+
+/// \brief Position and metadata of one data entry in a .goby file
+struct LogIndexEntry
+{
+    /// offset of the first data byte from the start of the file (or of the uncompressed block)
+    std::uint64_t offset;
+    /// microseconds since the UNIX epoch, or 0 if the file version doesn't record it
+    std::uint64_t timestamp;
+    uint<LogEntry::size_bytes_>::type data_size;
+    uint<LogEntry::scheme_bytes_>::type scheme;
+    uint<LogEntry::group_bytes_>::type group_index;
+    uint<LogEntry::type_bytes_>::type type_index;
+    /// 0 for entries stored directly in the file, otherwise 1 + the index of the compressed
+    /// block holding the entry
+    std::uint32_t block;
+};
+
+/// \brief Random-access reader for .goby files using a read-only memory mapping of the file and
+/// an index of its entries
+///
+/// The index is loaded from (and saved to) a sidecar file ("<log>.idx"). If the log has grown
+/// since the sidecar was written, only the new bytes are indexed. As with LogEntry::parse(),
+/// entries matching a filter hook are passed to the hook and left out of the results, and the
+/// new group and type hooks are called for each group and type in the file.
+///
+/// Compressed blocks (see LogBlockHeader) are decompressed to index them, and then again (a whole
+/// block at a time) when the data of one of their entries is accessed. Only the most recently used
+/// decompressed blocks are cached (see set_max_cached_blocks()), so reading through a large log
+/// doesn't hold all of it in memory.
+class MappedLogReader
+{
+  public:
+    enum class IndexSource
+    {
+        /// built by scanning the whole log
+        BUILT,
+        /// read from the sidecar file
+        SIDECAR,
+        /// read from the sidecar file, then extended by scanning bytes appended to the log
+        SIDECAR_EXTENDED
+    };
+
+    /// \param log_file path to the .goby file
+    /// \param use_sidecar read and write the sidecar index file
+    /// \param hooks hooks to call while indexing (e.g. LogReader::hooks())
+    /// \throw LogException if the log file cannot be opened or mapped
+    MappedLogReader(const std::string& log_file, bool use_sidecar = true,
+                    const LogHooks& hooks = LogEntry::global_index().hooks);
+    ~MappedLogReader();
+
+    MappedLogReader(const MappedLogReader&) = delete;
+    MappedLogReader& operator=(const MappedLogReader&) = delete;
+
+    /// \brief Number of data entries (excluding those consumed by a filter hook)
+    std::size_t size() const { return entries_.size(); }
+
+    const LogIndexEntry& index_entry(std::size_t i) const { return entries_.at(i); }
+    /// \throw LogException if the entry is in a compressed block that cannot be decompressed
+    LogDataView data(std::size_t i) const { return _data(entries_.at(i)); }
+    int scheme(std::size_t i) const { return entries_.at(i).scheme; }
+    const std::string& group(std::size_t i) const;
+    const std::string& type(std::size_t i) const;
+    std::uint64_t timestamp(std::size_t i) const { return entries_.at(i).timestamp; }
+
+    /// \brief Copy entry i into a LogEntry (for use with LogPlugin)
+    LogEntry entry(std::size_t i) const;
+
+    /// \brief Indices of the entries with the given scheme, group and type, in file order
+    const std::vector<std::size_t>& find(int scheme, const std::string& group,
+                                         const std::string& type) const;
+
+    /// \brief Indices of the entries with begin <= timestamp < end, in timestamp order
+    std::vector<std::size_t>
+    time_range(std::uint64_t begin,
+               std::uint64_t end = std::numeric_limits<std::uint64_t>::max()) const;
+
+    /// \brief All the (scheme, group, type) combinations in the log
+    std::vector<LogFilter> filters() const;
+
+    int version() const { return version_; }
+    /// \brief Size of the log file in bytes (when it was mapped)
+    std::uint64_t file_size() const { return map_size_; }
+    IndexSource index_source() const { return index_source_; }
+    /// \brief Number of bytes skipped while searching for the next entry, or with bad CRCs
+    std::uint64_t bytes_skipped() const { return bytes_skipped_; }
+    /// \brief Number of compressed blocks in the log
+    std::size_t blocks() const { return blocks_.size(); }
+
+    /// \brief Keep at most n decompressed blocks (at least 1) in the cache
+    void set_max_cached_blocks(std::size_t n);
+    std::size_t max_cached_blocks() const { return max_cached_blocks_; }
+
+  private:
+    void _map(const std::string& log_file);
+    void _read_version();
+    bool _load_sidecar();
+    void _write_sidecar() const;
+    void _scan(std::uint64_t from);
+    // indexes the entries in [base + from, base + size); returns the end of the last one
+    std::uint64_t _scan_entries(const unsigned char* base, std::uint64_t size, std::uint64_t from,
+                                std::uint32_t block);
+    void _scan_block(std::uint64_t offset, std::uint32_t size);
+    void _add_index_record(const LogIndexEntry& e, LogDataView data);
+    void _finalize(const LogHooks& hooks);
+
+    const std::string& group_name(const LogIndexEntry& e) const;
+    const std::string& type_name(const LogIndexEntry& e) const;
+    const std::string& _lookup(const std::map<int, std::map<int, std::string>>& names, int scheme,
+                               int index, const std::string& kind) const;
+    std::uint32_t _prefix_crc(std::uint64_t prefix_size) const;
+
+    struct BlockInfo
+    {
+        // the block entry's data (LogBlockHeader and compressed entries) within the file
+        std::uint64_t offset;
+        std::uint32_t size;
+    };
+    LogDataView _data(const LogIndexEntry& e) const;
+    std::string _decompress(const BlockInfo& block) const;
+    std::shared_ptr<const std::string> _block(std::uint32_t block) const;
+
+  private:
+    std::string sidecar_file_;
+    int fd_{-1};
+    const unsigned char* map_{nullptr};
+    std::uint64_t map_size_{0};
+
+    uint<LogEntry::version_bytes_>::type version_{LogEntry::invalid_version};
+    // data entries in file order, including those consumed by filter hooks
+    std::vector<LogIndexEntry> all_entries_;
+    // end of the last complete entry scanned
+    std::uint64_t indexed_bytes_{0};
+    std::uint64_t bytes_skipped_{0};
+    IndexSource index_source_{IndexSource::BUILT};
+
+    // scheme -> index -> name (scheme is MarshallingScheme::NULL_SCHEME for version 1 files)
+    std::map<int, std::map<int, std::string>> groups_;
+    std::map<int, std::map<int, std::string>> types_;
+
+    std::vector<BlockInfo> blocks_;
+    // recently used decompressed blocks (by LogIndexEntry::block), most recent first
+    mutable std::mutex block_cache_mutex_;
+    mutable std::deque<std::pair<std::uint32_t, std::shared_ptr<const std::string>>> block_cache_;
+    std::size_t max_cached_blocks_{8};
+
+    // results: all_entries_ less those consumed by filter hooks
+    std::vector<LogIndexEntry> entries_;
+    std::map<LogFilter, std::vector<std::size_t>> by_filter_;
+    // indices into entries_, sorted by timestamp
+    std::vector<std::size_t> by_time_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -60,8 +60,14 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
 
     void register_read_hooks(const std::ifstream& in_log_file) override
     {
-        LogEntry::filter_hook[{static_cast<int>(scheme), static_cast<std::string>(file_desc_group),
-                               google::protobuf::FileDescriptorProto::descriptor()->full_name()}] =
+        register_read_hooks(LogEntry::global_index().hooks);
+    }
+
+    /// \brief Register the read hooks for one file (e.g. LogReader::hooks())
+    void register_read_hooks(LogHooks& hooks)
+    {
+        hooks.filter[{static_cast<int>(scheme), static_cast<std::string>(file_desc_group),
+                      google::protobuf::FileDescriptorProto::descriptor()->full_name()}] =
             [](const std::vector<unsigned char>& data) {
                 google::protobuf::FileDescriptorProto file_desc_proto;
                 file_desc_proto.ParseFromArray(&data[0], data.size());
@@ -71,10 +77,20 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
             };
     }
 
-    void register_write_hooks(std::ofstream& out_log_file) override
+    void register_write_hooks(std::ostream& out_log_file) override
+    {
+        register_write_hooks(out_log_file, LogEntry::global_index());
+    }
+
+    /// \brief Register the write hooks for one file (e.g. LogWriter::stream() and
+    /// LogWriter::index()). May be called for several files at once: each gets every file
+    /// descriptor it needs.
+    void register_write_hooks(std::ostream& out_log_file, LogIndex& index)
     {
-        LogEntry::new_type_hook[scheme] = [&](const std::string& type) {
-            add_new_protobuf_type(type, out_log_file);
+        // a new file (possibly reusing the address of a previous LogIndex)
+        written_file_desc_[&index].clear();
+        index.hooks.new_type[scheme] = [&](const std::string& type) {
+            add_new_protobuf_type(type, out_log_file, index);
         };
     }
 
@@ -106,18 +122,19 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
 
   private:
     void insert_protobuf_file_desc(const google::protobuf::FileDescriptor* file_desc,
-                                   std::ofstream& out_log_file)
+                                   std::ostream& out_log_file, LogIndex& index)
     {
         for (int i = 0, n = file_desc->dependency_count(); i < n; ++i)
-            insert_protobuf_file_desc(file_desc->dependency(i), out_log_file);
+            insert_protobuf_file_desc(file_desc->dependency(i), out_log_file, index);
 
-        if (written_file_desc_.count(file_desc) == 0)
+        auto& written_file_desc = written_file_desc_[&index];
+        if (written_file_desc.count(file_desc) == 0)
         {
             goby::glog.is_debug1() &&
                 goby::glog << "Inserting file descriptor proto for: " << file_desc->name() << " : "
                            << file_desc << std::endl;
 
-            written_file_desc_.insert(file_desc);
+            written_file_desc.insert(file_desc);
 
             google::protobuf::FileDescriptorProto file_desc_proto;
             file_desc->CopyTo(&file_desc_proto);
@@ -126,7 +143,7 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
             LogEntry entry(data, goby::middleware::MarshallingScheme::PROTOBUF,
                            google::protobuf::FileDescriptorProto::descriptor()->full_name(),
                            file_desc_group);
-            entry.serialize(&out_log_file);
+            entry.serialize(&out_log_file, &out_log_file, index);
         }
         else
         {
@@ -136,7 +153,8 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
         }
     }
 
-    void add_new_protobuf_type(const std::string& protobuf_type, std::ofstream& out_log_file)
+    void add_new_protobuf_type(const std::string& protobuf_type, std::ostream& out_log_file,
+                               LogIndex& index)
     {
         auto desc = dccl::DynamicProtobufManager::find_descriptor(protobuf_type);
         if (!desc)
@@ -146,12 +164,14 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
         }
         else
         {
-            insert_protobuf_file_desc(desc->file(), out_log_file);
+            insert_protobuf_file_desc(desc->file(), out_log_file, index);
         }
     }
 
   private:
-    std::set<const google::protobuf::FileDescriptor*> written_file_desc_;
+    // written to each file, keyed on its LogIndex
+    std::map<const LogIndex*, std::set<const google::protobuf::FileDescriptor*>>
+        written_file_desc_;
 };
 
 class ProtobufPlugin : public ProtobufPluginBase<goby::middleware::MarshallingScheme::PROTOBUF>
@@ -35,9 +35,19 @@ template <typename DataType> struct SerializerParserHelper<DataType, Marshalling
 {
     static std::vector<char> serialize(const DataType& msg)
     {
-        std::vector<char> bytes(std::begin(msg), std::end(msg));
-        bytes.push_back('\0');
-        return bytes;
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    static std::size_t serialized_size(const DataType& msg)
+    {
+        return std::distance(std::begin(msg), std::end(msg)) + 1;
+    }
+
+    static void serialize_to(const DataType& msg, ByteSink& sink)
+    {
+        char* bytes = sink.append(serialized_size(msg));
+        bytes = std::copy(std::begin(msg), std::end(msg), bytes);
+        *bytes = '\0';
     }
 
     static std::string type_name() { return "CSTR"; }
@@ -26,39 +26,150 @@
 
 #include "dccl.h"
 
-std::unique_ptr<dccl::Codec> goby::middleware::DCCLSerializerParserHelperBase::codec_(nullptr);
-std::unordered_map<const google::protobuf::Descriptor*,
-                   std::unique_ptr<goby::middleware::DCCLSerializerParserHelperBase::LoaderBase>>
-    goby::middleware::DCCLSerializerParserHelperBase::loader_map_;
+#if defined(__has_include)
+#if __has_include(<dccl/version.h>)
+#include <dccl/version.h>
+#endif
+#endif
+
 std::mutex goby::middleware::DCCLSerializerParserHelperBase::dccl_mutex_;
+std::vector<goby::middleware::DCCLSerializerParserHelperBase::LoadLogEntry>
+    goby::middleware::DCCLSerializerParserHelperBase::load_log_;
+std::atomic<std::size_t> goby::middleware::DCCLSerializerParserHelperBase::load_log_size_{0};
+std::atomic<goby::middleware::DCCLSerializerParserHelperBase::CodecMode>
+    goby::middleware::DCCLSerializerParserHelperBase::codec_mode_{CodecMode::SHARED};
 
-void goby::middleware::DCCLSerializerParserHelperBase::load_forwarded_subscription(
-    const goby::middleware::intervehicle::protobuf::Subscription& sub)
+goby::middleware::DCCLSerializerParserHelperBase::CodecReplica&
+goby::middleware::DCCLSerializerParserHelperBase::shared_replica()
 {
-    std::lock_guard<std::mutex> lock(dccl_mutex_);
+    static CodecReplica replica;
+    return replica;
+}
+
+goby::middleware::DCCLSerializerParserHelperBase::CodecReplica&
+goby::middleware::DCCLSerializerParserHelperBase::thread_replica()
+{
+    static thread_local CodecReplica replica;
+    return replica;
+}
 
-    // check that we don't already have this type available
-    if (auto* desc = dccl::DynamicProtobufManager::find_descriptor(sub.protobuf_name()))
+const goby::middleware::DCCLSerializerParserHelperBase::TypeInfo*
+goby::middleware::DCCLSerializerParserHelperBase::type_info(const std::string& full_name)
+{
+    // entries are never removed from type_infos, so the pointers can be cached per thread
+    static std::unordered_map<std::string, std::unique_ptr<const TypeInfo>> type_infos;
+    static thread_local std::unordered_map<std::string, const TypeInfo*> cache;
+
+    auto cache_it = cache.find(full_name);
+    if (cache_it != cache.end())
+        return cache_it->second;
+
+    auto lock = codec_lock();
+    const google::protobuf::Descriptor* desc = nullptr;
     {
-        check_load(desc);
+        auto manager_lock = load_lock();
+        auto it = type_infos.find(full_name);
+        if (it != type_infos.end())
+            return (cache[full_name] = it->second.get());
+        desc = dccl::DynamicProtobufManager::find_descriptor(full_name);
     }
-    else
+
+    // don't cache unknown types, as they may be loaded later (e.g. by a forwarded subscription)
+    if (!desc)
+        return nullptr;
+
+    std::unique_ptr<const TypeInfo> info(new TypeInfo{desc, codec().id(desc)});
+
+    auto manager_lock = load_lock();
+    auto it = type_infos.emplace(full_name, std::move(info)).first;
+    return (cache[full_name] = it->second.get());
+}
+
+void goby::middleware::DCCLSerializerParserHelperBase::set_codec_mode(CodecMode mode)
+{
+#if !defined(DCCL_VERSION_MAJOR) || DCCL_VERSION_MAJOR < 4
+    // DCCL 3 keeps the field codecs and message stack in static (process-wide) state, so separate
+    // dccl::Codec instances cannot safely be used concurrently
+    if (mode == CodecMode::THREAD_LOCAL)
+        throw(goby::Exception("DCCL CodecMode::THREAD_LOCAL requires DCCL 4 or newer"));
+#endif
+    codec_mode_ = mode;
+}
+
+void goby::middleware::DCCLSerializerParserHelperBase::sync(CodecReplica& replica)
+{
+    for (auto n = load_log_size_.load(); replica.synced < n; ++replica.synced)
     {
-        for (const auto& file_desc : sub.file_descriptor())
-            dccl::DynamicProtobufManager::add_protobuf_file(file_desc);
-        if (auto* desc = dccl::DynamicProtobufManager::find_descriptor(sub.protobuf_name()))
-            check_load(desc);
+        const auto& entry = load_log_[replica.synced];
+        if (entry.desc)
+        {
+            if (!replica.loaded.count(entry.desc))
+            {
+                replica.codec->load(entry.desc);
+                replica.loaded.insert(entry.desc);
+            }
+        }
         else
-            goby::glog.is(goby::util::logger::DEBUG3) &&
-                goby::glog << "Failed to load DCCL message sent via forwarded subscription: "
-                           << sub.protobuf_name() << std::endl;
+        {
+            replica.codec->load_library(entry.library);
+        }
     }
 }
 
+void goby::middleware::DCCLSerializerParserHelperBase::load(CodecReplica& replica,
+                                                            const LoadLogEntry& entry)
+{
+    // keep the log order for this replica
+    sync(replica);
+
+    if (entry.desc)
+    {
+        if (replica.loaded.count(entry.desc))
+            return;
+        // throws (and isn't logged) if the type isn't valid DCCL
+        replica.codec->load(entry.desc);
+        replica.loaded.insert(entry.desc);
+    }
+    else
+    {
+        replica.codec->load_library(entry.library);
+    }
+
+    load_log_.push_back(entry);
+    load_log_size_.store(load_log_.size(), std::memory_order_release);
+    replica.synced = load_log_.size();
+}
+
+void goby::middleware::DCCLSerializerParserHelperBase::load_forwarded_subscription(
+    const goby::middleware::intervehicle::protobuf::Subscription& sub)
+{
+    auto lock = codec_lock();
+
+    const google::protobuf::Descriptor* desc = nullptr;
+    {
+        auto manager_lock = load_lock();
+        // check that we don't already have this type available
+        desc = dccl::DynamicProtobufManager::find_descriptor(sub.protobuf_name());
+        if (!desc)
+        {
+            for (const auto& file_desc : sub.file_descriptor())
+                dccl::DynamicProtobufManager::add_protobuf_file(file_desc);
+            desc = dccl::DynamicProtobufManager::find_descriptor(sub.protobuf_name());
+        }
+    }
+
+    if (desc)
+        check_load(desc);
+    else
+        goby::glog.is(goby::util::logger::DEBUG3) &&
+            goby::glog << "Failed to load DCCL message sent via forwarded subscription: "
+                       << sub.protobuf_name() << std::endl;
+}
+
 goby::middleware::intervehicle::protobuf::DCCLForwardedData
 goby::middleware::DCCLSerializerParserHelperBase::unpack(const std::string& frame)
 {
-    std::lock_guard<std::mutex> lock(dccl_mutex_);
+    auto lock = codec_lock();
 
     goby::middleware::intervehicle::protobuf::DCCLForwardedData packets;
 
@@ -82,8 +193,12 @@ goby::middleware::DCCLSerializerParserHelperBase::unpack(const std::string& fram
         }
 
         const auto* desc = codec().loaded().at(dccl_id);
-        auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
-            std::unique_ptr<google::protobuf::Message>>(desc);
+        std::unique_ptr<google::protobuf::Message> msg;
+        {
+            auto manager_lock = load_lock();
+            msg = dccl::DynamicProtobufManager::new_protobuf_message<
+                std::unique_ptr<google::protobuf::Message>>(desc);
+        }
 
         next_frame_it = codec().decode(frame_it, frame_end, msg.get());
         packet.set_data(std::string(frame_it, next_frame_it));
@@ -23,6 +23,9 @@
 #ifndef SerializeParseDCCL20190717H
 #define SerializeParseDCCL20190717H
 
+#include <atomic>
+#include <unordered_set>
+
 #include <dccl/codec.h>
 
 #include "protobuf.h"
@@ -38,65 +41,106 @@ class DCCLForwardedData;
 } // namespace protobuf
 struct DCCLSerializerParserHelperBase
 {
-  private:
-    static std::unique_ptr<dccl::Codec> codec_;
+  public:
+    enum class CodecMode
+    {
+        /// one dccl::Codec for the process, used by one thread at a time
+        SHARED,
+        /// one dccl::Codec per thread, so threads encode and decode concurrently. Types loaded in
+        /// any thread are loaded into each thread's codec the next time it is used. Requires a
+        /// DCCL version (4 or newer) where separate codecs share no mutable state.
+        THREAD_LOCAL
+    };
 
-  protected:
-    static std::mutex dccl_mutex_;
+    /// \brief Metadata for a DCCL type, computed once per process
+    struct TypeInfo
+    {
+        const google::protobuf::Descriptor* desc;
+        unsigned dccl_id;
+        /// fully qualified protobuf name (owned by the descriptor pool, so never copied)
+        const std::string& name() const { return desc->full_name(); }
+    };
 
-    struct LoaderBase
+  private:
+    // a dccl::Codec and how much of the load log has been applied to it
+    struct CodecReplica
     {
-        LoaderBase() = default;
-        virtual ~LoaderBase() = default;
+        std::unique_ptr<dccl::Codec> codec{new dccl::Codec};
+        std::size_t synced{0};
+        std::unordered_set<const google::protobuf::Descriptor*> loaded;
     };
 
-    template <typename DataType> struct Loader : public LoaderBase
+    // everything loaded into any codec, in order (desc, or library if desc is null)
+    struct LoadLogEntry
     {
-        Loader() { codec().load<DataType>(); }
-        ~Loader() { codec().unload<DataType>(); }
+        const google::protobuf::Descriptor* desc;
+        std::string library;
     };
+    static std::vector<LoadLogEntry> load_log_;
+    static std::atomic<std::size_t> load_log_size_;
+    static std::atomic<CodecMode> codec_mode_;
 
-    struct LoaderDynamic : public LoaderBase
+    static CodecReplica& shared_replica();
+    static CodecReplica& thread_replica();
+    static CodecReplica& replica()
     {
-        LoaderDynamic(const google::protobuf::Descriptor* desc) : desc_(desc)
-        {
-            codec().load(desc_);
-        }
-        ~LoaderDynamic() { codec().unload(desc_); }
+        return codec_mode_.load(std::memory_order_relaxed) == CodecMode::SHARED ? shared_replica()
+                                                                                 : thread_replica();
+    }
+    // load_lock() (or codec_lock() for CodecMode::SHARED) must be held
+    static void sync(CodecReplica& replica);
+    static void load(CodecReplica& replica, const LoadLogEntry& entry);
 
-      private:
-        const google::protobuf::Descriptor* desc_;
-    };
+  protected:
+    // SHARED: guards the codec; both modes: guards the load log and the DynamicProtobufManager
+    static std::mutex dccl_mutex_;
 
-    static std::unordered_map<const google::protobuf::Descriptor*, std::unique_ptr<LoaderBase>>
-        loader_map_;
+    /// \brief Lock to hold while using codec(): locks dccl_mutex_ for CodecMode::SHARED only
+    static std::unique_lock<std::mutex> codec_lock()
+    {
+        return codec_mode_.load(std::memory_order_relaxed) == CodecMode::SHARED
+                   ? std::unique_lock<std::mutex>(dccl_mutex_)
+                   : std::unique_lock<std::mutex>();
+    }
 
-    template <typename DataType> static void check_load()
+    /// \brief Lock to hold while already holding codec_lock() to use the load log or the
+    /// DynamicProtobufManager: locks dccl_mutex_ for CodecMode::THREAD_LOCAL only
+    static std::unique_lock<std::mutex> load_lock()
     {
-        const auto* desc = DataType::descriptor();
-        if (!loader_map_.count(desc))
-            loader_map_.insert(
-                std::make_pair(desc, std::unique_ptr<LoaderBase>(new Loader<DataType>())));
+        return codec_mode_.load(std::memory_order_relaxed) == CodecMode::THREAD_LOCAL
+                   ? std::unique_lock<std::mutex>(dccl_mutex_)
+                   : std::unique_lock<std::mutex>();
     }
 
+    template <typename DataType> static void check_load() { check_load(DataType::descriptor()); }
+
     static void check_load(const google::protobuf::Descriptor* desc)
     {
-        if (!loader_map_.count(desc))
-            loader_map_.insert(
-                std::make_pair(desc, std::unique_ptr<LoaderBase>(new LoaderDynamic(desc))));
+        CodecReplica& r = replica();
+        if (!r.loaded.count(desc))
+        {
+            auto lock = load_lock();
+            load(r, {desc, std::string()});
+        }
     }
 
     static dccl::Codec& codec()
     {
-        if (!codec_)
-            codec_.reset(new dccl::Codec);
-        return *codec_;
+        CodecReplica& r = replica();
+        if (r.synced != load_log_size_.load(std::memory_order_acquire))
+        {
+            auto lock = load_lock();
+            sync(r);
+        }
+        return *r.codec;
     }
 
     static dccl::Codec& set_codec(dccl::Codec* new_codec)
     {
-        codec_.reset(new_codec);
-        loader_map_.clear();
+        CodecReplica& r = replica();
+        r.codec.reset(new_codec);
+        r.synced = 0;
+        r.loaded.clear();
         return *new_codec;
     }
 
@@ -104,20 +148,29 @@ struct DCCLSerializerParserHelperBase
     DCCLSerializerParserHelperBase() = default;
     virtual ~DCCLSerializerParserHelperBase() = default;
 
+    /// \brief Choose between one codec for the process and one per thread. Call before any
+    /// threads use DCCL.
+    ///
+    /// \throw goby::Exception if CodecMode::THREAD_LOCAL is not supported by this DCCL version
+    static void set_codec_mode(CodecMode mode);
+    static CodecMode codec_mode() { return codec_mode_; }
+
     template <typename CharIterator> static unsigned id(CharIterator begin, CharIterator end)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
+        auto lock = codec_lock();
         return codec().id(begin, end);
     }
 
-    static unsigned id(const std::string full_name)
+    /// \brief Metadata for the type with the given full name, or nullptr if the type isn't known
+    /// (yet). After the first successful lookup for a given name, each thread finds it without
+    /// locking.
+    static const TypeInfo* type_info(const std::string& full_name);
+
+    /// \brief DCCL ID of the type with the given full name, or 0 if the type isn't known
+    static unsigned id(const std::string& full_name)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        auto* desc = dccl::DynamicProtobufManager::find_descriptor(full_name);
-        if (desc)
-            return codec().id(desc);
-        else
-            return 0;
+        const auto* info = type_info(full_name);
+        return info ? info->dccl_id : 0;
     }
 
     static void
@@ -127,8 +180,9 @@ struct DCCLSerializerParserHelperBase
 
     static void load_library(const std::string& library)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        codec().load_library(library);
+        auto lock = codec_lock();
+        auto log_lock = load_lock();
+        load(replica(), {nullptr, library});
     }
 };
 
@@ -139,32 +193,47 @@ struct SerializerParserHelper<DataType, MarshallingScheme::DCCL>
   public:
     static std::vector<char> serialize(const DataType& msg)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    static std::size_t serialized_size(const DataType& msg)
+    {
+        auto lock = codec_lock();
         check_load<DataType>();
-        std::vector<char> bytes(codec().size(msg), 0);
-        codec().encode(bytes.data(), bytes.size(), msg);
-        return bytes;
+        return codec().size(msg);
     }
 
-    static std::string type_name() { return DataType::descriptor()->full_name(); }
-    static std::string type_name(const DataType& d) { return type_name(); }
+    static void serialize_to(const DataType& msg, ByteSink& sink)
+    {
+        auto lock = codec_lock();
+        check_load<DataType>();
+        auto size = codec().size(msg);
+        codec().encode(sink.append(size), size, msg);
+    }
+
+    static const std::string& type_name() { return DataType::descriptor()->full_name(); }
+    static const std::string& type_name(const DataType& d) { return type_name(); }
 
     template <typename CharIterator>
     static std::shared_ptr<DataType> parse(CharIterator bytes_begin, CharIterator bytes_end,
                                            CharIterator& actual_end)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        check_load<DataType>();
+        auto lock = codec_lock();
         auto msg = std::make_shared<DataType>();
+        check_load<DataType>();
         actual_end = codec().decode(bytes_begin, bytes_end, msg.get());
         return msg;
     }
 
     static unsigned id()
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        check_load<DataType>();
-        return codec().template id<DataType>();
+        // the DCCL ID is fixed for a given type, so only the first call needs the codec
+        static const unsigned dccl_id = []() {
+            auto lock = codec_lock();
+            check_load<DataType>();
+            return codec().template id<DataType>();
+        }();
+        return dccl_id;
     }
 
   private:
@@ -177,18 +246,29 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
   public:
     static std::vector<char> serialize(const google::protobuf::Message& msg)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    static std::size_t serialized_size(const google::protobuf::Message& msg)
+    {
+        auto lock = codec_lock();
         check_load(msg.GetDescriptor());
-        std::vector<char> bytes(codec().size(msg), 0);
-        codec().encode(bytes.data(), bytes.size(), msg);
-        return bytes;
+        return codec().size(msg);
     }
 
-    static std::string type_name(const google::protobuf::Descriptor* desc)
+    static void serialize_to(const google::protobuf::Message& msg, ByteSink& sink)
+    {
+        auto lock = codec_lock();
+        check_load(msg.GetDescriptor());
+        auto size = codec().size(msg);
+        codec().encode(sink.append(size), size, msg);
+    }
+
+    static const std::string& type_name(const google::protobuf::Descriptor* desc)
     {
         return desc->full_name();
     }
-    static std::string type_name(const google::protobuf::Message& d)
+    static const std::string& type_name(const google::protobuf::Message& d)
     {
         return type_name(d.GetDescriptor());
     }
@@ -198,10 +278,13 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
     parse_dynamic(CharIterator bytes_begin, CharIterator bytes_end, CharIterator& actual_end,
                   const std::string& type)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-
-        auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
-            std::shared_ptr<google::protobuf::Message>>(type);
+        auto lock = codec_lock();
+        std::shared_ptr<google::protobuf::Message> msg;
+        {
+            auto manager_lock = load_lock();
+            msg = dccl::DynamicProtobufManager::new_protobuf_message<
+                std::shared_ptr<google::protobuf::Message>>(type);
+        }
 
         check_load(msg->GetDescriptor());
         actual_end = codec().decode(bytes_begin, bytes_end, msg.get());
@@ -210,7 +293,7 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
 
     static unsigned id(const google::protobuf::Descriptor* desc)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
+        auto lock = codec_lock();
         check_load(desc);
         return codec().id(desc);
     }
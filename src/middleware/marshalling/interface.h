@@ -23,12 +23,16 @@
 #ifndef SerializeParse20160607H
 #define SerializeParse20160607H
 
+#include <algorithm>
 #include <map>
 #include <mutex>
 #include <type_traits>
 #include <typeindex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "goby/exception.h"
 #include "goby/middleware/detail/primitive_type.h"
 
 namespace goby
@@ -71,6 +75,88 @@ struct MarshallingScheme
     static const std::map<std::string, int> s2e;
 };
 
+//
+// ByteSink
+//
+
+/// \brief Destination for SerializerParserHelper::serialize_to()
+///
+/// Serializers call append() with the number of bytes they are about to write and write them
+/// directly to the returned pointer, so transporters can serialize straight into their final buffer
+class ByteSink
+{
+  public:
+    virtual ~ByteSink() = default;
+
+    /// \brief Extend the sink by size bytes
+    /// \return pointer to the first of the new bytes (valid until the next call to append())
+    virtual char* append(std::size_t size) = 0;
+};
+
+/// \brief ByteSink that appends to a std::vector<char> or std::string
+template <typename Container> class ContainerByteSink : public ByteSink
+{
+  public:
+    explicit ContainerByteSink(Container& container) : container_(container) {}
+
+    char* append(std::size_t size) override
+    {
+        auto old_size = container_.size();
+        container_.resize(old_size + size);
+        return size > 0 ? &container_[old_size] : nullptr;
+    }
+
+  private:
+    Container& container_;
+};
+
+/// \brief ByteSink that writes into a preallocated buffer, e.g. one sized using serialized_size()
+class ArrayByteSink : public ByteSink
+{
+  public:
+    ArrayByteSink(char* buffer, std::size_t size) : next_(buffer), end_(buffer + size) {}
+
+    char* append(std::size_t size) override
+    {
+        if (static_cast<std::size_t>(end_ - next_) < size)
+            throw(goby::Exception("ArrayByteSink: serialized data is larger than the buffer"));
+        char* bytes = next_;
+        next_ += size;
+        return bytes;
+    }
+
+  private:
+    char* next_;
+    char* end_;
+};
+
+/// \brief Read-only view of contiguous bytes owned elsewhere (e.g. a received message), valid
+/// only while the owner keeps them (typically the duration of a handler call)
+class ByteSpan
+{
+  public:
+    ByteSpan() = default;
+    ByteSpan(const unsigned char* data, std::size_t size) : data_(data), size_(size) {}
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const unsigned char* begin() const { return data_; }
+    const unsigned char* end() const { return data_ + size_; }
+    unsigned char operator[](std::size_t i) const { return data_[i]; }
+
+    /// \brief Copy of the bytes, for keeping them beyond the lifetime of the span
+    std::vector<unsigned char> to_vector() const
+    {
+        return std::vector<unsigned char>(begin(), end());
+    }
+
+  private:
+    const unsigned char* data_{nullptr};
+    std::size_t size_{0};
+};
+
 //
 // SerializerParserHelper
 //
@@ -79,6 +165,82 @@ template <typename DataType, int scheme, class Enable = void> struct SerializerP
 {
 };
 
+namespace detail
+{
+template <typename DataType, int scheme>
+auto serialize_to(const DataType& msg, ByteSink& sink, int)
+    -> decltype(SerializerParserHelper<DataType, scheme>::serialize_to(msg, sink))
+{
+    return SerializerParserHelper<DataType, scheme>::serialize_to(msg, sink);
+}
+
+// SerializerParserHelper that only provides serialize()
+template <typename DataType, int scheme>
+void serialize_to(const DataType& msg, ByteSink& sink, long)
+{
+    std::vector<char> bytes(SerializerParserHelper<DataType, scheme>::serialize(msg));
+    std::copy(bytes.begin(), bytes.end(), sink.append(bytes.size()));
+}
+
+template <typename DataType, int scheme>
+auto serialized_size(const DataType& msg, int)
+    -> decltype(SerializerParserHelper<DataType, scheme>::serialized_size(msg))
+{
+    return SerializerParserHelper<DataType, scheme>::serialized_size(msg);
+}
+
+template <typename DataType, int scheme> std::size_t serialized_size(const DataType& msg, long)
+{
+    return SerializerParserHelper<DataType, scheme>::serialize(msg).size();
+}
+
+template <typename DataType, int scheme>
+constexpr auto has_serialized_size(int)
+    -> decltype(SerializerParserHelper<DataType, scheme>::serialized_size(
+                    std::declval<const DataType&>()),
+                bool())
+{
+    return true;
+}
+
+template <typename DataType, int scheme> constexpr bool has_serialized_size(long) { return false; }
+
+// serialize() in terms of serialize_to()
+template <typename Helper, typename DataType>
+std::vector<char> serialize_to_vector(const DataType& msg)
+{
+    std::vector<char> bytes;
+    ContainerByteSink<std::vector<char>> sink(bytes);
+    Helper::serialize_to(msg, sink);
+    return bytes;
+}
+} // namespace detail
+
+/// \brief Append the serialized msg to sink without an intermediate buffer
+///
+/// Uses SerializerParserHelper<DataType, scheme>::serialize_to() if provided, otherwise copies
+/// the result of serialize().
+template <typename DataType, int scheme> void serialize_to(const DataType& msg, ByteSink& sink)
+{
+    detail::serialize_to<DataType, scheme>(msg, sink, 0);
+}
+
+/// \brief Number of bytes serialize_to() will append for msg
+///
+/// Uses SerializerParserHelper<DataType, scheme>::serialized_size() if provided, otherwise
+/// serializes msg to find out.
+template <typename DataType, int scheme> std::size_t serialized_size(const DataType& msg)
+{
+    return detail::serialized_size<DataType, scheme>(msg, 0);
+}
+
+/// \brief Does SerializerParserHelper<DataType, scheme> provide serialized_size() (that is, can
+/// the size be found without serializing)?
+template <typename DataType, int scheme> constexpr bool has_serialized_size()
+{
+    return detail::has_serialized_size<DataType, scheme>(0);
+}
+
 //
 // scheme
 //
@@ -68,10 +68,18 @@ struct MAVLinkRegistry
 template <> struct SerializerParserHelper<mavlink::mavlink_message_t, MarshallingScheme::MAVLINK>
 {
     static std::vector<char> serialize(const mavlink::mavlink_message_t& msg)
+    {
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    // no serialized_size(): the packed length depends on trailing zero truncation and signing,
+    // so finding it means packing the whole message
+
+    static void serialize_to(const mavlink::mavlink_message_t& msg, ByteSink& sink)
     {
         std::array<uint8_t, MAVLINK_MAX_PACKET_LEN> buffer;
         auto length = mavlink::mavlink_msg_to_send_buffer(&buffer[0], &msg);
-        return std::vector<char>(buffer.begin(), buffer.begin() + length);
+        std::copy(buffer.begin(), buffer.begin() + length, sink.append(length));
     }
 
     static std::string type_name(const mavlink::mavlink_message_t& msg)
@@ -135,13 +143,12 @@ template <typename DataType> struct SerializerParserHelper<DataType, Marshalling
 {
     static std::vector<char> serialize(const DataType& packet)
     {
-        mavlink::mavlink_message_t msg{};
-        mavlink::MsgMap map(msg);
-        packet.serialize(map);
-        mavlink::mavlink_finalize_message(&msg, 1, 1, packet.MIN_LENGTH, packet.LENGTH,
-                                          packet.CRC_EXTRA);
-        return SerializerParserHelper<mavlink::mavlink_message_t,
-                                      MarshallingScheme::MAVLINK>::serialize(msg);
+        return detail::serialize_to_vector<SerializerParserHelper>(packet);
+    }
+
+    static void serialize_to(const DataType& packet, ByteSink& sink)
+    {
+        MessageHelper::serialize_to(finalize(packet), sink);
     }
 
     // use numeric type name since that's all we have with mavlink_message_t alone
@@ -163,6 +170,20 @@ template <typename DataType> struct SerializerParserHelper<DataType, Marshalling
         return packet;
     }
 
+  private:
+    using MessageHelper =
+        SerializerParserHelper<mavlink::mavlink_message_t, MarshallingScheme::MAVLINK>;
+
+    static mavlink::mavlink_message_t finalize(const DataType& packet)
+    {
+        mavlink::mavlink_message_t msg{};
+        mavlink::MsgMap map(msg);
+        packet.serialize(map);
+        mavlink::mavlink_finalize_message(&msg, 1, 1, packet.MIN_LENGTH, packet.LENGTH,
+                                          packet.CRC_EXTRA);
+        return msg;
+    }
+
 }; // namespace middleware
 
 template <typename T, typename std::enable_if<
@@ -25,6 +25,8 @@
 
 #include "interface.h"
 
+#include <cstdint>
+
 #include <google/protobuf/message.h>
 
 #include <dccl/dynamic_protobuf_manager.h>
@@ -43,13 +45,20 @@ struct SerializerParserHelper<
 {
     static std::vector<char> serialize(const DataType& msg)
     {
-        std::vector<char> bytes(msg.ByteSize(), 0);
-        msg.SerializeToArray(bytes.data(), bytes.size());
-        return bytes;
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    static std::size_t serialized_size(const DataType& msg) { return msg.ByteSize(); }
+
+    static void serialize_to(const DataType& msg, ByteSink& sink)
+    {
+        // ByteSize() caches the sizes, so they aren't computed again while serializing
+        auto size = msg.ByteSize();
+        msg.SerializeWithCachedSizesToArray(reinterpret_cast<std::uint8_t*>(sink.append(size)));
     }
 
-    static std::string type_name() { return DataType::descriptor()->full_name(); }
-    static std::string type_name(const DataType& d) { return type_name(); }
+    static const std::string& type_name() { return DataType::descriptor()->full_name(); }
+    static const std::string& type_name(const DataType& d) { return type_name(); }
 
     template <typename CharIterator>
     static std::shared_ptr<DataType> parse(CharIterator bytes_begin, CharIterator bytes_end,
@@ -67,18 +76,27 @@ template <> struct SerializerParserHelper<google::protobuf::Message, Marshalling
 {
     static std::vector<char> serialize(const google::protobuf::Message& msg)
     {
-        std::vector<char> bytes(msg.ByteSize(), 0);
-        msg.SerializeToArray(bytes.data(), bytes.size());
-        return bytes;
+        return detail::serialize_to_vector<SerializerParserHelper>(msg);
+    }
+
+    static std::size_t serialized_size(const google::protobuf::Message& msg)
+    {
+        return msg.ByteSize();
+    }
+
+    static void serialize_to(const google::protobuf::Message& msg, ByteSink& sink)
+    {
+        auto size = msg.ByteSize();
+        msg.SerializeWithCachedSizesToArray(reinterpret_cast<std::uint8_t*>(sink.append(size)));
     }
 
-    static std::string type_name(const google::protobuf::Message& d)
+    static const std::string& type_name(const google::protobuf::Message& d)
     {
         return d.GetDescriptor()->full_name();
     }
 
     // Must subscribe to the actual type (or use subscribe_regex())
-    static std::string type_name(const google::protobuf::Descriptor* desc)
+    static const std::string& type_name(const google::protobuf::Descriptor* desc)
     {
         return desc->full_name();
     }
@@ -32,11 +32,13 @@ namespace middleware
 template <typename Transporter> class Poller : public PollerInterface
 {
   protected:
-    Poller(PollerInterface* inner_poller = nullptr)
-        : // we want the same mutex and cv all the way up
+    Poller(PollerInterface* inner_poller = nullptr,
+           std::shared_ptr<detail::Doorbell> doorbell = nullptr)
+        : // we want the same mutex, cv, and doorbell all the way up
           PollerInterface(
               inner_poller ? inner_poller->poll_mutex() : std::make_shared<std::timed_mutex>(),
-              inner_poller ? inner_poller->cv() : std::make_shared<std::condition_variable_any>()),
+              inner_poller ? inner_poller->cv() : std::make_shared<std::condition_variable_any>(),
+              inner_poller ? inner_poller->doorbell() : doorbell),
           inner_poller_(inner_poller)
     {
     }
@@ -6,6 +6,7 @@ protobuf_generate_cpp(MIDDLEWARE_PROTO_SRCS MIDDLEWARE_PROTO_HDRS
   middleware/protobuf/intervehicle.proto
   middleware/protobuf/intervehicle_transporter_config.proto
   middleware/protobuf/log_tool_config.proto
+  middleware/protobuf/log_writer.proto
   middleware/protobuf/terminate.proto
   middleware/protobuf/io.proto
   middleware/protobuf/serial_config.proto
@@ -16,8 +17,14 @@ set(MIDDLEWARE_SRC
   middleware/marshalling/dccl.cpp 
   middleware/transport/interthread.cpp
   middleware/intervehicle/driver-thread.cpp
+  middleware/intervehicle/buffer_journal.cpp
   middleware/application/configuration_reader.cpp
   middleware/log/log_entry.cpp
+  middleware/log/mapped_log_reader.cpp
+  middleware/log/async_log_writer.cpp
+  middleware/log/log_codec.cpp
+  middleware/log/log_block_writer.cpp
+  middleware/log/log_crc.cpp
   ${MIDDLEWARE_PROTO_SRCS} ${MIDDLEWARE_PROTO_HDRS} 
   )
 
@@ -281,6 +281,12 @@ class SerializationSubscriptionRegex
                                const std::string& type, const Group& group)>
         HandlerType;
 
+    /// \brief Handler given a view of the data rather than a copy (the data are only valid for
+    /// the duration of the call)
+    typedef std::function<void(ByteSpan data, int scheme, const std::string& type,
+                               const Group& group)>
+        SpanHandlerType;
+
     SerializationSubscriptionRegex(HandlerType handler, const std::set<int>& schemes,
                                    const std::string& type_regex = ".*",
                                    const std::string& group_regex = ".*")
@@ -288,34 +294,107 @@ class SerializationSubscriptionRegex
     {
     }
 
-    // handle an incoming message
+    SerializationSubscriptionRegex(SpanHandlerType handler, const std::set<int>& schemes,
+                                   const std::string& type_regex = ".*",
+                                   const std::string& group_regex = ".*")
+        : span_handler_(handler),
+          schemes_(schemes),
+          type_regex_(type_regex),
+          group_regex_(group_regex)
+    {
+    }
+
+    // handle an incoming message (the bytes must be contiguous)
     // return true if posted
+    // not thread-safe: each subscription is posted by one thread (its own or the portal's)
     template <typename CharIterator>
     bool post(CharIterator bytes_begin, CharIterator bytes_end, int scheme, const std::string& type,
               const std::string& group) const
     {
-        if ((schemes_.count(goby::middleware::MarshallingScheme::ALL_SCHEMES) ||
-             schemes_.count(scheme)) &&
-            std::regex_match(type, type_regex_) && std::regex_match(group, group_regex_))
+        const Match& match = _match(scheme, type, group);
+        if (!match.matched_group)
+            return false;
+
+        if (span_handler_)
         {
-            std::vector<unsigned char> data(bytes_begin, bytes_end);
-            handler_(data, scheme, type, goby::middleware::DynamicGroup(group));
-            return true;
+            std::size_t size = bytes_end - bytes_begin;
+            span_handler_(
+                ByteSpan(size ? reinterpret_cast<const unsigned char*>(&*bytes_begin) : nullptr,
+                         size),
+                scheme, type, *match.matched_group);
         }
         else
         {
-            return false;
+            std::vector<unsigned char> data(bytes_begin, bytes_end);
+            handler_(data, scheme, type, *match.matched_group);
         }
+        return true;
     }
 
     std::thread::id thread_id() const { return thread_id_; }
 
+  private:
+    struct MatchKey
+    {
+        int scheme;
+        std::uint64_t type_hash;
+        std::uint64_t group_hash;
+        bool operator==(const MatchKey& k) const
+        {
+            return scheme == k.scheme && type_hash == k.type_hash && group_hash == k.group_hash;
+        }
+    };
+
+    struct MatchKeyHash
+    {
+        std::size_t operator()(const MatchKey& k) const noexcept
+        {
+            return static_cast<std::size_t>(k.group_hash ^ (k.type_hash * 31) ^ k.scheme);
+        }
+    };
+
+    struct Match
+    {
+        // checked on each hit in case of a hash collision
+        std::string type;
+        std::string group;
+        // set only if the subscription matches
+        std::unique_ptr<DynamicGroup> matched_group;
+    };
+
+    const Match& _match(int scheme, const std::string& type, const std::string& group) const
+    {
+        MatchKey key{scheme, detail::fnv1a(type.c_str()), detail::fnv1a(group.c_str())};
+        auto it = match_cache_.find(key);
+        if (it != match_cache_.end() && it->second.type == type && it->second.group == group)
+            return it->second;
+
+        // bounded, in case groups or types are generated without limit
+        if (match_cache_.size() >= max_cached_matches)
+            match_cache_.clear();
+
+        Match& match = match_cache_[key];
+        match.type = type;
+        match.group = group;
+        match.matched_group.reset();
+        if ((schemes_.count(goby::middleware::MarshallingScheme::ALL_SCHEMES) ||
+             schemes_.count(scheme)) &&
+            std::regex_match(type, type_regex_) && std::regex_match(group, group_regex_))
+            match.matched_group.reset(new DynamicGroup(group));
+        return match;
+    }
+
   private:
     HandlerType handler_;
+    SpanHandlerType span_handler_;
     const std::set<int> schemes_;
     std::regex type_regex_;
     std::regex group_regex_;
     const std::thread::id thread_id_{std::this_thread::get_id()};
+
+    // (scheme, type, group) -> whether it matches
+    static constexpr std::size_t max_cached_matches{1024};
+    mutable std::unordered_map<MatchKey, Match, MatchKeyHash> match_cache_;
 };
 
 class SerializationUnSubscribeAll
@@ -28,6 +28,7 @@
 #include <memory>
 #include <mutex>
 
+#include "goby/middleware/detail/doorbell.h"
 #include "goby/middleware/group.h"
 #include "goby/middleware/marshalling/interface.h"
 
@@ -117,8 +118,9 @@ class PollerInterface
 {
   public:
     PollerInterface(std::shared_ptr<std::timed_mutex> poll_mutex,
-                    std::shared_ptr<std::condition_variable_any> cv)
-        : poll_mutex_(poll_mutex), cv_(cv)
+                    std::shared_ptr<std::condition_variable_any> cv,
+                    std::shared_ptr<detail::Doorbell> doorbell = nullptr)
+        : poll_mutex_(poll_mutex), cv_(cv), doorbell_(doorbell)
     {
     }
 
@@ -131,6 +133,8 @@ class PollerInterface
 
     std::shared_ptr<std::timed_mutex> poll_mutex() { return poll_mutex_; }
     std::shared_ptr<std::condition_variable_any> cv() { return cv_; }
+    // non-null if the innermost transporter wakes us with a Doorbell (rather than cv())
+    std::shared_ptr<detail::Doorbell> doorbell() { return doorbell_; }
 
   private:
     template <typename Transporter> friend class Poller;
@@ -145,6 +149,8 @@ class PollerInterface
     std::shared_ptr<std::timed_mutex> poll_mutex_;
     // signaled when there's no data for this thread to read during _poll()
     std::shared_ptr<std::condition_variable_any> cv_;
+    // if set, used instead of cv_ to wait for data
+    std::shared_ptr<detail::Doorbell> doorbell_;
 };
 } // namespace middleware
 } // namespace goby
@@ -180,7 +186,31 @@ int goby::middleware::PollerInterface::_poll_all(
             throw(goby::Exception(
                 "Poller lock was released by poll() but no poll items were returned"));
 
-        if (timeout == Clock::time_point::max())
+        if (doorbell_)
+        {
+            // announce we're about to sleep, then check again so that a ring() between the
+            // last poll and the wait isn't lost
+            auto key = doorbell_->prepare_wait();
+            poll_items = _transporter_poll(lock);
+            if (poll_items != 0)
+            {
+                doorbell_->cancel_wait();
+                break;
+            }
+
+            lock->unlock();
+            bool rung = doorbell_->wait(key, timeout);
+            lock->lock();
+
+            if (!rung)
+                return poll_items;
+
+            poll_items = _transporter_poll(lock);
+            if (poll_items == 0)
+                goby::glog.is(goby::util::logger::DEBUG3) &&
+                    goby::glog << "PollerInterface doorbell: spurious wakeup" << std::endl;
+        }
+        else if (timeout == Clock::time_point::max())
         {
             cv_->wait(*lock); // wait_until doesn't work well with time_point::max()
             poll_items = _transporter_poll(lock);
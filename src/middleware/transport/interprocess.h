@@ -140,6 +140,17 @@ class InterProcessTransporterBase
         static_cast<Derived*>(this)->_subscribe_regex(f, schemes, type_regex, group_regex);
     }
 
+    /// \brief As above, but the handler is given a view of the data (valid only during the call)
+    /// rather than a copy
+    void subscribe_regex(std::function<void(ByteSpan data, int scheme, const std::string& type,
+                                            const Group& group)>
+                             f,
+                         const std::set<int>& schemes, const std::string& type_regex = ".*",
+                         const std::string& group_regex = ".*")
+    {
+        static_cast<Derived*>(this)->_subscribe_regex(f, schemes, type_regex, group_regex);
+    }
+
     template <const Group& group, typename Data, int scheme = scheme<Data>()>
     void subscribe_type_regex(
         std::function<void(std::shared_ptr<const Data>, const std::string& type)> f,
@@ -149,16 +160,17 @@ class InterProcessTransporterBase
         std::string sanitized_group =
             std::regex_replace(std::string(group), special_chars, R"(\$&)");
 
-        auto regex_lambda = [=](const std::vector<unsigned char>& data, int schm,
-                                const std::string& type, const Group& grp) {
+        auto regex_lambda = [=](ByteSpan data, int schm, const std::string& type,
+                                const Group& grp) {
             auto data_begin = data.begin(), data_end = data.end(), actual_end = data.end();
             auto msg = SerializerParserHelper<Data, scheme>::parse_dynamic(data_begin, data_end,
                                                                            actual_end, type);
             f(msg, type);
         };
 
-        static_cast<Derived*>(this)->_subscribe_regex(regex_lambda, {scheme}, type_regex,
-                                                      "^" + sanitized_group + "$");
+        static_cast<Derived*>(this)->_subscribe_regex(
+            SerializationSubscriptionRegex::SpanHandlerType(regex_lambda), {scheme}, type_regex,
+            "^" + sanitized_group + "$");
     }
 
     std::unique_ptr<InnerTransporter> own_inner_;
@@ -205,15 +217,14 @@ class InterProcessForwarder
     void _publish(const Data& d, const Group& group, const Publisher<Data>& publisher)
     {
         // create and forward publication to edge
-        std::vector<char> bytes(SerializerParserHelper<Data, scheme>::serialize(d));
-        std::string* sbytes = new std::string(bytes.begin(), bytes.end());
         auto msg = std::make_shared<goby::middleware::protobuf::SerializerTransporterMessage>();
+        ContainerByteSink<std::string> sink(*msg->mutable_data());
+        serialize_to<Data, scheme>(d, sink);
         auto* key = msg->mutable_key();
 
         key->set_marshalling_scheme(scheme);
         key->set_type(SerializerParserHelper<Data, scheme>::type_name(d));
         key->set_group(std::string(group));
-        msg->set_allocated_data(sbytes);
 
         *key->mutable_cfg() = publisher.cfg();
 
@@ -257,22 +268,22 @@ class InterProcessForwarder
         Base::inner_.template publish<Base::forward_group_, SerializationUnSubscribeAll>(all);
     }
 
-    void _subscribe_regex(std::function<void(const std::vector<unsigned char>&, int scheme,
-                                             const std::string& type, const Group& group)>
-                              f,
-                          const std::set<int>& schemes, const std::string& type_regex = ".*",
+    // HandlerType: SerializationSubscriptionRegex::HandlerType or SpanHandlerType
+    template <typename HandlerType>
+    void _subscribe_regex(HandlerType f, const std::set<int>& schemes,
+                          const std::string& type_regex = ".*",
                           const std::string& group_regex = ".*")
     {
-        auto inner_publication_lambda = [=](const std::vector<unsigned char>& data, int scheme,
-                                            const std::string& type, const Group& group) {
-            std::shared_ptr<goby::middleware::protobuf::SerializerTransporterMessage>
-                forwarded_data(new goby::middleware::protobuf::SerializerTransporterMessage);
-            forwarded_data->mutable_key()->set_marshalling_scheme(scheme);
-            forwarded_data->mutable_key()->set_type(type);
-            forwarded_data->mutable_key()->set_group(group);
-            forwarded_data->set_data(std::string(data.begin(), data.end()));
-            Base::inner_.template publish<Base::regex_group_>(forwarded_data);
-        };
+        SerializationSubscriptionRegex::SpanHandlerType inner_publication_lambda =
+            [=](ByteSpan data, int scheme, const std::string& type, const Group& group) {
+                std::shared_ptr<goby::middleware::protobuf::SerializerTransporterMessage>
+                    forwarded_data(new goby::middleware::protobuf::SerializerTransporterMessage);
+                forwarded_data->mutable_key()->set_marshalling_scheme(scheme);
+                forwarded_data->mutable_key()->set_type(type);
+                forwarded_data->mutable_key()->set_group(group);
+                forwarded_data->set_data(reinterpret_cast<const char*>(data.data()), data.size());
+                Base::inner_.template publish<Base::regex_group_>(forwarded_data);
+            };
 
         auto portal_subscription = std::make_shared<SerializationSubscriptionRegex>(
             inner_publication_lambda, schemes, type_regex, group_regex);
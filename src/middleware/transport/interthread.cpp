@@ -22,6 +22,13 @@
 
 #include "interthread.h"
 
-std::unordered_map<std::thread::id, goby::middleware::SubscriptionStoreBase::StoresMap>
-    goby::middleware::SubscriptionStoreBase::stores_;
-std::shared_timed_mutex goby::middleware::SubscriptionStoreBase::stores_mutex_;
+std::shared_ptr<const goby::middleware::SubscriptionStoreBase::StoresSnapshot>&
+goby::middleware::SubscriptionStoreBase::stores_snapshot()
+{
+    // never destroyed, as InterThreadTransporters with static storage duration may call
+    // unsubscribe_all() after the end of main()
+    static auto* stores = new std::shared_ptr<const StoresSnapshot>;
+    return *stores;
+}
+
+std::mutex goby::middleware::SubscriptionStoreBase::stores_mutex_;
@@ -23,8 +23,10 @@
 #ifndef TransportInterThread20160609H
 #define TransportInterThread20160609H
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -32,6 +34,9 @@
 #include <thread>
 #include <typeindex>
 
+#include "goby/middleware/detail/doorbell.h"
+#include "goby/middleware/detail/mailbox.h"
+
 #include "common.h"
 
 namespace goby
@@ -43,8 +48,11 @@ class SubscriptionStoreBase
   private:
     // for each thread, stores a map of Datas to SubscriptionStores so that can call poll() on all the stores
     using StoresMap = std::unordered_map<std::type_index, std::shared_ptr<SubscriptionStoreBase> >;
-    static std::unordered_map<std::thread::id, StoresMap> stores_;
-    static std::shared_timed_mutex stores_mutex_;
+    using StoresSnapshot = std::unordered_map<std::thread::id, StoresMap>;
+    // immutable: replaced (never modified) by insert() and unsubscribe_all()
+    static std::shared_ptr<const StoresSnapshot>& stores_snapshot();
+    // serializes writers of stores_snapshot()
+    static std::mutex stores_mutex_;
 
   public:
     SubscriptionStoreBase() = default;
@@ -54,27 +62,33 @@ class SubscriptionStoreBase
     static int poll_all(std::thread::id thread_id,
                         std::unique_ptr<std::unique_lock<std::timed_mutex> >& lock)
     {
-        // make a copy so that other threads can subscribe if
-        // necessary in their callbacks
-        StoresMap stores;
-        {
-            std::shared_lock<std::shared_timed_mutex> stores_lock(stores_mutex_);
-            if (stores_.count(thread_id))
-                stores = stores_.at(thread_id);
-        }
+        // holding a reference to the current snapshot allows other threads to subscribe
+        // if necessary in their callbacks
+        auto stores = std::atomic_load(&stores_snapshot());
+        if (!stores)
+            return 0;
+
+        auto it = stores->find(thread_id);
+        if (it == stores->end())
+            return 0;
 
         int poll_items = 0;
-        for (auto const& s : stores) poll_items += s.second->poll(thread_id, lock);
+        for (auto const& s : it->second) poll_items += s.second->poll(thread_id, lock);
         return poll_items;
     }
 
     static void unsubscribe_all(std::thread::id thread_id)
     {
-        std::shared_lock<std::shared_timed_mutex> stores_lock(stores_mutex_);
-        if (stores_.count(thread_id))
-        {
-            for (auto const& s : stores_.at(thread_id)) s.second->unsubscribe_all_groups(thread_id);
-        }
+        std::lock_guard<decltype(stores_mutex_)> lock(stores_mutex_);
+        auto stores = std::atomic_load(&stores_snapshot());
+        if (!stores || !stores->count(thread_id))
+            return;
+
+        for (auto const& s : stores->at(thread_id)) s.second->unsubscribe_all_groups(thread_id);
+
+        auto new_stores = std::make_shared<StoresSnapshot>(*stores);
+        new_stores->erase(thread_id);
+        std::atomic_store(&stores_snapshot(), std::shared_ptr<const StoresSnapshot>(new_stores));
     }
 
   protected:
@@ -82,14 +96,17 @@ class SubscriptionStoreBase
     {
         // check the store, and if there isn't one for this type, create one
         std::lock_guard<decltype(stores_mutex_)> lock(stores_mutex_);
-
-        if (!stores_.count(thread_id))
-            stores_.insert(std::make_pair(thread_id, StoresMap()));
+        auto stores = std::atomic_load(&stores_snapshot());
 
         auto index = std::type_index(typeid(StoreType));
-        if (!stores_.at(thread_id).count(index))
-            stores_.at(thread_id).insert(
-                std::make_pair(index, std::shared_ptr<StoreType>(new StoreType)));
+        if (stores && stores->count(thread_id) && stores->at(thread_id).count(index))
+            return;
+
+        auto new_stores =
+            stores ? std::make_shared<StoresSnapshot>(*stores) : std::make_shared<StoresSnapshot>();
+        (*new_stores)[thread_id].insert(
+            std::make_pair(index, std::shared_ptr<StoreType>(new StoreType)));
+        std::atomic_store(&stores_snapshot(), std::shared_ptr<const StoresSnapshot>(new_stores));
     }
 
   protected:
@@ -101,46 +118,67 @@ class SubscriptionStoreBase
 struct DataProtection
 {
     DataProtection(std::shared_ptr<std::mutex> dm, std::shared_ptr<std::condition_variable_any> pcv,
-                   std::shared_ptr<std::timed_mutex> pm)
-        : data_mutex(dm), poller_cv(pcv), poller_mutex(pm)
+                   std::shared_ptr<std::timed_mutex> pm,
+                   std::shared_ptr<detail::Doorbell> db = nullptr, std::size_t mc = 0)
+        : data_mutex(dm), poller_cv(pcv), poller_mutex(pm), doorbell(db), mailbox_capacity(mc)
     {
     }
 
     std::shared_ptr<std::mutex> data_mutex;
     std::shared_ptr<std::condition_variable_any> poller_cv;
     std::shared_ptr<std::timed_mutex> poller_mutex;
+
+    // set if the subscribing thread uses InterThreadTransporter::Mode::MAILBOX
+    std::shared_ptr<detail::Doorbell> doorbell;
+    std::size_t mailbox_capacity;
 };
 
+/// \brief Subscriptions and queued data for a single Data type, shared by all
+/// InterThreadTransporters
+///
+/// The subscriptions are published as an immutable Snapshot that is rebuilt (under
+/// subscription_mutex_) on each subscribe/unsubscribe and swapped in atomically. publish() and
+/// poll() only take a reference to the current Snapshot, so they never contend on (or copy) the
+/// subscription tables.
 template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
 {
+  private:
+    using CallbackType = std::function<void(std::shared_ptr<const Data>)>;
+    using MailboxEntry = std::pair<std::weak_ptr<CallbackType>, std::shared_ptr<const Data> >;
+    using MailboxType = detail::Mailbox<MailboxEntry>;
+    // data waiting for a single (thread, group), protected by DataProtection::data_mutex
+    using DataQueue = std::vector<std::shared_ptr<const Data> >;
+
   public:
     static void subscribe(std::function<void(std::shared_ptr<const Data>)> func, const Group& group,
                           std::thread::id thread_id, std::shared_ptr<std::mutex> data_mutex,
                           std::shared_ptr<std::condition_variable_any> cv,
-                          std::shared_ptr<std::timed_mutex> poller_mutex)
+                          std::shared_ptr<std::timed_mutex> poller_mutex,
+                          std::shared_ptr<detail::Doorbell> doorbell = nullptr,
+                          std::size_t mailbox_capacity = 0)
     {
         {
-            std::lock_guard<std::shared_timed_mutex> lock(subscription_mutex_);
+            std::lock_guard<decltype(subscription_mutex_)> lock(subscription_mutex_);
 
+            auto thread_it = thread_states().find(thread_id);
+            // if we don't have a condition variable already for this thread, store it
+            if (thread_it == thread_states().end())
+                thread_it = thread_states()
+                                .insert(std::make_pair(
+                                    thread_id,
+                                    ThreadState(DataProtection(data_mutex, cv, poller_mutex,
+                                                               doorbell, mailbox_capacity))))
+                                .first;
+
+            auto& thread_state = thread_it->second;
             // insert callback
-            auto it =
-                subscription_callbacks_.insert(std::make_pair(thread_id, Callback(group, func)));
-            // insert group with iterator to callback
-            subscription_groups_.insert(std::make_pair(group, it));
-
-            // if necessary, create a DataQueue for this thread
-            auto queue_it = data_.find(thread_id);
-            if (queue_it == data_.end())
-            {
-                auto bool_it_pair = data_.insert(std::make_pair(thread_id, DataQueue()));
-                queue_it = bool_it_pair.first;
-            }
-            queue_it->second.create(group);
+            thread_state.callbacks.push_back(Callback(group, func));
 
-            // if we don't have a condition variable already for this thread, store it
-            if (!data_protection_.count(thread_id))
-                data_protection_.insert(
-                    std::make_pair(thread_id, DataProtection(data_mutex, cv, poller_mutex)));
+            // if necessary, create a DataQueue for this group
+            if (!thread_state.queues.count(group))
+                thread_state.queues.insert(std::make_pair(group, std::make_shared<DataQueue>()));
+
+            _rebuild_snapshot();
         }
 
         // try inserting a copy of this templated class via the base class for SubscriptionStoreBase::poll_all to use
@@ -149,67 +187,62 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
 
     static void unsubscribe(const Group& group, std::thread::id thread_id)
     {
-        {
-            std::lock_guard<std::shared_timed_mutex> lock(subscription_mutex_);
+        std::lock_guard<decltype(subscription_mutex_)> lock(subscription_mutex_);
 
-            // iterate over subscriptions for this group, and erase the ones belonging to this thread_id
-            auto range = subscription_groups_.equal_range(group);
-            for (auto it = range.first; it != range.second;)
-            {
-                auto sub_thread_id = it->second->first;
+        auto thread_it = thread_states().find(thread_id);
+        if (thread_it == thread_states().end())
+            return;
 
-                if (sub_thread_id == thread_id)
-                {
-                    subscription_callbacks_.erase(it->second);
-                    it = subscription_groups_.erase(it);
-                }
-                else
-                {
-                    ++it;
-                }
-            }
+        // erase the subscriptions to this group belonging to this thread_id
+        auto& callbacks = thread_it->second.callbacks;
+        callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                       [&](const Callback& c) { return c.group == group; }),
+                        callbacks.end());
 
-            // remove the dataqueue for this group
-            auto queue_it = data_.find(thread_id);
-            queue_it->second.remove(group);
-        }
+        // remove the DataQueue for this group
+        thread_it->second.queues.erase(group);
+
+        _rebuild_snapshot();
     }
 
     static void publish(std::shared_ptr<const Data> data, const Group& group,
                         const Publisher<Data>& publisher)
     {
-        // push new data
-        // build up local vector of relevant condition variables while locked
-        std::vector<DataProtection> cv_to_notify;
+        auto snapshot = std::atomic_load(&subscriptions_snapshot());
+        if (!snapshot)
+            return;
+
+        auto group_it = snapshot->subscribers.find(group);
+        if (group_it == snapshot->subscribers.end())
+            return;
+
+        for (const auto& subscriber : group_it->second)
         {
-            std::shared_lock<std::shared_timed_mutex> lock(subscription_mutex_);
+            // don't store a copy if publisher == subscriber, and echo is false
+            if (subscriber.thread_id == std::this_thread::get_id() && !publisher.cfg().echo())
+                continue;
 
-            auto range = subscription_groups_.equal_range(group);
-            for (auto it = range.first; it != range.second; ++it)
+            const auto& thread_subscriptions = *subscriber.thread;
+            const auto& data_protection = thread_subscriptions.data_protection;
+            if (thread_subscriptions.mailbox)
             {
-                std::thread::id thread_id = it->second->first;
+                // subscriber uses a mailbox: no data or poller mutex required
+                for (const auto& callback : subscriber.group->callbacks)
+                    thread_subscriptions.mailbox->push(MailboxEntry(callback, data));
+                data_protection.doorbell->ring();
+                continue;
+            }
 
-                // don't store a copy if publisher == subscriber, and echo is false
-                if (thread_id != std::this_thread::get_id() || publisher.cfg().echo())
-                {
-                    // protect the DataQueue we are writing to
-                    std::unique_lock<std::mutex> lock(
-                        *(data_protection_.find(thread_id)->second.data_mutex));
-                    auto queue_it = data_.find(thread_id);
-                    queue_it->second.insert(group, data);
-                    cv_to_notify.push_back(data_protection_.at(thread_id));
-                }
+            {
+                // protect the DataQueue we are writing to
+                std::lock_guard<std::mutex> lock(*data_protection.data_mutex);
+                subscriber.group->queue->push_back(data);
             }
-        }
 
-        // unlock and notify condition variables from local vector
-        for (const auto& data_protection : cv_to_notify)
-        {
             {
                 // lock to ensure the other thread isn't in the limbo region
                 // between _poll_all() and wait(), where the condition variable
                 // signal would be lost
-
                 std::lock_guard<std::timed_mutex>(*data_protection.poller_mutex);
             }
             data_protection.poller_cv->notify_all();
@@ -220,83 +253,126 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
     int poll(std::thread::id thread_id,
              std::unique_ptr<std::unique_lock<std::timed_mutex> >& lock) override
     {
-        std::vector<std::pair<std::shared_ptr<typename Callback::CallbackType>,
-                              std::shared_ptr<const Data> > >
-            data_callbacks;
+        // keeps the callbacks alive even if a callback unsubscribes
+        auto snapshot = std::atomic_load(&subscriptions_snapshot());
+        if (!snapshot)
+            return 0;
+
+        auto thread_it = snapshot->threads.find(thread_id);
+        if (thread_it == snapshot->threads.end())
+            return 0; // no subscriptions
+
+        const auto& thread_subscriptions = thread_it->second;
+        if (thread_subscriptions.mailbox)
+            return _poll_mailbox(*thread_subscriptions.mailbox, lock);
+
+        // reuse the storage from the last poll() (unless a callback is calling poll() recursively)
+        decltype(pending_) pending;
+        pending.swap(pending_);
         int poll_items_count = 0;
 
         {
-            std::shared_lock<std::shared_timed_mutex> sub_lock(subscription_mutex_);
+            std::lock_guard<std::mutex> data_lock(
+                *thread_subscriptions.data_protection.data_mutex);
 
-            auto queue_it = data_.find(thread_id);
-            if (queue_it == data_.end())
-                return 0; // no subscriptions
+            // loop over all Groups subscribed to by this thread
+            for (const auto& group_subscriptions : thread_subscriptions.groups)
+            {
+                auto& queue = *group_subscriptions.queue;
+                if (queue.empty())
+                    continue;
 
-            std::unique_lock<std::mutex> data_lock(
-                *(data_protection_.find(thread_id)->second.data_mutex));
+                // we have data, no need to keep this lock any longer
+                if (lock)
+                    lock.reset();
 
-            // loop over all Groups stored in this DataQueue
-            for (auto data_it = queue_it->second.cbegin(), end = queue_it->second.cend();
-                 data_it != end; ++data_it)
-            {
-                const Group& group = data_it->first;
-                auto group_range = subscription_groups_.equal_range(group);
-                // For a given Group, loop over all subscriptions to this Group
-                for (auto group_it = group_range.first; group_it != group_range.second; ++group_it)
+                // store the callback function and datum for all the elements queued
+                for (const auto& callback : group_subscriptions.callbacks)
                 {
-                    if (group_it->second->first != thread_id)
-                        continue;
-
-                    // store the callback function and datum for all the elements queued
-                    for (auto& datum : data_it->second)
+                    for (auto& datum : queue)
                     {
                         ++poll_items_count;
-                        // we have data, no need to keep this lock any longer
-                        if (lock)
-                            lock.reset();
-                        data_callbacks.push_back(
-                            std::make_pair(group_it->second->second.callback, datum));
+                        pending.push_back(std::make_pair(callback.get(), datum));
                     }
                 }
-                queue_it->second.clear(group);
+                queue.clear();
             }
         }
 
-        // now that we're no longer blocking the subscription or data mutex, actually run the callbacks
-        for (const auto& callback_datum_pair : data_callbacks)
+        // now that we're no longer blocking the data mutex, actually run the callbacks
+        for (auto& callback_datum_pair : pending)
             (*callback_datum_pair.first)(std::move(callback_datum_pair.second));
 
+        pending.clear();
+        pending_.swap(pending);
+
         return poll_items_count;
     }
 
+    int _poll_mailbox(MailboxType& mailbox,
+                      std::unique_ptr<std::unique_lock<std::timed_mutex> >& lock)
+    {
+        // bound the work per poll so a fast publisher can't starve this thread's other transporters
+        return mailbox.consume(
+            [&lock](MailboxEntry entry) {
+                // we have data, no need to keep this lock any longer
+                if (lock)
+                    lock.reset();
+                // skip data for subscriptions removed since it was published
+                if (auto callback = entry.first.lock())
+                    (*callback)(std::move(entry.second));
+            },
+            mailbox.capacity());
+    }
+
     void unsubscribe_all_groups(std::thread::id thread_id) override
     {
-        {
-            std::lock_guard<std::shared_timed_mutex> lock(subscription_mutex_);
+        std::lock_guard<decltype(subscription_mutex_)> lock(subscription_mutex_);
+        thread_states().erase(thread_id);
+        _rebuild_snapshot();
+    }
 
-            for (auto it = subscription_groups_.begin(); it != subscription_groups_.end();)
+    // must be called with subscription_mutex_ locked
+    static void _rebuild_snapshot()
+    {
+        auto snapshot = std::make_shared<Snapshot>();
+        for (const auto& thread_state_pair : thread_states())
+        {
+            const auto& thread_state = thread_state_pair.second;
+            auto& thread_subscriptions =
+                snapshot->threads
+                    .insert(std::make_pair(thread_state_pair.first,
+                                           ThreadSubscriptions(thread_state.data_protection,
+                                                               thread_state.mailbox)))
+                    .first->second;
+
+            // group the callbacks by Group, preserving the subscription order
+            auto& groups = thread_subscriptions.groups;
+            for (const auto& callback : thread_state.callbacks)
             {
-                auto sub_thread_id = it->second->first;
-
-                if (sub_thread_id == thread_id)
+                auto group_it = std::find_if(
+                    groups.begin(), groups.end(),
+                    [&](const GroupSubscriptions& g) { return g.group == callback.group; });
+                if (group_it == groups.end())
                 {
-                    subscription_callbacks_.erase(it->second);
-                    it = subscription_groups_.erase(it);
-                }
-                else
-                {
-                    ++it;
+                    groups.push_back(GroupSubscriptions(
+                        callback.group, thread_state.queues.at(callback.group)));
+                    group_it = groups.end() - 1;
                 }
+                group_it->callbacks.push_back(callback.callback);
             }
 
-            data_.erase(thread_id);
+            // groups is complete, so these pointers remain valid for the life of the snapshot
+            for (const auto& group_subscriptions : groups)
+                snapshot->subscribers[group_subscriptions.group].push_back(Subscriber{
+                    thread_state_pair.first, &thread_subscriptions, &group_subscriptions});
         }
+        std::atomic_store(&subscriptions_snapshot(), std::shared_ptr<const Snapshot>(snapshot));
     }
 
   private:
     struct Callback
     {
-        using CallbackType = std::function<void(std::shared_ptr<const Data>)>;
         Callback(const Group& g, const std::function<void(std::shared_ptr<const Data>)>& c)
             : group(g), callback(new CallbackType(c))
         {
@@ -305,68 +381,108 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
         std::shared_ptr<CallbackType> callback;
     };
 
-    class DataQueue
+    // per-thread subscription state, modified only under subscription_mutex_
+    struct ThreadState
     {
-      private:
-        std::unordered_map<Group, std::vector<std::shared_ptr<const Data> > > data_;
-
-      public:
-        void create(const Group& g)
+        ThreadState(const DataProtection& dp)
+            : data_protection(dp),
+              mailbox(dp.doorbell ? std::make_shared<MailboxType>(dp.mailbox_capacity) : nullptr)
         {
-            auto it = data_.find(g);
-            if (it == data_.end())
-                data_.insert(std::make_pair(g, std::vector<std::shared_ptr<const Data> >()));
         }
-        void remove(const Group& g) { data_.erase(g); }
+        DataProtection data_protection;
+        // lock-free mode: one mailbox per thread for this Data type (used instead of queues)
+        std::shared_ptr<MailboxType> mailbox;
+        // subscriptions for this thread, in the order they were made
+        std::vector<Callback> callbacks;
+        std::unordered_map<Group, std::shared_ptr<DataQueue> > queues;
+    };
 
-        void insert(const Group& g, std::shared_ptr<const Data> datum)
+    // all subscriptions by a single thread to a single group
+    struct GroupSubscriptions
+    {
+        GroupSubscriptions(const Group& g, std::shared_ptr<DataQueue> q) : group(g), queue(q) {}
+        Group group;
+        std::vector<std::shared_ptr<CallbackType> > callbacks;
+        std::shared_ptr<DataQueue> queue;
+    };
+
+    struct ThreadSubscriptions
+    {
+        ThreadSubscriptions(const DataProtection& dp, std::shared_ptr<MailboxType> mb)
+            : data_protection(dp), mailbox(mb)
         {
-            data_.find(g)->second.push_back(datum);
         }
-        void clear(const Group& g) { data_.find(g)->second.clear(); }
-        bool empty() { return data_.empty(); }
-        typename decltype(data_)::const_iterator cbegin() { return data_.begin(); }
-        typename decltype(data_)::const_iterator cend() { return data_.end(); }
+        DataProtection data_protection;
+        std::shared_ptr<MailboxType> mailbox;
+        std::vector<GroupSubscriptions> groups;
     };
 
-    // subscriptions for a given thread
-    static std::unordered_multimap<std::thread::id, Callback> subscription_callbacks_;
-    // threads that are subscribed to a given group
-    static std::unordered_multimap<Group,
-                                   typename decltype(subscription_callbacks_)::const_iterator>
-        subscription_groups_;
-    // condition variable to use for data
-    static std::unordered_map<std::thread::id, DataProtection> data_protection_;
+    struct Subscriber
+    {
+        std::thread::id thread_id;
+        const ThreadSubscriptions* thread;
+        const GroupSubscriptions* group;
+    };
 
-    static std::shared_timed_mutex
-        subscription_mutex_; // protects subscription_callbacks, subscription_groups, data_protection, and the overarching data_ map (but not the DataQueues within it, which are protected by the mutexes stored in data_protection_))
+    // immutable once published to subscriptions_snapshot()
+    struct Snapshot
+    {
+        // used by poll()
+        std::unordered_map<std::thread::id, ThreadSubscriptions> threads;
+        // used by publish(); points into threads
+        std::unordered_map<Group, std::vector<Subscriber> > subscribers;
+    };
 
-    // data for a given thread
-    static std::unordered_map<std::thread::id, DataQueue> data_;
+    // these are never destroyed, as InterThreadTransporters with static storage duration may
+    // unsubscribe after the end of main()
+    static std::unordered_map<std::thread::id, ThreadState>& thread_states()
+    {
+        static auto* threads = new std::unordered_map<std::thread::id, ThreadState>;
+        return *threads;
+    }
+    // read by publish() and poll() with std::atomic_load
+    static std::shared_ptr<const Snapshot>& subscriptions_snapshot()
+    {
+        static auto* snapshot = new std::shared_ptr<const Snapshot>;
+        return *snapshot;
+    }
+    // serializes subscribe/unsubscribe (writers of thread_states() and subscriptions_snapshot())
+    static std::mutex subscription_mutex_;
+
+    // (callback, datum) storage reused by poll(); only accessed by the thread that owns this store
+    std::vector<std::pair<CallbackType*, std::shared_ptr<const Data> > > pending_;
 };
 
-template <typename Data>
-std::unordered_multimap<std::thread::id, typename SubscriptionStore<Data>::Callback>
-    SubscriptionStore<Data>::subscription_callbacks_;
-template <typename Data>
-std::unordered_map<std::thread::id, typename SubscriptionStore<Data>::DataQueue>
-    SubscriptionStore<Data>::data_;
-template <typename Data>
-std::unordered_multimap<goby::middleware::Group,
-                        typename decltype(
-                            SubscriptionStore<Data>::subscription_callbacks_)::const_iterator>
-    SubscriptionStore<Data>::subscription_groups_;
-template <typename Data>
-std::unordered_map<std::thread::id, DataProtection> SubscriptionStore<Data>::data_protection_;
-
-template <typename Data> std::shared_timed_mutex SubscriptionStore<Data>::subscription_mutex_;
+template <typename Data> std::mutex SubscriptionStore<Data>::subscription_mutex_;
 
 class InterThreadTransporter
     : public StaticTransporterInterface<InterThreadTransporter, NullTransporter>,
       public Poller<InterThreadTransporter>
 {
   public:
-    InterThreadTransporter() : data_mutex_(std::make_shared<std::mutex>()) {}
+    enum class Mode
+    {
+        // publishers lock the subscriber's queue and notify its condition variable
+        LOCKED_QUEUE,
+        // publishers push to a lock-free per-thread mailbox and ring a futex doorbell
+        MAILBOX
+    };
+    static constexpr std::size_t default_mailbox_capacity{1024};
+
+    /// \brief Create an InterThreadTransporter for the calling thread
+    ///
+    /// \param mode Selects how data published by other threads is delivered to this thread's
+    /// subscriptions
+    /// \param mailbox_capacity Number of lock-free slots in each mailbox (per Data type) when mode
+    /// is Mode::MAILBOX; values beyond this are queued in a slower locked overflow, not dropped
+    InterThreadTransporter(Mode mode = Mode::LOCKED_QUEUE,
+                           std::size_t mailbox_capacity = default_mailbox_capacity)
+        : Poller<InterThreadTransporter>(
+              nullptr, mode == Mode::MAILBOX ? std::make_shared<detail::Doorbell>() : nullptr),
+          data_mutex_(std::make_shared<std::mutex>()),
+          mailbox_capacity_(mailbox_capacity)
+    {
+    }
 
     virtual ~InterThreadTransporter()
     {
@@ -420,7 +536,9 @@ class InterThreadTransporter
         SubscriptionStore<Data>::subscribe([=](std::shared_ptr<const Data> pd) { f(*pd); }, group,
                                            std::this_thread::get_id(), data_mutex_,
                                            Poller<InterThreadTransporter>::cv(),
-                                           Poller<InterThreadTransporter>::poll_mutex());
+                                           Poller<InterThreadTransporter>::poll_mutex(),
+                                           Poller<InterThreadTransporter>::doorbell(),
+                                           mailbox_capacity_);
     }
 
     template <typename Data, int scheme = scheme<Data>()>
@@ -430,7 +548,9 @@ class InterThreadTransporter
         check_validity_runtime(group);
         SubscriptionStore<Data>::subscribe(f, group, std::this_thread::get_id(), data_mutex_,
                                            Poller<InterThreadTransporter>::cv(),
-                                           Poller<InterThreadTransporter>::poll_mutex());
+                                           Poller<InterThreadTransporter>::poll_mutex(),
+                                           Poller<InterThreadTransporter>::doorbell(),
+                                           mailbox_capacity_);
     }
 
     template <typename Data, int scheme = scheme<Data>()>
@@ -452,6 +572,7 @@ class InterThreadTransporter
   private:
     // protects this thread's DataQueue
     std::shared_ptr<std::mutex> data_mutex_;
+    std::size_t mailbox_capacity_;
 };
 
 } // namespace middleware
@@ -24,10 +24,12 @@
 #define TransportInterVehicle20160810H
 
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <sys/types.h>
 #include <thread>
 #include <unistd.h>
+#include <unordered_map>
 
 #include "goby/middleware/protobuf/intervehicle.pb.h"
 #include "goby/middleware/transport/common.h"
@@ -157,8 +159,9 @@ class InterVehicleTransporterBase
                                                    intervehicle::protobuf::ExpireData> >(
                     publisher.expired_func());
 
-            this->_insert_pending_ack(SerializerParserHelper<Data, MarshallingScheme::DCCL>::id(),
-                                      data, ack_handler, expire_handler);
+            goby::glog.is_debug3() && goby::glog << "Inserting ack handler for "
+                                                 << data->ShortDebugString() << std::endl;
+            this->_insert_pending_ack(data->key(), ack_handler, expire_handler);
         }
 
         return data;
@@ -188,6 +191,8 @@ class InterVehicleTransporterBase
         // overwrite timestamps to ensure mapping with driver threads
         auto subscribe_time = dccl_subscription->time_with_units();
         subscription_publication->mutable_key()->set_serialize_time_with_units(subscribe_time);
+        // carried to the driver threads, which use it for the key of their subscription_forward
+        dccl_subscription->set_publication_id(subscription_publication->key().publication_id());
 
         auto ack_handler = std::make_shared<PublisherCallback<Subscription, MarshallingScheme::DCCL,
                                                               intervehicle::protobuf::AckData> >(
@@ -202,8 +207,7 @@ class InterVehicleTransporterBase
                                              << subscription_publication->ShortDebugString()
                                              << std::endl;
 
-        this->pending_ack_.insert(std::make_pair(*subscription_publication,
-                                                 std::make_tuple(ack_handler, expire_handler)));
+        this->_insert_pending_ack(subscription_publication->key(), ack_handler, expire_handler);
 
         return dccl_subscription;
     }
@@ -211,45 +215,50 @@ class InterVehicleTransporterBase
     template <int tuple_index, typename AckorExpirePair>
     void _handle_ack_or_expire(const AckorExpirePair& ack_or_expire_pair)
     {
-        auto original = ack_or_expire_pair.serializer();
         const auto& ack_or_expire_msg = ack_or_expire_pair.data();
-        bool is_subscription = original.key().marshalling_scheme() == MarshallingScheme::DCCL &&
-                               original.key().type() ==
-                                   intervehicle::protobuf::Subscription::descriptor()->full_name();
-
-        if (is_subscription)
+        const auto& key = ack_or_expire_pair.serializer().key();
+        bool is_subscription =
+            key.marshalling_scheme() == MarshallingScheme::DCCL &&
+            key.type() == intervehicle::protobuf::Subscription::descriptor()->full_name();
+
+        // Acks and expires are seen by every Forwarder and the Portal, so check the time as well
+        // in case the publication_id came from an earlier process with the same PID
+        auto it = pending_ack_.find(key.publication_id());
+        if (it != pending_ack_.end() && it->second.serialize_time == key.serialize_time())
         {
-            // rewrite data to remove src()
-            auto bytes_begin = original.data().begin(), bytes_end = original.data().end();
-            decltype(bytes_begin) actual_end;
-
-            using Helper = SerializerParserHelper<intervehicle::protobuf::Subscription,
-                                                  MarshallingScheme::DCCL>;
-            auto subscription = Helper::parse(bytes_begin, bytes_end, actual_end);
-            subscription->mutable_header()->set_src(0);
-
-            std::vector<char> bytes(Helper::serialize(*subscription));
-            std::string* sbytes = new std::string(bytes.begin(), bytes.end());
-            original.set_allocated_data(sbytes);
-        }
+            auto original = ack_or_expire_pair.serializer();
+            if (is_subscription)
+            {
+                // rewrite data to remove src()
+                auto bytes_begin = original.data().begin(), bytes_end = original.data().end();
+                decltype(bytes_begin) actual_end;
+
+                using Helper = SerializerParserHelper<intervehicle::protobuf::Subscription,
+                                                      MarshallingScheme::DCCL>;
+                auto subscription = Helper::parse(bytes_begin, bytes_end, actual_end);
+                subscription->mutable_header()->set_src(0);
+
+                original.clear_data();
+                ContainerByteSink<std::string> sink(*original.mutable_data());
+                Helper::serialize_to(*subscription, sink);
+            }
 
-        auto it = pending_ack_.find(original);
-        if (it != pending_ack_.end())
-        {
             goby::glog.is_debug3() && goby::glog << ack_or_expire_msg.GetDescriptor()->name()
                                                  << " for: " << original.ShortDebugString() << ", "
                                                  << ack_or_expire_msg.ShortDebugString()
                                                  << std::endl;
 
-            std::get<tuple_index>(it->second)
+            std::get<tuple_index>(it->second.handlers)
                 ->post(original.data().begin(), original.data().end(), ack_or_expire_msg);
 
         }
         else
         {
-            goby::glog.is_debug3() && goby::glog << "No pending Ack/Expire for "
-                                                 << (is_subscription ? "subscription: " : "data: ")
-                                                 << original.ShortDebugString() << std::endl;
+            goby::glog.is_debug3() && goby::glog
+                                          << "No pending Ack/Expire for "
+                                          << (is_subscription ? "subscription: " : "data: ")
+                                          << ack_or_expire_pair.serializer().ShortDebugString()
+                                          << std::endl;
         }
     }
 
@@ -285,16 +294,29 @@ class InterVehicleTransporterBase
     }
 
     void _insert_pending_ack(
-        int dccl_id, std::shared_ptr<goby::middleware::protobuf::SerializerTransporterMessage> data,
+        const goby::middleware::protobuf::SerializerTransporterKey& key,
         std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::AckData> > ack_handler,
         std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::ExpireData> >
             expire_handler)
     {
-        goby::glog.is_debug3() && goby::glog << "Inserting ack handler for "
-                                             << data->ShortDebugString() << std::endl;
-
-        this->pending_ack_.insert(
-            std::make_pair(*data, std::make_tuple(ack_handler, expire_handler)));
+        pending_ack_[key.publication_id()] = {key.serialize_time(),
+                                              std::make_tuple(ack_handler, expire_handler)};
+
+        // the longest the drivers can hold the data, plus time to let any expire messages from the
+        // drivers propagate through the interprocess layer before we remove this
+        static const goby::time::MicroTime max_ttl(
+            goby::acomms::protobuf::DynamicBufferConfig::descriptor()
+                ->FindFieldByName("ttl")
+                ->options()
+                .GetExtension(dccl::field)
+                .max() *
+            acomms::protobuf::DynamicBufferConfig::ttl_unit());
+        const goby::time::MicroTime interprocess_wait(1.0 * boost::units::si::seconds);
+
+        // every entry has the same timeout, so the expiry order is the insertion order
+        pending_ack_expiry_.push_back(std::make_pair(
+            goby::time::MicroTime(key.serialize_time_with_units()) + max_ttl + interprocess_wait,
+            key.publication_id()));
     }
 
   protected:
@@ -328,45 +350,32 @@ class InterVehicleTransporterBase
     void _expire_pending_ack()
     {
         auto now = goby::time::SystemClock::now<goby::time::MicroTime>();
-        for (auto it = pending_ack_.begin(), end = pending_ack_.end(); it != end;)
+        while (!pending_ack_expiry_.empty() && now > pending_ack_expiry_.front().first)
         {
-            decltype(now) max_ttl(goby::acomms::protobuf::DynamicBufferConfig::descriptor()
-                                      ->FindFieldByName("ttl")
-                                      ->options()
-                                      .GetExtension(dccl::field)
-                                      .max() *
-                                  acomms::protobuf::DynamicBufferConfig::ttl_unit());
-
-            decltype(now) serialize_time(it->first.key().serialize_time_with_units());
-            decltype(now) expire_time(serialize_time + max_ttl);
-
-            // time to let any expire messages from the drivers propagate through the interprocess layer before we remove this
-            const decltype(now) interprocess_wait(1.0 * boost::units::si::seconds);
-
-            // loop through pending ack, and clear any at the front that can be removed
-
-            if (now > expire_time + interprocess_wait)
-            {
-                goby::glog.is_debug3() && goby::glog << "Erasing pending ack for "
-                                                     << it->first.ShortDebugString() << std::endl;
-                it = pending_ack_.erase(it);
-            }
-            else
-            {
-                // pending_ack_ is ordered by serialize time, so we can bail now
-                break;
-            }
+            goby::glog.is_debug3() && goby::glog << "Erasing pending ack for publication "
+                                                 << pending_ack_expiry_.front().second
+                                                 << std::endl;
+            pending_ack_.erase(pending_ack_expiry_.front().second);
+            pending_ack_expiry_.pop_front();
         }
     }
 
   private:
-    // maps data with ack_requested onto callbacks for when the data are acknowledged or expire
-    // ordered by serialize time
-    std::map<protobuf::SerializerTransporterMessage,
-             std::tuple<
-                 std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::AckData> >,
-                 std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::ExpireData> > > >
-        pending_ack_;
+    struct PendingAck
+    {
+        // SerializerTransporterKey::serialize_time
+        std::uint64_t serialize_time;
+        std::tuple<
+            std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::AckData> >,
+            std::shared_ptr<SerializationHandlerBase<intervehicle::protobuf::ExpireData> > >
+            handlers;
+    };
+
+    // maps the publication_id of data with ack_requested onto callbacks for when the data are
+    // acknowledged or expire
+    std::unordered_map<std::uint64_t, PendingAck> pending_ack_;
+    // (expire time, publication_id) in the order inserted
+    std::deque<std::pair<goby::time::MicroTime, std::uint64_t> > pending_ack_expiry_;
 };
 
 template <typename InnerTransporter>
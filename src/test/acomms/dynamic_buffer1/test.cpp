@@ -24,6 +24,7 @@
 #include <boost/test/included/unit_test.hpp>
 
 #include "goby/acomms/buffer/dynamic_buffer.h"
+#include "goby/acomms/buffer/frame_packing.h"
 #include "goby/time/io.h"
 
 bool close_enough(double a, double b, int precision)
@@ -308,6 +309,84 @@ BOOST_FIXTURE_TEST_CASE(arbitrary_erase, DynamicBufferFixture)
     BOOST_CHECK_EQUAL(buffer.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(sequence_id_erase, DynamicBufferFixture)
+{
+    auto now = goby::time::SteadyClock::now();
+
+    // same push time and data: only the sequence id tells them apart
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "1"});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "1"});
+
+    auto first = buffer.top(goby::acomms::BROADCAST_ID, "B", std::chrono::seconds(1));
+    auto second = buffer.top(goby::acomms::BROADCAST_ID, "B", std::chrono::seconds(1));
+    BOOST_CHECK_NE(first.sequence_id, 0);
+    BOOST_CHECK_NE(first.sequence_id, second.sequence_id);
+
+    BOOST_CHECK(buffer.erase(second));
+    BOOST_CHECK(!buffer.erase(second));
+    BOOST_CHECK_EQUAL(buffer.size(), 1);
+    BOOST_CHECK_EQUAL(buffer.top(goby::acomms::BROADCAST_ID, "B").sequence_id, first.sequence_id);
+    BOOST_CHECK(buffer.erase(first));
+    BOOST_CHECK(buffer.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(stale_erase_after_replace, DynamicBufferFixture)
+{
+    auto now = goby::time::SteadyClock::now();
+
+    // a value handed out before replace() must not erase one pushed to the replacement
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "1"});
+    auto stale = buffer.top(goby::acomms::BROADCAST_ID, "B");
+
+    auto cfg = buffer.sub(goby::acomms::BROADCAST_ID, "B").cfg();
+    buffer.replace(goby::acomms::BROADCAST_ID, "B", cfg);
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "2"});
+    BOOST_CHECK(!buffer.erase(stale));
+    BOOST_CHECK_EQUAL(buffer.size(), 1);
+    BOOST_CHECK_EQUAL(buffer.top(goby::acomms::BROADCAST_ID, "B").data, "2");
+}
+
+BOOST_FIXTURE_TEST_CASE(refill_after_erase, DynamicBufferFixture)
+{
+    auto now = goby::time::SteadyClock::now();
+
+    // emptying a subbuffer takes it out of the priority contest: refilling it must put it back
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "1"});
+    BOOST_CHECK(buffer.erase(buffer.top()));
+    BOOST_CHECK(buffer.empty());
+    BOOST_CHECK_THROW(buffer.top(), goby::acomms::DynamicBufferNoDataException);
+
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "2"});
+    auto top = buffer.top();
+    BOOST_CHECK_EQUAL(top.subbuffer_id, "B");
+    BOOST_CHECK_EQUAL(top.data, "2");
+}
+
+BOOST_FIXTURE_TEST_CASE(check_expire_visitor, DynamicBufferFixture)
+{
+    auto now = goby::time::SteadyClock::now();
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, "first"});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now + std::chrono::milliseconds(5), "second"});
+
+    std::vector<std::string> expired;
+    auto visitor = [&](const goby::acomms::DynamicBuffer<std::string>::Value& v) {
+        BOOST_CHECK_NE(v.sequence_id, 0);
+        expired.push_back(v.subbuffer_id + ":" + v.data);
+    };
+
+    buffer.expire(visitor);
+    BOOST_CHECK(expired.empty());
+    usleep(10000); // 10 ms
+    buffer.expire(visitor);
+    BOOST_REQUIRE_EQUAL(expired.size(), 1);
+    BOOST_CHECK_EQUAL(expired[0], "A:first");
+    usleep(5000); // 5 ms
+    buffer.expire(visitor);
+    BOOST_REQUIRE_EQUAL(expired.size(), 2);
+    BOOST_CHECK_EQUAL(expired[1], "B:second");
+    BOOST_CHECK(buffer.empty());
+}
+
 BOOST_FIXTURE_TEST_CASE(check_expire, DynamicBufferFixture)
 {
     auto now = goby::time::SteadyClock::now();
@@ -517,3 +596,216 @@ BOOST_FIXTURE_TEST_CASE(two_destination_contest, MultiIDDynamicBufferFixture)
         BOOST_CHECK_EQUAL(buffer.size(), 1);
     }
 }
+
+BOOST_AUTO_TEST_CASE(many_subbuffer_contest)
+{
+    goby::acomms::DynamicBuffer<std::string> buffer;
+
+    // subbuffers with three different rates of priority growth, to two destinations
+    std::vector<std::pair<goby::acomms::DynamicBuffer<std::string>::modem_id_type, std::string>>
+        ids;
+    for (int i = 0; i < 30; ++i)
+    {
+        goby::acomms::protobuf::DynamicBufferConfig cfg;
+        cfg.set_ack_required(false);
+        cfg.set_ttl(1000 * (1 + i % 3));
+        cfg.set_value_base(1 + i % 2);
+        ids.push_back({1 + i % 2, "S" + std::to_string(i)});
+        buffer.create(ids.back().first, ids.back().second, cfg);
+    }
+
+    // let the values grow apart
+    usleep(20000);
+
+    auto now = goby::time::SteadyClock::now();
+    for (int n = 0; n < 3; ++n)
+    {
+        for (const auto& id : ids)
+            buffer.push({id.first, id.second, now, id.second + "_" + std::to_string(n)});
+    }
+
+    int popped = 0;
+    while (!buffer.empty())
+    {
+        // compare to the value of every subbuffer
+        auto reference = goby::time::SteadyClock::now();
+        std::map<std::string, double> values;
+        double best = -std::numeric_limits<double>::infinity();
+        for (const auto& id : ids)
+        {
+            double v = buffer.sub(id.first, id.second).top_value(reference).first;
+            values[id.second] = v;
+            best = std::max(best, v);
+        }
+
+        auto vp = buffer.top();
+        BOOST_CHECK_MESSAGE(values[vp.subbuffer_id] >= best - 1e-6,
+                            vp.subbuffer_id << " won with " << values[vp.subbuffer_id]
+                                            << ", best was: " << best);
+        BOOST_CHECK(buffer.erase(vp));
+        ++popped;
+    }
+    BOOST_CHECK_EQUAL(popped, 90);
+    BOOST_CHECK_THROW(buffer.top(), goby::acomms::DynamicBufferNoDataException);
+}
+
+BOOST_FIXTURE_TEST_CASE(candidates_and_subbuffer_top, MultiIDDynamicBufferFixture)
+{
+    auto now = goby::time::SteadyClock::now();
+    buffer.push({1, "A", now, "12345"});
+    buffer.push({2, "B", now, "12"});
+
+    {
+        auto candidates = buffer.candidates();
+        BOOST_REQUIRE_EQUAL(candidates.size(), 2);
+        BOOST_CHECK_EQUAL(candidates[0].subbuffer_id, "A");
+        BOOST_CHECK_EQUAL(candidates[0].bytes, 5);
+        BOOST_CHECK_EQUAL(candidates[1].subbuffer_id, "B");
+        BOOST_CHECK_EQUAL(candidates[1].bytes, 2);
+    }
+
+    // too large, or the wrong destination
+    BOOST_CHECK_EQUAL(buffer.candidates(goby::acomms::QUERY_DESTINATION_ID, 4).size(), 1);
+    BOOST_CHECK_EQUAL(buffer.candidates(1).size(), 1);
+
+    // candidates() doesn't change anything, so A would still win the contest; take B instead
+    auto vp = buffer.top(2, "B");
+    BOOST_CHECK_EQUAL(vp.data, "12");
+
+    // B is waiting for an ack
+    auto candidates = buffer.candidates(goby::acomms::QUERY_DESTINATION_ID,
+                                        std::numeric_limits<std::size_t>::max(),
+                                        std::chrono::seconds(1));
+    BOOST_REQUIRE_EQUAL(candidates.size(), 1);
+    BOOST_CHECK_EQUAL(candidates[0].subbuffer_id, "A");
+    BOOST_CHECK_THROW(buffer.top(2, "B", std::chrono::seconds(1)),
+                      goby::acomms::DynamicBufferNoDataException);
+    BOOST_CHECK_THROW(buffer.top(3, "B"), goby::Exception);
+}
+
+struct PackingCandidate
+{
+    double priority;
+    std::size_t bytes;
+};
+
+BOOST_AUTO_TEST_CASE(waiting_subbuffer_contest)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string>;
+    Buffer buffer;
+    const auto ack_timeout = std::chrono::milliseconds(20);
+    auto top = [&]() {
+        return buffer.top(goby::acomms::QUERY_DESTINATION_ID,
+                          std::numeric_limits<Buffer::size_type>::max(), ack_timeout);
+    };
+
+    auto now = goby::time::SteadyClock::now();
+    const int n = 10;
+    for (int i = 0; i < n; ++i)
+    {
+        goby::acomms::protobuf::DynamicBufferConfig cfg;
+        cfg.set_ack_required(true);
+        cfg.set_value_base(1 + i);
+        buffer.create(goby::acomms::BROADCAST_ID, "S" + std::to_string(i), cfg);
+        buffer.push({goby::acomms::BROADCAST_ID, "S" + std::to_string(i), now, "1"});
+    }
+
+    // in blackout from its creation
+    goby::acomms::protobuf::DynamicBufferConfig blackout_cfg;
+    blackout_cfg.set_ack_required(false);
+    blackout_cfg.set_blackout_time(0.02);
+    buffer.create(goby::acomms::BROADCAST_ID, "K", blackout_cfg);
+    buffer.push({goby::acomms::BROADCAST_ID, "K", now, "1"});
+
+    // each subbuffer sends once, then waits for its ack
+    std::set<std::string> sent;
+    for (int i = 0; i < n; ++i) sent.insert(top().subbuffer_id);
+    BOOST_CHECK_EQUAL(sent.size(), n);
+    BOOST_CHECK(!sent.count("K"));
+    BOOST_CHECK_THROW(top(), goby::acomms::DynamicBufferNoDataException);
+
+    // a value that has never been sent doesn't wait for the others' acks
+    buffer.push({goby::acomms::BROADCAST_ID, "S3", now, "2"});
+    auto vp = top();
+    BOOST_CHECK_EQUAL(vp.subbuffer_id, "S3");
+    BOOST_CHECK_EQUAL(vp.data, "2");
+    BOOST_CHECK(buffer.erase(vp));
+    BOOST_CHECK_THROW(top(), goby::acomms::DynamicBufferNoDataException);
+
+    // once ack_timeout (and the blackout) has passed, every subbuffer can send again
+    usleep(30000); // 30 ms
+    sent.clear();
+    for (int i = 0; i < n + 1; ++i)
+    {
+        auto vp = top();
+        sent.insert(vp.subbuffer_id);
+        BOOST_CHECK(buffer.erase(vp));
+    }
+    BOOST_CHECK_EQUAL(sent.size(), n + 1);
+}
+
+BOOST_AUTO_TEST_CASE(frame_packing)
+{
+    // the highest priority (10 bytes) leaves no room: the two smaller ones are worth more
+    std::vector<PackingCandidate> candidates{{5, 10}, {3, 6}, {3, 4}, {0.5, 20}};
+
+    {
+        auto chosen = goby::acomms::pack_frame(candidates, 10, 1000000);
+        BOOST_REQUIRE_EQUAL(chosen.size(), 2);
+        BOOST_CHECK_EQUAL(chosen[0] + chosen[1], 3);
+    }
+
+    // with room for everything, highest priority first
+    {
+        auto chosen = goby::acomms::pack_frame(candidates, 40, 1000000);
+        BOOST_REQUIRE_EQUAL(chosen.size(), 4);
+        BOOST_CHECK_EQUAL(chosen[0], 0);
+        BOOST_CHECK_EQUAL(chosen[3], 3);
+    }
+
+    // too many cells: priority per byte
+    {
+        auto chosen = goby::acomms::pack_frame(candidates, 10, 10);
+        BOOST_REQUIRE_EQUAL(chosen.size(), 2);
+        BOOST_CHECK_EQUAL(chosen[0] + chosen[1], 3);
+    }
+
+    BOOST_CHECK(goby::acomms::pack_frame(std::vector<PackingCandidate>(), 10, 1000000).empty());
+    BOOST_CHECK(goby::acomms::pack_frame(candidates, 0, 1000000).empty());
+
+    // compare to trying every subset
+    std::srand(1);
+    for (int trial = 0; trial < 100; ++trial)
+    {
+        std::vector<PackingCandidate> random(std::rand() % 10);
+        for (auto& c : random) c = {double(std::rand() % 100), std::size_t(std::rand() % 40)};
+        std::size_t max_bytes = std::rand() % 100;
+
+        double best = 0;
+        for (unsigned subset = 0; subset < (1u << random.size()); ++subset)
+        {
+            double value = 0;
+            std::size_t bytes = 0;
+            for (std::size_t i = 0; i < random.size(); ++i)
+            {
+                if (subset & (1u << i))
+                {
+                    value += random[i].priority;
+                    bytes += random[i].bytes;
+                }
+            }
+            if (bytes <= max_bytes)
+                best = std::max(best, value);
+        }
+
+        double value = 0;
+        std::size_t bytes = 0;
+        for (auto i : goby::acomms::pack_frame(random, max_bytes, 1000000))
+        {
+            value += random[i].priority;
+            bytes += random[i].bytes;
+        }
+        BOOST_CHECK_LE(bytes, max_bytes);
+        BOOST_CHECK_EQUAL(value, best);
+    }
+}
@@ -37,6 +37,19 @@ int main(int argc, char* argv[])
     std::cout << "Running: [" << sys_cmd << "]" << std::endl;
     int rc = system(sys_cmd.c_str());
 
+    if (rc == 0)
+    {
+        // small chunks, so that datasets are extended (including the repeated field dimensions),
+        // and the remaining channels extracted in parallel
+        std::string streaming_cmd(
+            "LD_LIBRARY_PATH=" GOBY_LIB_DIR
+            ":$LD_LIBRARY_PATH GOBY_HDF5_PLUGIN=libgoby_hdf5test.so goby_hdf5 "
+            "--output_file /tmp/test_streaming.h5 --include_string_fields=true --streaming=true "
+            "--chunk_size=2 --compression_level=1 --threads=2");
+        std::cout << "Running: [" << streaming_cmd << "]" << std::endl;
+        rc = system(streaming_cmd.c_str());
+    }
+
     if (rc == 0)
     {
         std::cout << "All tests passed." << std::endl;
@@ -0,0 +1,219 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "goby/exception.h"
+#include "goby/middleware/intervehicle/buffer_journal.h"
+#include "goby/util/debug_logger.h"
+
+using goby::middleware::intervehicle::BufferJournal;
+
+const std::string journal_file{"/tmp/goby_test_intervehicle_journal.bin"};
+
+goby::middleware::intervehicle::protobuf::BufferJournalConfig journal_cfg()
+{
+    goby::middleware::intervehicle::protobuf::BufferJournalConfig cfg;
+    cfg.set_path(journal_file);
+    cfg.set_compact_size(4096);
+    return cfg;
+}
+
+// records still needed, as "type:id:modem_id:data"
+std::vector<std::string> replay(BufferJournal& journal)
+{
+    std::vector<std::string> records;
+    journal.replay([&](const BufferJournal::Record& r) {
+        records.push_back(std::to_string(static_cast<int>(r.type)) + ":" + std::to_string(r.id) +
+                          ":" + std::to_string(r.modem_id) + ":" + std::string(r.data, r.size));
+    });
+    return records;
+}
+
+void push_ack_expire()
+{
+    std::remove(journal_file.c_str());
+    auto t = goby::time::SystemClock::now();
+    {
+        BufferJournal journal(journal_cfg());
+        assert(journal.live_records() == 0);
+        journal.subscription(2, "sub");
+        auto a = journal.push(2, t, "a");
+        auto b = journal.push(3, t, "bb");
+        auto c = journal.push(2, t, "ccc");
+        journal.ack(b);
+        journal.expire(a);
+        // already removed
+        journal.ack(a);
+        assert(c == 4);
+        assert(journal.live_records() == 2);
+        // not committed: still read on reopening (the kernel has the pages)
+    }
+
+    {
+        BufferJournal journal(journal_cfg());
+        auto records = replay(journal);
+        assert(records.size() == 2);
+        assert(records[0] == "4:1:2:sub");
+        assert(records[1] == "1:4:2:ccc");
+
+        // ids continue from those in the file
+        assert(journal.push(2, t, "d") == 5);
+
+        // replay's visitor may write to the journal
+        journal.replay([&](const BufferJournal::Record& r) {
+            if (r.type == BufferJournal::RecordType::PUSH)
+                journal.expire(r.id);
+        });
+        assert(journal.live_records() == 1);
+    }
+
+    BufferJournal journal(journal_cfg());
+    auto records = replay(journal);
+    assert(records.size() == 1);
+    assert(records[0] == "4:1:2:sub");
+    // stored to the microsecond
+    journal.replay([&](const BufferJournal::Record& r) {
+        assert(r.time > t - std::chrono::microseconds(1));
+        assert(r.time < t + std::chrono::seconds(10));
+    });
+}
+
+// a value not requiring an ack is retired once it is sent
+void push_sent()
+{
+    std::remove(journal_file.c_str());
+    {
+        BufferJournal journal(journal_cfg());
+        auto a = journal.push(2, goby::time::SystemClock::now(), "a");
+        journal.sent(a);
+        assert(journal.live_records() == 0);
+        assert(journal.live_bytes() == 0);
+    }
+
+    BufferJournal journal(journal_cfg());
+    assert(replay(journal).empty());
+    assert(journal.live_records() == 0);
+}
+
+void torn_record()
+{
+    std::remove(journal_file.c_str());
+    std::uint64_t size;
+    {
+        BufferJournal journal(journal_cfg());
+        journal.push(1, goby::time::SystemClock::now(), "complete");
+        size = journal.size();
+        journal.push(1, goby::time::SystemClock::now(), "torn");
+        journal.commit();
+    }
+
+    // corrupt the data of the last record
+    {
+        std::fstream f(journal_file, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(size + 40);
+        f.write("x", 1);
+    }
+
+    BufferJournal journal(journal_cfg());
+    auto records = replay(journal);
+    assert(records.size() == 1);
+    assert(records[0] == "1:1:1:complete");
+    assert(journal.size() == size);
+
+    // the torn record is overwritten
+    journal.push(1, goby::time::SystemClock::now(), "next");
+    assert(replay(journal).size() == 2);
+}
+
+void compaction()
+{
+    std::remove(journal_file.c_str());
+    std::string data(100, 'x');
+    std::vector<BufferJournal::id_type> kept;
+    {
+        BufferJournal journal(journal_cfg());
+        journal.subscription(1, "sub");
+        for (int i = 0; i < 1000; ++i)
+        {
+            auto id = journal.push(1, goby::time::SystemClock::now(), data);
+            if (i % 100 == 0)
+                kept.push_back(id);
+            else
+                journal.ack(id);
+
+            journal.commit_if_due();
+            // compact_size is 4096 bytes
+            assert(journal.size() < 4096 + 2 * journal.live_bytes() + 200);
+        }
+        assert(journal.live_records() == 11);
+    }
+
+    // nothing left behind
+    std::ifstream compact(journal_file + ".compact");
+    assert(!compact.is_open());
+
+    BufferJournal journal(journal_cfg());
+    std::vector<BufferJournal::id_type> ids;
+    journal.replay([&](const BufferJournal::Record& r) {
+        if (r.type == BufferJournal::RecordType::PUSH)
+        {
+            ids.push_back(r.id);
+            assert(std::string(r.data, r.size) == data);
+        }
+    });
+    assert(ids == kept);
+}
+
+void not_a_journal()
+{
+    {
+        std::ofstream f(journal_file, std::ios::trunc);
+        f << "this is not a journal";
+    }
+
+    try
+    {
+        BufferJournal journal(journal_cfg());
+        assert(false);
+    }
+    catch (goby::Exception& e)
+    {
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    push_ack_expire();
+    push_sent();
+    torn_record();
+    compaction();
+    not_a_journal();
+
+    std::remove(journal_file.c_str());
+    std::cout << "all tests passed" << std::endl;
+}
@@ -19,7 +19,15 @@
 // You should have received a copy of the GNU General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdio>
+#include <thread>
+
 #include "goby/middleware/log.h"
+#include "goby/middleware/log/async_log_writer.h"
+#include "goby/middleware/log/log_block_writer.h"
+#include "goby/middleware/log/log_reader.h"
+#include "goby/middleware/log/log_writer.h"
+#include "goby/middleware/log/mapped_log_reader.h"
 #include "goby/middleware/log/dccl_log_plugin.h"
 #include "goby/middleware/log/protobuf_log_plugin.h"
 #include "goby/middleware/marshalling/interface.h"
@@ -30,11 +38,24 @@
 using goby::test::middleware::protobuf::CTDSample;
 using goby::test::middleware::protobuf::TempSample;
 using goby::middleware::log::LogEntry;
+using goby::middleware::log::MappedLogReader;
 
 constexpr goby::middleware::Group tempgroup("groups::temp");
 constexpr goby::middleware::Group ctdgroup("groups::ctd");
 int nctd = 6;
 
+// fixed entry times so that repeated writes produce identical files
+goby::time::SystemClock::time_point entry_time(int i)
+{
+    return goby::time::SystemClock::time_point(std::chrono::seconds(1500000000)) +
+           i * std::chrono::milliseconds(100);
+}
+
+std::uint64_t to_microseconds(goby::time::SystemClock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
 dccl::Codec codec;
 goby::middleware::log::ProtobufPlugin pb_plugin;
 goby::middleware::log::DCCLPlugin dccl_plugin;
@@ -68,6 +89,7 @@ void read_log(int test)
         assert(entry.scheme() == goby::middleware::MarshallingScheme::PROTOBUF);
         assert(entry.group() == tempgroup);
         assert(entry.type() == TempSample::descriptor()->full_name());
+        assert(entry.timestamp() == entry_time(0));
 
         auto temp_samples = pb_plugin.parse_message(entry);
         assert(temp_samples.size() == 1 && temp_samples[0]);
@@ -98,6 +120,7 @@ void read_log(int test)
         assert(entry.scheme() == goby::middleware::MarshallingScheme::DCCL);
         assert(entry.group() == ctdgroup);
         assert(entry.type() == CTDSample::descriptor()->full_name());
+        assert(entry.timestamp() == entry_time(i + 1));
 
         auto ctd_samples = dccl_plugin.parse_message(entry);
         assert(ctd_samples.size() == 2 && ctd_samples[0] && ctd_samples[1]);
@@ -122,10 +145,124 @@ void read_log(int test)
     }
 }
 
-void write_log(int test)
+// same checks as read_log() but using the indexed reader
+void read_mapped_log(int test)
+{
+    using goby::middleware::MarshallingScheme;
+
+    LogEntry::reset();
+    std::remove("/tmp/goby3_test_log.goby.idx");
+
+    std::ifstream in_log_file("/tmp/goby3_test_log.goby");
+    pb_plugin.register_read_hooks(in_log_file);
+    dccl_plugin.register_read_hooks(in_log_file);
+
+    for (auto source : {MappedLogReader::IndexSource::BUILT, MappedLogReader::IndexSource::SIDECAR})
+    {
+        dccl::DynamicProtobufManager::reset();
+        MappedLogReader reader("/tmp/goby3_test_log.goby");
+        assert(reader.index_source() == source);
+        assert(reader.version() == LogEntry::current_version);
+
+        bool has_temp = (test != 3 && test != 5 && test != 6);
+        std::size_t nctd_entries = nctd / 2;
+        assert(reader.size() == nctd_entries + (has_temp ? 1 : 0));
+        assert(reader.time_range(0).size() == reader.size());
+
+        const auto& temps =
+            reader.find(MarshallingScheme::PROTOBUF, test == 4 ? "_unknown1_" : "groups::temp",
+                        TempSample::descriptor()->full_name());
+        assert(temps.size() == (has_temp ? 1 : 0));
+        if (has_temp)
+        {
+            auto entry = reader.entry(temps[0]);
+            auto temp_samples = pb_plugin.parse_message(entry);
+            assert(temp_samples.size() == 1 && temp_samples[0]);
+            assert(dynamic_cast<TempSample&>(*temp_samples[0]).temperature() == 500);
+        }
+
+        const auto& ctds = reader.find(MarshallingScheme::DCCL, "groups::ctd",
+                                       CTDSample::descriptor()->full_name());
+        assert(ctds.size() == nctd_entries);
+        for (int i = 0; i < nctd / 2; ++i)
+        {
+            auto entry = reader.entry(ctds[i]);
+            assert(entry.data().size() == reader.data(ctds[i]).size());
+            assert(entry.timestamp() == entry_time(i + 1));
+            assert(reader.timestamp(ctds[i]) == to_microseconds(entry_time(i + 1)));
+            auto ctd_samples = dccl_plugin.parse_message(entry);
+            assert(ctd_samples.size() == 2);
+            assert(dynamic_cast<CTDSample&>(*ctd_samples[0]).temperature() == i * 2 + 5);
+            assert(dynamic_cast<CTDSample&>(*ctd_samples[1]).temperature() == (i * 2 + 1) + 5);
+        }
+
+        assert(reader.find(MarshallingScheme::DCCL, "groups::none", "none").empty());
+
+        // the last two CTD entries
+        auto recent = reader.time_range(to_microseconds(entry_time(2)));
+        assert(recent.size() == 2 && recent[0] == ctds[1] && recent[1] == ctds[2]);
+        assert(reader.time_range(to_microseconds(entry_time(2)), to_microseconds(entry_time(3)))
+                   .size() == 1);
+    }
+}
+
+// sidecar index is extended as the log grows, including past a partially written entry
+void mapped_log_incremental()
+{
+    using goby::middleware::MarshallingScheme;
+    const std::string log_file("/tmp/goby3_test_log_incremental.goby");
+
+    LogEntry::reset();
+    std::remove((log_file + ".idx").c_str());
+    std::ofstream out_log_file(log_file.c_str());
+
+    auto serialize_ctd = [](int i, std::ostream* os) {
+        CTDSample ctd;
+        ctd.set_temperature(i + 5);
+        std::string encoded;
+        codec.encode(&encoded, ctd);
+        LogEntry entry(std::vector<unsigned char>(encoded.begin(), encoded.end()),
+                       MarshallingScheme::DCCL, CTDSample::descriptor()->full_name(), ctdgroup);
+        entry.serialize(os);
+    };
+
+    auto check = [&](MappedLogReader::IndexSource source, std::size_t n,
+                     bool use_sidecar = true) {
+        MappedLogReader reader(log_file, use_sidecar);
+        assert(reader.index_source() == source);
+        assert(reader.size() == n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            CTDSample ctd;
+            auto data = reader.data(i);
+            codec.decode(std::string(data.begin(), data.end()), &ctd);
+            assert(ctd.temperature() == i + 5);
+            assert(reader.group(i) == "groups::ctd");
+        }
+    };
+
+    serialize_ctd(0, &out_log_file);
+    serialize_ctd(1, &out_log_file);
+
+    std::stringstream partial;
+    serialize_ctd(2, &partial);
+    auto partial_str = partial.str();
+    out_log_file << partial_str.substr(0, partial_str.size() / 2) << std::flush;
+
+    check(MappedLogReader::IndexSource::BUILT, 2);
+
+    out_log_file << partial_str.substr(partial_str.size() / 2);
+    serialize_ctd(3, &out_log_file);
+    out_log_file.flush();
+
+    check(MappedLogReader::IndexSource::SIDECAR_EXTENDED, 4);
+    check(MappedLogReader::IndexSource::SIDECAR, 4);
+    check(MappedLogReader::IndexSource::BUILT, 4, false);
+}
+
+void write_log(int test, std::ostream& out_log_file)
 {
     LogEntry::reset();
-    std::ofstream out_log_file("/tmp/goby3_test_log.goby");
     pb_plugin.register_write_hooks(out_log_file);
     dccl_plugin.register_write_hooks(out_log_file);
 
@@ -144,7 +281,8 @@ void write_log(int test)
         std::vector<unsigned char> data(t.ByteSize());
         t.SerializeToArray(&data[0], data.size());
         LogEntry entry(data, goby::middleware::MarshallingScheme::PROTOBUF,
-                                         TempSample::descriptor()->full_name(), tempgroup);
+                                         TempSample::descriptor()->full_name(), tempgroup,
+                       entry_time(0));
         entry.serialize(&out_log_file);
     }
 
@@ -188,6 +326,7 @@ void write_log(int test)
 
             out_log_file.seekp(
                 pos - std::ios::streamoff(LogEntry::crc_bytes_ + t.ByteSize() +
+                                          LogEntry::timestamp_bytes_ +
                                           LogEntry::type_bytes_ +
                                           LogEntry::group_bytes_ +
                                           LogEntry::scheme_bytes_ +
@@ -203,10 +342,11 @@ void write_log(int test)
 
             out_log_file.seekp(
                 pos - std::ios::streamoff(LogEntry::crc_bytes_ + t.ByteSize() +
+                                          LogEntry::timestamp_bytes_ +
                                           LogEntry::type_bytes_ +
                                           LogEntry::group_bytes_ +
                                           LogEntry::scheme_bytes_ + 1));
-            out_log_file.put(0x14);
+            out_log_file.put(0x14 + LogEntry::timestamp_bytes_);
             out_log_file.seekp(pos);
         }
     }
@@ -227,13 +367,483 @@ void write_log(int test)
 
         std::vector<unsigned char> data(encoded.begin(), encoded.end());
         LogEntry entry(data, goby::middleware::MarshallingScheme::DCCL,
-                                         CTDSample::descriptor()->full_name(), ctdgroup);
+                                         CTDSample::descriptor()->full_name(), ctdgroup,
+                       entry_time(i / 2 + 1));
         entry.serialize(&out_log_file);
         ctds.push_back(ctd1);
         ctds.push_back(ctd2);
     }
 }
 
+void write_log(int test)
+{
+    std::ofstream out_log_file("/tmp/goby3_test_log.goby");
+    write_log(test, out_log_file);
+}
+
+// AsyncLogWriter (with small blocks, so entries span blocks) writes the same bytes as std::ofstream
+void write_async_log()
+{
+    // copies everything to two streams (the plugins' file descriptor entries are timestamped when
+    // written, so writing the log twice wouldn't give the same bytes)
+    class TeeBuffer : public std::streambuf
+    {
+      public:
+        TeeBuffer(std::ostream& a, std::ostream& b) : a_(a), b_(b) {}
+
+      protected:
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                a_.put(traits_type::to_char_type(c));
+                b_.put(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override
+        {
+            a_.write(s, n);
+            b_.write(s, n);
+            return n;
+        }
+
+      private:
+        std::ostream& a_;
+        std::ostream& b_;
+    };
+
+    goby::middleware::protobuf::LogWriterConfig cfg;
+    cfg.set_block_size(16);
+    cfg.set_max_queued_blocks(1000);
+    cfg.set_sync_policy(goby::middleware::protobuf::LogWriterConfig::SYNC_EVERY_WRITE);
+    {
+        std::ofstream reference_log_file("/tmp/goby3_test_log.goby");
+        goby::middleware::log::AsyncLogWriter out_log_file("/tmp/goby3_test_log_async.goby", cfg);
+        TeeBuffer tee_buffer(reference_log_file, out_log_file);
+        std::ostream tee(&tee_buffer);
+        write_log(0, tee);
+        reference_log_file.close();
+        out_log_file.close();
+        assert(out_log_file.size() == out_log_file.status().bytes_written());
+
+        auto status = out_log_file.status();
+        assert(status.bytes_written() > 0);
+        assert(status.write_errors() == 0);
+        assert(status.syncs() > 0);
+        assert(status.queued_blocks() == 0);
+    }
+
+    auto read_file = [](const std::string& name) {
+        std::ifstream in(name.c_str());
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    assert(read_file("/tmp/goby3_test_log.goby") == read_file("/tmp/goby3_test_log_async.goby"));
+
+    // once max_queued_blocks are waiting, entries are dropped
+    cfg.set_max_queued_blocks(0);
+    goby::middleware::log::AsyncLogWriter dropping_log_file("/tmp/goby3_test_log_async.goby", cfg);
+    assert(!dropping_log_file.accept_entry());
+    assert(dropping_log_file.status().entries_dropped() == 1);
+}
+
+// version 2 files (without timestamps) are still readable
+// files written by older versions (CRC-32 rather than CRC-32C; no timestamps before version 3)
+void read_old_log(std::uint32_t version)
+{
+    using goby::middleware::MarshallingScheme;
+    const std::string log_file("/tmp/goby3_test_log_v" + std::to_string(version) + ".goby");
+
+    LogEntry::reset();
+    std::remove((log_file + ".idx").c_str());
+    {
+        std::ofstream out_log_file(log_file.c_str());
+        const char version_bytes[LogEntry::version_bytes_] = {0, 0, 0, static_cast<char>(version)};
+        out_log_file.write(version_bytes, LogEntry::version_bytes_);
+        LogEntry::version_ = version;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            CTDSample ctd;
+            ctd.set_temperature(i + 5);
+            std::string encoded;
+            codec.encode(&encoded, ctd);
+            LogEntry entry(std::vector<unsigned char>(encoded.begin(), encoded.end()),
+                           MarshallingScheme::DCCL, CTDSample::descriptor()->full_name(),
+                           ctdgroup, entry_time(i));
+            entry.serialize(&out_log_file);
+        }
+    }
+
+    LogEntry::reset();
+    std::ifstream in_log_file(log_file.c_str());
+    for (int i = 0; i < 2; ++i)
+    {
+        LogEntry entry;
+        entry.parse(&in_log_file);
+        assert(LogEntry::version_ == version);
+        assert(entry.type() == CTDSample::descriptor()->full_name());
+        assert(entry.timestamp() ==
+               (version >= 3 ? entry_time(i) : goby::time::SystemClock::time_point()));
+        CTDSample ctd;
+        codec.decode(std::string(entry.data().begin(), entry.data().end()), &ctd);
+        assert(ctd.temperature() == i + 5);
+    }
+
+    LogEntry::reset();
+    MappedLogReader reader(log_file);
+    assert(reader.version() == version);
+    assert(reader.size() == 2);
+    for (std::size_t i = 0; i < reader.size(); ++i)
+    {
+        assert(reader.timestamp(i) == (version >= 3 ? to_microseconds(entry_time(i)) : 0));
+        CTDSample ctd;
+        auto data = reader.data(i);
+        codec.decode(std::string(data.begin(), data.end()), &ctd);
+        assert(ctd.temperature() == i + 5);
+    }
+}
+
+// entries written in compressed blocks read back the same, and blocks can be skipped
+void compressed_log(std::uint32_t block_size)
+{
+    using goby::middleware::MarshallingScheme;
+    const std::string log_file("/tmp/goby3_test_log_compressed.goby");
+    const int nentries = 4;
+
+    goby::middleware::protobuf::LogCompressionConfig cfg;
+#ifndef HAS_ZLIB
+    cfg.set_codec(goby::middleware::protobuf::LogCompressionConfig::NONE);
+#endif
+    cfg.set_block_size(block_size);
+
+    // entry 0 is a TempSample, the rest are CTDSamples
+    auto check_entry = [](int i, int scheme, const std::string& group,
+                          const std::vector<unsigned char>& data) {
+        if (i == 0)
+        {
+            assert(scheme == MarshallingScheme::PROTOBUF && group == "groups::temp");
+            TempSample t;
+            t.ParseFromArray(&data[0], data.size());
+            assert(t.temperature() == 500);
+        }
+        else
+        {
+            assert(scheme == MarshallingScheme::DCCL && group == "groups::ctd");
+            CTDSample ctd;
+            codec.decode(std::string(data.begin(), data.end()), &ctd);
+            assert(ctd.temperature() == i + 5);
+        }
+    };
+
+    LogEntry::reset();
+    std::remove((log_file + ".idx").c_str());
+    {
+        std::ofstream out_log_file(log_file.c_str());
+        pb_plugin.register_write_hooks(out_log_file);
+        dccl_plugin.register_write_hooks(out_log_file);
+        goby::middleware::log::LogBlockWriter writer(out_log_file, cfg);
+
+        TempSample t;
+        t.set_temperature(500);
+        std::vector<unsigned char> temp_data(t.ByteSize());
+        t.SerializeToArray(&temp_data[0], temp_data.size());
+        writer.write(LogEntry(temp_data, MarshallingScheme::PROTOBUF,
+                              TempSample::descriptor()->full_name(), tempgroup, entry_time(0)));
+
+        for (int i = 1; i < nentries; ++i)
+        {
+            CTDSample ctd;
+            ctd.set_temperature(i + 5);
+            std::string encoded;
+            codec.encode(&encoded, ctd);
+            writer.write(LogEntry(std::vector<unsigned char>(encoded.begin(), encoded.end()),
+                                  MarshallingScheme::DCCL, CTDSample::descriptor()->full_name(),
+                                  ctdgroup, entry_time(i)));
+        }
+        writer.flush();
+        assert(writer.pending_entries() == 0);
+        assert(writer.blocks_written() == (block_size == 1 ? nentries : 1));
+        assert(writer.uncompressed_bytes() > 0 && writer.compressed_bytes() > 0);
+    }
+
+    // sequential, skipping blocks that end before entry 2
+    for (bool skip : {false, true})
+    {
+        LogEntry::reset();
+        dccl::DynamicProtobufManager::reset();
+        std::ifstream in_log_file(log_file.c_str());
+        pb_plugin.register_read_hooks(in_log_file);
+        if (skip)
+        {
+            LogEntry::block_filter = [](const goby::middleware::log::LogBlockHeader& header) {
+                assert(header.entry_count > 0 && header.begin <= header.end);
+                assert(!LogEntry::block_groups(header).empty());
+                return header.end >= to_microseconds(entry_time(2));
+            };
+        }
+
+        int first = (skip && block_size == 1) ? 2 : 0;
+        for (int i = first; i < nentries; ++i)
+        {
+            LogEntry entry;
+            entry.parse(&in_log_file);
+            assert(entry.timestamp() == entry_time(i));
+            check_entry(i, entry.scheme(), entry.group(), entry.data());
+        }
+
+        try
+        {
+            LogEntry entry;
+            entry.parse(&in_log_file);
+            bool expected_eof = false;
+            assert(expected_eof);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            assert(in_log_file.eof());
+        }
+    }
+
+    // indexed, from the log then from the sidecar file
+    LogEntry::reset();
+    std::ifstream in_log_file(log_file.c_str());
+    pb_plugin.register_read_hooks(in_log_file);
+    for (auto source : {MappedLogReader::IndexSource::BUILT, MappedLogReader::IndexSource::SIDECAR})
+    {
+        dccl::DynamicProtobufManager::reset();
+        MappedLogReader reader(log_file);
+        assert(reader.index_source() == source);
+        assert(reader.blocks() == (block_size == 1 ? nentries : 1));
+        assert(reader.size() == nentries);
+        for (int i = 0; i < nentries; ++i)
+        {
+            assert(reader.timestamp(i) == to_microseconds(entry_time(i)));
+            auto data = reader.data(i);
+            check_entry(i, reader.scheme(i), reader.group(i),
+                        std::vector<unsigned char>(data.begin(), data.end()));
+        }
+        assert(reader.time_range(to_microseconds(entry_time(2))).size() == 2);
+    }
+
+    // a view keeps its decompressed block after the cache drops it
+    {
+        dccl::DynamicProtobufManager::reset();
+        MappedLogReader reader(log_file);
+        reader.set_max_cached_blocks(1);
+        auto first = reader.data(0);
+        for (int i = 1; i < nentries; ++i) reader.data(i);
+        check_entry(0, reader.scheme(0), reader.group(0),
+                    std::vector<unsigned char>(first.begin(), first.end()));
+    }
+}
+
+// after LogEntry::reset_index() and re-registering the write hooks, each file can be read alone
+void segmented_log()
+{
+    const int nsegments = 3;
+    auto segment_file = [](int i) {
+        return "/tmp/goby3_test_log_segment_" + std::to_string(i) + ".goby";
+    };
+
+    LogEntry::reset();
+    for (int i = 0; i < nsegments; ++i)
+    {
+        goby::middleware::log::AsyncLogWriter out_log_file(segment_file(i));
+        LogEntry::reset_index();
+        pb_plugin.register_write_hooks(out_log_file);
+        dccl_plugin.register_write_hooks(out_log_file);
+
+        TempSample t;
+        t.set_temperature(500 + i);
+        std::vector<unsigned char> data(t.ByteSize());
+        t.SerializeToArray(&data[0], data.size());
+        LogEntry entry(data, goby::middleware::MarshallingScheme::PROTOBUF,
+                       TempSample::descriptor()->full_name(), tempgroup, entry_time(i));
+        entry.serialize(&out_log_file);
+
+        auto size = out_log_file.size();
+        out_log_file.close();
+        assert(out_log_file.status().bytes_written() == size);
+    }
+
+    // read the last one first, so that nothing is left over from reading the others
+    for (int i = nsegments - 1; i >= 0; --i)
+    {
+        LogEntry::reset();
+        dccl::DynamicProtobufManager::reset();
+        std::remove((segment_file(i) + ".idx").c_str());
+        std::ifstream in_log_file(segment_file(i).c_str());
+        pb_plugin.register_read_hooks(in_log_file);
+
+        LogEntry entry;
+        entry.parse(&in_log_file);
+        assert(entry.group() == tempgroup);
+        assert(entry.type() == TempSample::descriptor()->full_name());
+        assert(entry.timestamp() == entry_time(i));
+
+        auto temp_samples = pb_plugin.parse_message(entry);
+        assert(temp_samples.size() == 1);
+        assert(temp_samples[0]->GetDescriptor()->full_name() ==
+               TempSample::descriptor()->full_name());
+        assert(temp_samples[0]->ShortDebugString() ==
+               "temperature: " + std::to_string(500 + i));
+
+        MappedLogReader reader(segment_file(i));
+        assert(reader.size() == 1 && reader.group(0) == "groups::temp");
+    }
+}
+
+// LogWriter / LogReader each have their own index tables, so files can be written and read
+// concurrently
+void concurrent_logs()
+{
+    const int nfiles = 4;
+    const int nentries = 200;
+    auto log_file = [](int f) {
+        return "/tmp/goby3_test_log_concurrent_" + std::to_string(f) + ".goby";
+    };
+    // each file uses the groups in a different order, so their group indices differ
+    auto group = [](int f, int i) { return "groups::" + std::to_string((f + i) % nfiles); };
+    auto entry_data = [](int f, int i) {
+        return std::vector<unsigned char>{static_cast<unsigned char>(f),
+                                          static_cast<unsigned char>(i)};
+    };
+
+    goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+    // the global state is left alone
+    LogEntry::reset();
+
+    std::vector<std::thread> threads;
+    for (int f = 0; f < nfiles; ++f)
+    {
+        threads.emplace_back([&, f]() {
+            std::ofstream out_log_file(log_file(f).c_str());
+            goby::middleware::log::LogWriter writer(out_log_file);
+            int new_groups = 0;
+            writer.hooks().new_group[goby::middleware::MarshallingScheme::PROTOBUF] =
+                [&](const goby::middleware::Group& group) { ++new_groups; };
+
+            for (int i = 0; i < nentries; ++i)
+            {
+                writer.write(LogEntry(entry_data(f, i),
+                                      goby::middleware::MarshallingScheme::PROTOBUF,
+                                      TempSample::descriptor()->full_name(),
+                                      goby::middleware::DynamicGroup(group(f, i)), entry_time(i)));
+            }
+            assert(new_groups == nfiles);
+        });
+    }
+    for (auto& t : threads) t.join();
+    threads.clear();
+
+    assert(LogEntry::version_ == LogEntry::invalid_version);
+
+    for (int f = 0; f < nfiles; ++f)
+    {
+        threads.emplace_back([&, f]() {
+            std::ifstream in_log_file(log_file(f).c_str());
+            goby::middleware::log::LogReader reader(in_log_file);
+            for (int i = 0; i < nentries; ++i)
+            {
+                auto entry = reader.read();
+                assert(std::string(entry.group()) == group(f, i));
+                assert(entry.type() == TempSample::descriptor()->full_name());
+                assert(entry.data() == entry_data(f, i));
+                assert(entry.timestamp() == entry_time(i));
+            }
+            assert(reader.version() == LogEntry::current_version);
+
+            try
+            {
+                reader.read();
+                bool expected_eof = false;
+                assert(expected_eof);
+            }
+            catch (std::ifstream::failure& e)
+            {
+                assert(in_log_file.eof());
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    // hooks of a LogReader are used by the MappedLogReader
+    goby::middleware::log::LogReader hooked_reader(std::cin);
+    hooked_reader.hooks().filter[{goby::middleware::MarshallingScheme::PROTOBUF, group(0, 0),
+                                  TempSample::descriptor()->full_name()}] =
+        [](const std::vector<unsigned char>& data) {};
+    MappedLogReader mapped(log_file(0), false, hooked_reader.hooks());
+    assert(mapped.size() == nentries - nentries / nfiles);
+    assert(LogEntry::filter_hook.empty());
+}
+
+// one plugin registered on two files writes the file descriptors to each of them
+void shared_plugin_logs()
+{
+    auto file_desc_entries = [](std::stringstream& log) {
+        goby::middleware::log::LogReader reader(log);
+        int n = 0;
+        try
+        {
+            for (;;)
+            {
+                if (std::string(reader.read().group()) ==
+                    std::string(goby::middleware::log::file_desc_group))
+                    ++n;
+            }
+        }
+        catch (std::ios_base::failure& e)
+        {
+        }
+        return n;
+    };
+
+    goby::middleware::log::ProtobufPlugin plugin;
+    std::stringstream out[2];
+    goby::middleware::log::LogWriter writer0(out[0]), writer1(out[1]);
+    plugin.register_write_hooks(writer0.stream(), writer0.index());
+    plugin.register_write_hooks(writer1.stream(), writer1.index());
+
+    LogEntry entry(std::vector<unsigned char>(1, 'a'),
+                   goby::middleware::MarshallingScheme::PROTOBUF,
+                   TempSample::descriptor()->full_name(), tempgroup, entry_time(0));
+    writer0.write(entry);
+    writer1.write(entry);
+    // already written to this file
+    writer0.write(entry);
+
+    int n0 = file_desc_entries(out[0]);
+    assert(n0 > 0);
+    assert(file_desc_entries(out[1]) == n0);
+}
+
+void entry_checksums()
+{
+    using goby::middleware::log::crc32c;
+    const std::string check("123456789");
+    assert(crc32c(0, check.data(), check.size()) == 0xE3069283);
+    assert(crc32c(crc32c(0, check.data(), 4), check.data() + 4, check.size() - 4) == 0xE3069283);
+    std::cout << "CRC-32C in hardware: " << std::boolalpha
+              << goby::middleware::log::crc32c_hardware() << std::endl;
+
+    // current version entries end in the CRC-32C of the rest of the entry
+    std::stringstream out;
+    goby::middleware::log::LogWriter writer(out);
+    writer.write(LogEntry(std::vector<unsigned char>(1000, 'a'),
+                          goby::middleware::MarshallingScheme::PROTOBUF,
+                          TempSample::descriptor()->full_name(), tempgroup, entry_time(0)));
+    std::string log = out.str();
+    auto entry_end = log.size();
+    auto entry_begin = log.rfind("GBY3");
+    std::uint32_t given_crc = 0;
+    for (auto i = entry_end - LogEntry::crc_bytes_; i < entry_end; ++i)
+        given_crc = (given_crc << 8) | (log[i] & 0xFF);
+    assert(given_crc ==
+           crc32c(0, &log[entry_begin], entry_end - LogEntry::crc_bytes_ - entry_begin));
+}
+
 int main(int argc, char* argv[])
 {
     goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
@@ -248,7 +858,20 @@ int main(int argc, char* argv[])
         std::cout << "Running test " << test << std::endl;
         write_log(test);
         read_log(test);
+        read_mapped_log(test);
     }
 
+    mapped_log_incremental();
+    write_async_log();
+    read_old_log(2);
+    read_old_log(3);
+    // one entry per block, and all entries in one block
+    compressed_log(1);
+    compressed_log(1 << 20);
+    segmented_log();
+    concurrent_logs();
+    shared_plugin_logs();
+    entry_checksums();
+
     std::cout << "all tests passed" << std::endl;
 }
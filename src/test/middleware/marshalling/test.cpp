@@ -0,0 +1,159 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <deque>
+#include <iostream>
+#include <thread>
+
+#include "goby/middleware/marshalling/cstr.h"
+#include "goby/middleware/marshalling/dccl.h"
+#include "goby/middleware/marshalling/protobuf.h"
+#include "goby/util/debug_logger.h"
+
+#include "test.pb.h"
+
+using goby::middleware::ArrayByteSink;
+using goby::middleware::ByteSink;
+using goby::middleware::ContainerByteSink;
+using goby::middleware::MarshallingScheme;
+using goby::middleware::SerializerParserHelper;
+
+namespace goby
+{
+namespace middleware
+{
+// scheme that only provides serialize(), to test the fallbacks
+constexpr int DEQUECHAR = 1000;
+template <> struct SerializerParserHelper<std::deque<char>, DEQUECHAR>
+{
+    static std::vector<char> serialize(const std::deque<char>& msg)
+    {
+        return std::vector<char>(msg.begin(), msg.end());
+    }
+};
+} // namespace middleware
+} // namespace goby
+
+// serialize_to() must produce the same bytes as serialize(), into any ByteSink
+template <typename Data, int scheme> void check_serialize_to(const Data& d)
+{
+    std::vector<char> expected(SerializerParserHelper<Data, scheme>::serialize(d));
+    assert((goby::middleware::serialized_size<Data, scheme>(d) == expected.size()));
+
+    // appends to existing contents
+    std::string str("prefix");
+    ContainerByteSink<std::string> string_sink(str);
+    goby::middleware::serialize_to<Data, scheme>(d, string_sink);
+    assert(str.substr(0, 6) == "prefix");
+    assert(str.substr(6) == std::string(expected.begin(), expected.end()));
+
+    std::vector<char> array(expected.size() + 2, 'X');
+    ArrayByteSink array_sink(&array[1], expected.size());
+    goby::middleware::serialize_to<Data, scheme>(d, array_sink);
+    assert(std::equal(expected.begin(), expected.end(), array.begin() + 1));
+    assert(array.front() == 'X' && array.back() == 'X');
+
+    // too small
+    if (!expected.empty())
+    {
+        bool caught = false;
+        ArrayByteSink small_sink(&array[0], expected.size() - 1);
+        try
+        {
+            goby::middleware::serialize_to<Data, scheme>(d, small_sink);
+        }
+        catch (goby::Exception& e)
+        {
+            caught = true;
+        }
+        assert(caught);
+    }
+
+    std::cout << MarshallingScheme::to_string(scheme) << ": " << expected.size() << " bytes OK"
+              << std::endl;
+}
+
+// DCCL type metadata is computed once and shared between threads
+void check_dccl_type_info()
+{
+    using goby::middleware::DCCLSerializerParserHelperBase;
+    using goby::test::middleware::protobuf::CTDSample;
+
+    const auto& name = SerializerParserHelper<CTDSample, MarshallingScheme::DCCL>::type_name();
+    assert(&name == &CTDSample::descriptor()->full_name());
+
+    const auto* info = DCCLSerializerParserHelperBase::type_info(name);
+    assert(info != nullptr);
+    assert(info->desc == CTDSample::descriptor());
+    assert(info->dccl_id == 127);
+    assert(info->name() == name);
+    assert(DCCLSerializerParserHelperBase::type_info(name) == info);
+    assert(DCCLSerializerParserHelperBase::id(name) == 127);
+    assert((SerializerParserHelper<CTDSample, MarshallingScheme::DCCL>::id() == 127));
+
+    const DCCLSerializerParserHelperBase::TypeInfo* thread_info = nullptr;
+    std::thread t([&]() { thread_info = DCCLSerializerParserHelperBase::type_info(name); });
+    t.join();
+    assert(thread_info == info);
+
+    assert(DCCLSerializerParserHelperBase::type_info("goby.test.NoSuchType") == nullptr);
+    assert(DCCLSerializerParserHelperBase::id("goby.test.NoSuchType") == 0);
+
+    std::cout << "DCCL type_info OK" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    static_assert(goby::middleware::has_serialized_size<std::string, MarshallingScheme::CSTR>(),
+                  "CSTR provides serialized_size()");
+    static_assert(
+        !goby::middleware::has_serialized_size<std::deque<char>, goby::middleware::DEQUECHAR>(),
+        "DEQUECHAR only provides serialize()");
+
+    check_serialize_to<std::string, MarshallingScheme::CSTR>(std::string("hello, world"));
+    check_serialize_to<std::string, MarshallingScheme::CSTR>(std::string());
+
+    goby::test::middleware::protobuf::CTDSample ctd;
+    ctd.set_salinity(30.1);
+    ctd.set_temperature(15.2);
+    ctd.set_depth(100);
+    check_serialize_to<goby::test::middleware::protobuf::CTDSample, MarshallingScheme::PROTOBUF>(
+        ctd);
+    check_serialize_to<goby::test::middleware::protobuf::CTDSample, MarshallingScheme::DCCL>(ctd);
+    check_serialize_to<google::protobuf::Message, MarshallingScheme::PROTOBUF>(ctd);
+    check_serialize_to<google::protobuf::Message, MarshallingScheme::DCCL>(ctd);
+
+    // empty protobuf message serializes to zero bytes
+    check_serialize_to<goby::test::middleware::protobuf::CTDSample, MarshallingScheme::PROTOBUF>(
+        goby::test::middleware::protobuf::CTDSample());
+
+    check_serialize_to<std::deque<char>, goby::middleware::DEQUECHAR>(
+        std::deque<char>{'a', 'b', 'c'});
+
+    check_dccl_type_info();
+
+    std::cout << "all tests passed" << std::endl;
+}
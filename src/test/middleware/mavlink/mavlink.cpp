@@ -48,6 +48,14 @@ MAVLinkMessage run_serialize_parse(const MAVLinkMessage& packet_in)
         SerializerParserHelper<MAVLinkMessage,
                                goby::middleware::scheme<MAVLinkMessage>()>::serialize(packet_in);
 
+    constexpr auto scheme = goby::middleware::scheme<MAVLinkMessage>();
+    BOOST_CHECK_EQUAL(goby::middleware::serialized_size<MAVLinkMessage, scheme>(packet_in),
+                      bytes.size());
+    std::vector<char> sink_bytes;
+    goby::middleware::ContainerByteSink<std::vector<char>> sink(sink_bytes);
+    goby::middleware::serialize_to<MAVLinkMessage, scheme>(packet_in, sink);
+    BOOST_CHECK(sink_bytes == bytes);
+
     auto bytes_begin = bytes.begin(), bytes_end = bytes.end(), actual_end = bytes.begin();
     auto packet_out =
         SerializerParserHelper<MAVLinkMessage, goby::middleware::scheme<MAVLinkMessage>()>::parse(
@@ -0,0 +1,134 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/marshalling/dccl.h"
+
+#include "test.pb.h"
+
+// DCCL encode/decode throughput from 1-16 threads, for each
+// DCCLSerializerParserHelperBase::CodecMode
+
+using Clock = std::chrono::steady_clock;
+using goby::middleware::DCCLSerializerParserHelperBase;
+using goby::middleware::MarshallingScheme;
+using goby::middleware::SerializerParserHelper;
+using goby::test::middleware::protobuf::CTDSample;
+using goby::test::middleware::protobuf::NavSample;
+
+const int round_trips_per_thread = 20000;
+
+std::atomic<int> failures(0);
+
+// encode and decode, checking the result
+template <typename Data> void round_trip(const Data& d)
+{
+    using Helper = SerializerParserHelper<Data, MarshallingScheme::DCCL>;
+    auto bytes = Helper::serialize(d);
+    auto actual_end = bytes.cbegin();
+    auto parsed = Helper::parse(bytes.cbegin(), bytes.cend(), actual_end);
+    if (actual_end != bytes.cend() || parsed->index() != d.index())
+        ++failures;
+}
+
+void worker(int thread_index)
+{
+    CTDSample ctd;
+    ctd.set_salinity(30.1);
+    ctd.set_temperature(15.2);
+    ctd.set_depth(100);
+
+    NavSample nav;
+    nav.set_x(thread_index);
+    nav.set_y(-thread_index);
+
+    for (int i = 0; i < round_trips_per_thread; ++i)
+    {
+        // alternate types so that each thread's codec needs more than one type
+        if (i % 2)
+        {
+            ctd.set_index(i);
+            round_trip(ctd);
+        }
+        else
+        {
+            nav.set_index(i);
+            round_trip(nav);
+        }
+    }
+}
+
+void run(const std::string& mode_name)
+{
+    double single_thread_rate = 0;
+    for (int num_threads = 1; num_threads <= 16; num_threads *= 2)
+    {
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; ++i) threads.emplace_back(worker, i);
+        for (auto& t : threads) t.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        double rate = num_threads * round_trips_per_thread / seconds;
+        if (num_threads == 1)
+            single_thread_rate = rate;
+
+        std::cout << std::fixed << std::setprecision(0) << mode_name << ": " << std::setw(2)
+                  << num_threads << " threads: " << rate << " round trips/s ("
+                  << std::setprecision(2) << rate / single_thread_rate << "x)" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // loaded in the main thread, so THREAD_LOCAL workers must replicate it into their codecs
+    assert((SerializerParserHelper<CTDSample, MarshallingScheme::DCCL>::id() == 127));
+
+    run("SHARED");
+    assert(failures == 0);
+
+    try
+    {
+        DCCLSerializerParserHelperBase::set_codec_mode(
+            DCCLSerializerParserHelperBase::CodecMode::THREAD_LOCAL);
+    }
+    catch (goby::Exception& e)
+    {
+        std::cout << "Skipping THREAD_LOCAL: " << e.what() << std::endl;
+    }
+
+    if (DCCLSerializerParserHelperBase::codec_mode() ==
+        DCCLSerializerParserHelperBase::CodecMode::THREAD_LOCAL)
+    {
+        run("THREAD_LOCAL");
+        assert(failures == 0);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,130 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/transport/interthread.h"
+
+// latency test for InterThreadTransporter: one publisher fanning out to many subscriber threads
+
+using Mode = goby::middleware::InterThreadTransporter::Mode;
+using Clock = std::chrono::steady_clock;
+
+struct Stamped
+{
+    Clock::time_point published;
+    int index;
+};
+
+constexpr goby::middleware::Group stamped_group{"Stamped"};
+
+const int num_subscribers = 12;
+const int max_publish = 2000;
+const auto publish_interval = std::chrono::microseconds(100);
+
+Mode mode = Mode::LOCKED_QUEUE;
+std::atomic<int> ready(0);
+
+void subscriber(std::vector<Clock::duration>& latencies)
+{
+    goby::middleware::InterThreadTransporter interthread(mode);
+    int last_index = -1;
+    interthread.subscribe<stamped_group, Stamped>([&](std::shared_ptr<const Stamped> s) {
+        latencies.push_back(Clock::now() - s->published);
+        // in order delivery
+        assert(s->index == last_index + 1);
+        last_index = s->index;
+    });
+    ++ready;
+
+    auto timeout = Clock::now() + std::chrono::seconds(30);
+    while (static_cast<int>(latencies.size()) < max_publish)
+    {
+        interthread.poll(std::chrono::seconds(1));
+        if (Clock::now() > timeout)
+        {
+            std::cerr << "Timed out waiting for data, received " << latencies.size() << "/"
+                      << max_publish << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void publisher()
+{
+    goby::middleware::InterThreadTransporter interthread(mode);
+    while (ready < num_subscribers) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    for (int i = 0; i < max_publish; ++i)
+    {
+        auto s = std::make_shared<Stamped>();
+        s->index = i;
+        s->published = Clock::now();
+        interthread.publish<stamped_group>(s);
+        std::this_thread::sleep_for(publish_interval);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 2)
+        mode = std::stoi(argv[1]) == 0 ? Mode::LOCKED_QUEUE : Mode::MAILBOX;
+
+    std::cout << "Running test type (0 = locked queue, 1 = mailbox): "
+              << (mode == Mode::LOCKED_QUEUE ? 0 : 1) << std::endl;
+
+    std::vector<std::vector<Clock::duration>> latencies(num_subscribers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_subscribers; ++i)
+    {
+        latencies[i].reserve(max_publish);
+        threads.emplace_back([&latencies, i]() { subscriber(latencies[i]); });
+    }
+    std::thread pub(publisher);
+
+    pub.join();
+    for (auto& t : threads) t.join();
+
+    std::vector<Clock::duration> all;
+    for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    assert(static_cast<int>(all.size()) == num_subscribers * max_publish);
+    std::sort(all.begin(), all.end());
+
+    auto percentile = [&](double p) {
+        auto i = std::min(all.size() - 1, static_cast<std::size_t>(p / 100 * all.size()));
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(all[i]).count() / 1000.0;
+    };
+
+    std::cout << "Latency (us) over " << all.size() << " deliveries to " << num_subscribers
+              << " subscribers:" << std::fixed << std::setprecision(1)
+              << "\n\tp50: " << percentile(50) << "\n\tp90: " << percentile(90)
+              << "\n\tp99: " << percentile(99) << "\n\tp99.9: " << percentile(99.9)
+              << "\n\tmax: " << percentile(100) << std::endl;
+
+    std::cout << "all tests passed" << std::endl;
+}
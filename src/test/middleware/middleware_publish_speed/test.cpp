@@ -0,0 +1,98 @@
+// Copyright 2009-2018 Toby Schneider (http://gobysoft.org/index.wt/people/toby)
+//                     GobySoft, LLC (2013-)
+//                     Massachusetts Institute of Technology (2007-2014)
+//                     Community contributors (see AUTHORS file)
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/transport/interthread.h"
+
+// publish throughput for InterThreadTransporter to string named groups (exercises Group hashing
+// and comparison)
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample
+{
+    int index;
+};
+
+const int num_groups = 16;
+const int max_publish = 200000;
+
+std::atomic<int> ready(0);
+std::atomic<int> receive_count(0);
+
+// typical group names from goby apps, made unique by a suffix
+std::vector<goby::middleware::DynamicGroup> make_groups()
+{
+    std::vector<goby::middleware::DynamicGroup> groups;
+    for (int i = 0; i < num_groups; ++i)
+        groups.emplace_back("goby::middleware::frontseat::node_status::" + std::to_string(i));
+    return groups;
+}
+
+void subscriber()
+{
+    goby::middleware::InterThreadTransporter interthread;
+    auto groups = make_groups();
+    for (const auto& group : groups)
+        interthread.subscribe_dynamic<Sample>([](const Sample& s) { ++receive_count; }, group);
+    ++ready;
+
+    while (receive_count < max_publish) interthread.poll(std::chrono::seconds(1));
+}
+
+int main(int argc, char* argv[])
+{
+    std::thread t(subscriber);
+    while (!ready) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    goby::middleware::InterThreadTransporter interthread;
+    auto groups = make_groups();
+
+    auto start = Clock::now();
+    for (int i = 0; i < max_publish; ++i)
+    {
+        auto s = std::make_shared<Sample>();
+        s->index = i;
+        interthread.publish_dynamic<Sample>(s, groups[i % num_groups]);
+    }
+    auto publish_end = Clock::now();
+    t.join();
+    auto receive_end = Clock::now();
+
+    assert(receive_count == max_publish);
+
+    auto seconds = [&](Clock::time_point end) {
+        return std::chrono::duration<double>(end - start).count();
+    };
+    std::cout << std::fixed << std::setprecision(0) << "Published " << max_publish << " to "
+              << num_groups << " groups: " << max_publish / seconds(publish_end)
+              << " publications/s (" << max_publish / seconds(receive_end)
+              << " received/s)" << std::endl;
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -45,6 +45,7 @@ goby::middleware::InterThreadTransporter inproc3;
 int publish_count = 0;
 const int max_publish = 100;
 int ipc_receive_count = {0};
+int ipc_span_receive_count = {0};
 
 std::atomic<bool> forward(true);
 std::atomic<bool> zmq_ready(false);
@@ -101,6 +102,15 @@ void subscriber()
     goby::middleware::InterProcessForwarder<goby::middleware::InterThreadTransporter> ipc(inproc1);
     ipc.subscribe_regex(&handle_all, {goby::middleware::MarshallingScheme::ALL_SCHEMES});
 
+    // same publications, without copying the data
+    ipc.subscribe_regex(
+        [&](goby::middleware::ByteSpan data, int scheme, const std::string& type,
+            const goby::middleware::Group& group) {
+            assert(!data.empty());
+            ++ipc_span_receive_count;
+        },
+        {goby::middleware::MarshallingScheme::ALL_SCHEMES});
+
     ipc.subscribe_type_regex<sample1, google::protobuf::Message>(
         [&](std::shared_ptr<const google::protobuf::Message> msg, const std::string& type) {
             glog.is(DEBUG1) &&
@@ -114,12 +124,13 @@ void subscriber()
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     std::chrono::system_clock::time_point timeout = start + std::chrono::seconds(10);
-    while (ipc_receive_count < 4 * max_publish)
+    while (ipc_receive_count < 4 * max_publish || ipc_span_receive_count < 4 * max_publish)
     {
         ipc.poll(std::chrono::seconds(1));
         if (std::chrono::system_clock::now() > timeout)
             glog.is(DIE) && glog << "InterProcessForwarder timed out waiting for data" << std::endl;
     }
+    assert(ipc_span_receive_count == ipc_receive_count);
 }
 
 // thread 3
@@ -128,6 +139,7 @@ void zmq_forward(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
     bool non_template_receive = false;
     bool template_receive = false;
     bool special_chars_receive = false;
+    bool span_receive = false;
 
     goby::zeromq::InterProcessPortal<goby::middleware::InterThreadTransporter> ipc(inproc3, cfg);
     ipc.subscribe_regex(
@@ -142,6 +154,17 @@ void zmq_forward(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
         },
         {goby::middleware::MarshallingScheme::PROTOBUF}, ".*Sample", "Sample1|Sample2");
 
+    ipc.subscribe_regex(
+        [&](goby::middleware::ByteSpan data, int scheme, const std::string& type,
+            const goby::middleware::Group& group) {
+            Sample s;
+            s.ParseFromArray(data.data(), data.size());
+            assert(s.group() == std::string(group));
+            assert(group == sample1 || group == sample2);
+            span_receive = true;
+        },
+        {goby::middleware::MarshallingScheme::PROTOBUF}, ".*Sample", "Sample1|Sample2");
+
     ipc.subscribe_type_regex<sample1, google::protobuf::Message>(
         [&](std::shared_ptr<const google::protobuf::Message> msg, const std::string& type) {
             glog.is(DEBUG1) &&
@@ -172,6 +195,7 @@ void zmq_forward(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
     assert(non_template_receive);
     assert(template_receive);
     assert(special_chars_receive);
+    assert(span_receive);
 }
 
 int main(int argc, char* argv[])
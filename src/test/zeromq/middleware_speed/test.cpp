@@ -23,6 +23,7 @@
 #include <sys/wait.h>
 
 #include <atomic>
+#include <cassert>
 #include <deque>
 
 #include <boost/units/io.hpp>
@@ -46,6 +47,8 @@ int ipc_receive_count = {0};
 std::atomic<bool> forward(true);
 std::atomic<int> zmq_reqs(0);
 int test = 1;
+std::string variant;
+const std::size_t batch_size = 10;
 goby::middleware::InterThreadTransporter interthread1;
 goby::middleware::InterThreadTransporter interthread2;
 
@@ -110,6 +113,7 @@ void publisher(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
         std::cout << "Start: " << std::setprecision(15)
                   << goby::time::SystemClock::now<goby::time::SITime>() << std::endl;
 
+        std::vector<Type> batch;
         while (publish_count < max_publish)
         {
             Type s;
@@ -120,7 +124,19 @@ void publisher(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
             s.set_salinity(30.1);
             s.set_depth(5.2);
 #endif
-            zmq.publish<sample1_group>(s);
+            if (variant == "batch")
+            {
+                batch.push_back(s);
+                if (batch.size() == batch_size)
+                {
+                    zmq.publish_batch<sample1_group>(batch);
+                    batch.clear();
+                }
+            }
+            else
+            {
+                zmq.publish<sample1_group>(s);
+            }
 
             ++publish_count;
         }
@@ -143,6 +159,10 @@ void handle_sample1(const Type& sample)
     }
 
     //std::cout << sample.ShortDebugString() << std::endl;
+#ifndef LARGE_MESSAGE
+    // batching and coalescing must not reorder publications
+    assert(sample.temperature() == ipc_receive_count);
+#endif
     ++ipc_receive_count;
 
     //    if((ipc_receive_count % 100000) == 0)
@@ -183,13 +203,22 @@ void subscriber(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
 
 int main(int argc, char* argv[])
 {
-    if (argc == 2)
+    if (argc >= 2)
         test = std::stoi(argv[1]);
+    // interprocess variants: "binary", "batch", "coalesce"
+    if (argc == 3)
+        variant = argv[2];
 
-    std::cout << "Running test type (0 = interthread, 1 = interprocess): " << test << std::endl;
+    std::cout << "Running test type (0 = interthread, 1 = interprocess): " << test << " "
+              << variant << std::endl;
 
     goby::zeromq::protobuf::InterProcessPortalConfig cfg;
-    cfg.set_platform("test6_" + std::to_string(test));
+    cfg.set_platform("test6_" + std::to_string(test) + variant);
+    if (variant == "binary")
+        cfg.set_identifier_format(
+            goby::zeromq::protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY);
+    else if (variant == "coalesce")
+        cfg.set_publish_coalesce_max_bytes(4096);
     //    cfg.set_transport(goby::zeromq::protobuf::InterProcessPortalConfig::TCP);
     // cfg.set_ipv4_address("127.0.0.1");
     //cfg.set_tcp_port(10005);
@@ -60,8 +60,12 @@ void goby::zeromq::setup_socket(zmq::socket_t& socket, const protobuf::Socket& c
 // InterProcessPortalMainThread
 //
 
-goby::zeromq::InterProcessPortalMainThread::InterProcessPortalMainThread(zmq::context_t& context)
-    : control_socket_(context, ZMQ_PAIR), publish_socket_(context, ZMQ_PUB)
+goby::zeromq::InterProcessPortalMainThread::InterProcessPortalMainThread(
+    zmq::context_t& context, const protobuf::InterProcessPortalConfig& cfg)
+    : control_socket_(context, ZMQ_PAIR),
+      publish_socket_(context, ZMQ_PUB),
+      coalesce_max_bytes_(cfg.publish_coalesce_max_bytes()),
+      coalesce_max_delay_(cfg.publish_coalesce_max_delay_ms())
 {
     control_socket_.bind("inproc://control");
 }
@@ -91,31 +95,141 @@ void goby::zeromq::InterProcessPortalMainThread::set_publish_cfg(const protobuf:
     usleep(100000); // avoids "slow joiner" on initial publications
 
     // publish any queued up messages
-    for (auto& pub_pair : publish_queue_)
-        publish(pub_pair.first, &pub_pair.second[0], pub_pair.second.size());
+    for (auto& queued : publish_queue_)
+        _send(queued.identifier, &queued.bytes[0], queued.bytes.size(), queued.is_batch);
     publish_queue_.clear();
 }
 
 void goby::zeromq::InterProcessPortalMainThread::publish(const std::string& identifier,
                                                          const char* bytes, int size)
 {
-    if (publish_socket_configured_)
+    if (coalesce_max_bytes_ == 0)
     {
-        zmq::message_t msg(identifier.size() + size);
-        memcpy(msg.data(), identifier.data(), identifier.size());
-        memcpy(static_cast<char*>(msg.data()) + identifier.size(), bytes, size);
-        publish_socket_.send(msg);
+        _send(identifier, bytes, size, false);
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto it = coalesced_.find(identifier);
+    if (detail::batched_size_bytes + size >= coalesce_max_bytes_)
+    {
+        // too large to gain anything from coalescing, but keep the order of this identifier
+        if (it != coalesced_.end() && it->second.count > 0)
+            _flush(identifier, it->second);
+        _send(identifier, bytes, size, false);
+    }
+    else
+    {
+        if (it == coalesced_.end())
+            it = coalesced_.insert(std::make_pair(identifier, Coalesced())).first;
+
+        Coalesced& coalesced = it->second;
+        if (coalesced.count == 0)
+        {
+            coalesced.first_publish = now;
+            next_coalesced_flush_ = std::min(next_coalesced_flush_, now + coalesce_max_delay_);
+            coalesced_pending_ = true;
+        }
+        detail::append_batched(coalesced.batch, bytes, size);
+        ++coalesced.count;
+
+        if (coalesced.batch.size() >= coalesce_max_bytes_)
+            _flush(identifier, coalesced);
+    }
+
+    if (now >= next_coalesced_flush_)
+        flush_coalesced(true);
+}
+
+void goby::zeromq::InterProcessPortalMainThread::publish_batch(const std::string& identifier,
+                                                               const char* batch, int size)
+{
+    // keep the order of this identifier
+    auto it = coalesced_.find(identifier);
+    if (it != coalesced_.end() && it->second.count > 0)
+        _flush(identifier, it->second);
+
+    _send(identifier, batch, size, true);
+}
+
+void goby::zeromq::InterProcessPortalMainThread::flush_coalesced(bool expired_only)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (expired_only && now < next_coalesced_flush_)
+        return;
+
+    next_coalesced_flush_ = std::chrono::steady_clock::time_point::max();
+    bool pending = false;
+    for (auto& p : coalesced_)
+    {
+        Coalesced& coalesced = p.second;
+        if (coalesced.count == 0)
+            continue;
+
+        auto flush_time = coalesced.first_publish + coalesce_max_delay_;
+        if (!expired_only || now >= flush_time)
+        {
+            _flush(p.first, coalesced);
+        }
+        else
+        {
+            pending = true;
+            next_coalesced_flush_ = std::min(next_coalesced_flush_, flush_time);
+        }
+    }
+    coalesced_pending_ = pending;
+}
+
+void goby::zeromq::InterProcessPortalMainThread::_flush(const std::string& identifier,
+                                                        Coalesced& coalesced)
+{
+    // send a lone publication as usual, rather than as a batch of one
+    if (coalesced.count == 1)
+        _send(identifier, coalesced.batch.data() + detail::batched_size_bytes,
+              coalesced.batch.size() - detail::batched_size_bytes, false);
+    else
+        _send(identifier, &coalesced.batch[0], coalesced.batch.size(), true);
+
+    coalesced.batch.clear();
+    coalesced.count = 0;
+}
 
-        glog.is(DEBUG3) && glog << "Published " << size << " bytes to ["
+void goby::zeromq::InterProcessPortalMainThread::_send(const std::string& identifier,
+                                                       const char* bytes, int size, bool is_batch)
+{
+    if (!publish_socket_configured_)
+    {
+        publish_queue_.push_back({identifier, std::vector<char>(bytes, bytes + size), is_batch});
+    }
+    else if (is_batch)
+    {
+        zmq::message_t identifier_msg(identifier.size());
+        memcpy(identifier_msg.data(), identifier.data(), identifier.size());
+        zmq::message_t batch_msg(size);
+        memcpy(batch_msg.data(), bytes, size);
+        publish_socket_.send(identifier_msg, ZMQ_SNDMORE);
+        publish_socket_.send(batch_msg);
+
+        glog.is(DEBUG3) && glog << "Published batch of " << size << " bytes to ["
                                 << identifier.substr(0, identifier.size() - 1) << "]" << std::endl;
     }
     else
     {
-        publish_queue_.push_back(
-            std::make_pair(identifier, std::vector<char>(bytes, bytes + size)));
+        zmq::message_t msg(identifier.size() + size);
+        memcpy(msg.data(), identifier.data(), identifier.size());
+        memcpy(static_cast<char*>(msg.data()) + identifier.size(), bytes, size);
+        _send(msg, identifier, size);
     }
 }
 
+void goby::zeromq::InterProcessPortalMainThread::_send(zmq::message_t& msg,
+                                                       const std::string& identifier, int size)
+{
+    publish_socket_.send(msg);
+    glog.is(DEBUG3) && glog << "Published " << size << " bytes to ["
+                            << identifier.substr(0, identifier.size() - 1) << "]" << std::endl;
+}
+
 void goby::zeromq::InterProcessPortalMainThread::subscribe(const std::string& identifier)
 {
     protobuf::InprocControl control;
@@ -165,13 +279,18 @@ void goby::zeromq::InterProcessPortalMainThread::send_control_msg(
 //
 goby::zeromq::InterProcessPortalReadThread::InterProcessPortalReadThread(
     const protobuf::InterProcessPortalConfig& cfg, zmq::context_t& context,
-    std::atomic<bool>& alive, std::shared_ptr<std::condition_variable_any> poller_cv)
+    std::atomic<bool>& alive, std::shared_ptr<std::condition_variable_any> poller_cv,
+    std::shared_ptr<middleware::detail::Doorbell> poller_doorbell, ReceivedDataQueue& received,
+    const std::atomic<bool>& coalesced_pending)
     : cfg_(cfg),
       control_socket_(context, ZMQ_PAIR),
       subscribe_socket_(context, ZMQ_SUB),
       manager_socket_(context, ZMQ_REQ),
       alive_(alive),
-      poller_cv_(poller_cv)
+      poller_cv_(poller_cv),
+      poller_doorbell_(poller_doorbell),
+      received_(received),
+      coalesced_pending_(coalesced_pending)
 {
     poll_items_.resize(NUMBER_SOCKETS);
     poll_items_[SOCKET_CONTROL] = {(void*)control_socket_, 0, ZMQ_POLLIN, 0};
@@ -214,6 +333,10 @@ void goby::zeromq::InterProcessPortalReadThread::run()
         {
             protobuf::ManagerRequest req;
             req.set_request(protobuf::PROVIDE_PUB_SUB_SOCKETS);
+            req.add_supported_identifier_format(
+                protobuf::InterProcessPortalConfig::IDENTIFIER_STRING);
+            req.add_supported_identifier_format(
+                protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY);
 
             zmq::message_t msg(req.ByteSize());
             req.SerializeToArray(static_cast<char*>(msg.data()), req.ByteSize());
@@ -235,8 +358,33 @@ void goby::zeromq::InterProcessPortalReadThread::run()
 
 void goby::zeromq::InterProcessPortalReadThread::poll(long timeout_ms)
 {
+    if (have_pending_received_)
+    {
+        if (received_.try_push(pending_received_))
+        {
+            have_pending_received_ = false;
+            notify_poller();
+        }
+        else if (timeout_ms < 0 || timeout_ms > pending_received_retry_ms)
+        {
+            timeout_ms = pending_received_retry_ms;
+        }
+    }
+
+    long coalesce_delay_ms = std::max<long>(1, cfg_.publish_coalesce_max_delay_ms());
+    if (coalesced_pending_ && (timeout_ms < 0 || timeout_ms > coalesce_delay_ms))
+        timeout_ms = coalesce_delay_ms;
+
+    // while the main thread is behind, leave further data in the subscribe socket
+    // (where the receive high water mark applies)
+    poll_items_[SOCKET_SUBSCRIBE].events = have_pending_received_ ? 0 : ZMQ_POLLIN;
+
     zmq::poll(&poll_items_[0], poll_items_.size(), timeout_ms);
 
+    // the main thread sends expired coalesced publications when it polls
+    if (coalesced_pending_)
+        notify_poller();
+
     for (int i = 0, n = poll_items_.size(); i < n; ++i)
     {
         if (poll_items_[i].revents & ZMQ_POLLIN)
@@ -250,7 +398,18 @@ void goby::zeromq::InterProcessPortalReadThread::poll(long timeout_ms)
                     break;
                 case SOCKET_SUBSCRIBE:
                     if (subscribe_socket_.recv(&zmq_msg))
-                        subscribe_data(zmq_msg);
+                    {
+                        ReceivedData received;
+                        received.message = std::move(zmq_msg);
+
+                        // batched publications: the remaining part is always available
+                        int more = 0;
+                        std::size_t more_size = sizeof(more);
+                        subscribe_socket_.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+                        if (more)
+                            received.is_batch = subscribe_socket_.recv(&received.batch);
+                        subscribe_data(received);
+                    }
                     break;
                 case SOCKET_MANAGER:
                     if (manager_socket_.recv(&zmq_msg))
@@ -302,13 +461,18 @@ void goby::zeromq::InterProcessPortalReadThread::control_data(const zmq::message
         default: break;
     }
 }
-void goby::zeromq::InterProcessPortalReadThread::subscribe_data(const zmq::message_t& zmq_msg)
+void goby::zeromq::InterProcessPortalReadThread::subscribe_data(ReceivedData& received)
 {
-    // data from goby - forward to the main thread
-    protobuf::InprocControl control;
-    control.set_type(protobuf::InprocControl::RECEIVE);
-    control.set_received_data(std::string((char*)zmq_msg.data(), zmq_msg.size()));
-    send_control_msg(control);
+    // data from goby - hand the message itself to the main thread
+    if (received_.try_push(received))
+    {
+        notify_poller();
+    }
+    else
+    {
+        pending_received_ = std::move(received);
+        have_pending_received_ = true;
+    }
 }
 void goby::zeromq::InterProcessPortalReadThread::manager_data(const zmq::message_t& zmq_msg)
 {
@@ -327,6 +491,7 @@ void goby::zeromq::InterProcessPortalReadThread::manager_data(const zmq::message
         protobuf::InprocControl control;
         control.set_type(protobuf::InprocControl::PUB_CONFIGURATION);
         *control.mutable_publish_socket() = response.publish_socket();
+        control.set_identifier_format(response.identifier_format());
         send_control_msg(control);
 
         have_pubsub_sockets_ = true;
@@ -342,7 +507,14 @@ void goby::zeromq::InterProcessPortalReadThread::send_control_msg(
     zmq::message_t zmq_control_msg(control.ByteSize());
     control.SerializeToArray((char*)zmq_control_msg.data(), zmq_control_msg.size());
     control_socket_.send(zmq_control_msg);
+    notify_poller();
+}
+
+void goby::zeromq::InterProcessPortalReadThread::notify_poller()
+{
     poller_cv_->notify_all();
+    if (poller_doorbell_)
+        poller_doorbell_->ring();
 }
 
 //
@@ -493,6 +665,18 @@ void goby::zeromq::Manager::run()
                         publish_socket->set_ethernet_port(router_.sub_port);
                         break;
                 }
+
+                pb_response.set_identifier_format(cfg_.identifier_format());
+                // all clients support IDENTIFIER_STRING, including those that predate the field
+                const auto& supported = pb_request.supported_identifier_format();
+                auto format = cfg_.identifier_format();
+                if (format != protobuf::InterProcessPortalConfig::IDENTIFIER_STRING &&
+                    std::find(supported.begin(), supported.end(), format) == supported.end())
+                    glog.is(WARN) &&
+                        glog << "Client does not support identifier format "
+                             << protobuf::InterProcessPortalConfig::IdentifierFormat_Name(format)
+                             << ": its publications will not be received by other clients"
+                             << std::endl;
             }
 
             zmq::message_t reply(pb_response.ByteSize());
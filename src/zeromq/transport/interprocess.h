@@ -23,9 +23,12 @@
 #ifndef TransportInterProcessZeroMQ20170807H
 #define TransportInterProcessZeroMQ20170807H
 
+#include <cstdint>
+#include <cstring>
 #include <tuple>
 #include <zmq.hpp>
 
+#include "goby/middleware/detail/mailbox.h"
 #include "goby/middleware/transport/interprocess.h"
 #include "goby/zeromq/protobuf/interprocess_config.pb.h"
 #include "goby/zeromq/protobuf/interprocess_zeromq.pb.h"
@@ -35,28 +38,283 @@ namespace goby
 namespace zeromq
 {
 void setup_socket(zmq::socket_t& socket, const protobuf::Socket& cfg);
+
+// a message received on the subscribe socket: identifier and data for a single publication, or
+// (if is_batch) the identifier part of a batched publication with the packed data in batch
+struct ReceivedData
+{
+    zmq::message_t message;
+    zmq::message_t batch;
+    bool is_batch{false};
+};
+
+// passed without copying from the read thread to the main thread
+using ReceivedDataQueue = middleware::detail::Mailbox<ReceivedData>;
+
+namespace detail
+{
+// identifies subscriptions within a portal, regardless of the identifier format on the wire
+struct IdentifierKey
+{
+    std::uint64_t group_hash;
+    std::uint64_t type_hash;
+    int scheme;
+};
+
+inline bool operator==(const IdentifierKey& a, const IdentifierKey& b)
+{
+    return a.group_hash == b.group_hash && a.type_hash == b.type_hash && a.scheme == b.scheme;
+}
+
+struct IdentifierKeyHash
+{
+    std::size_t operator()(const IdentifierKey& k) const noexcept
+    {
+        return static_cast<std::size_t>(k.group_hash ^ (k.type_hash * 31) ^ k.scheme);
+    }
+};
+
+// group and type names of a received publication (pointing into the received identifier)
+struct ReceivedNames
+{
+    const char* group;
+    std::size_t group_size;
+    const char* type;
+    std::size_t type_size;
+};
+
+// IdentifierKey only has hashes of the names: check the names themselves before posting so that a
+// hash collision cannot pass data to a subscription for a different type
+inline bool names_match(const ReceivedNames& names,
+                        const middleware::SerializationHandlerBase<>& subscription)
+{
+    const std::string& type = subscription.type_name();
+    if (type.compare(0, std::string::npos, names.type, names.type_size) != 0)
+        return false;
+
+    const middleware::Group& group = subscription.subscribed_group();
+    if (group.c_str() != nullptr)
+        return std::strlen(group.c_str()) == names.group_size &&
+               std::memcmp(group.c_str(), names.group, names.group_size) == 0;
+    else
+        return std::string(group).compare(0, std::string::npos, names.group, names.group_size) ==
+               0;
+}
+
+// Binary identifier (IDENTIFIER_BINARY), all integers big-endian:
+//   [0] marker, [1,9) group hash, [9,13) scheme, [13,21) type hash, [21,25) process id,
+//   [25,29) thread index, then group name and type name (each preceded by a uint16 length), then
+//   the serialized data. Subscriptions (and ZeroMQ prefix matching) use the first 21 bytes.
+constexpr char binary_identifier_marker{'\x01'};
+constexpr std::size_t binary_identifier_key_size{21};
+constexpr std::size_t binary_identifier_fixed_size{29};
+
+template <typename Integer, typename Bytes> void append_big_endian(Bytes& s, Integer v)
+{
+    for (int i = sizeof(Integer) - 1; i >= 0; --i)
+        s.push_back(static_cast<char>((static_cast<std::uint64_t>(v) >> (8 * i)) & 0xFF));
+}
+
+template <typename Integer> void write_big_endian(char* p, Integer v)
+{
+    for (int i = sizeof(Integer) - 1; i >= 0; --i)
+        *p++ = static_cast<char>((static_cast<std::uint64_t>(v) >> (8 * i)) & 0xFF);
+}
+
+template <typename Integer> Integer read_big_endian(const char* p)
+{
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < sizeof(Integer); ++i)
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return static_cast<Integer>(v);
+}
+
+inline void append_binary_name(std::string& s, const std::string& name)
+{
+    append_big_endian<std::uint16_t>(s, name.size());
+    s.append(name);
+}
+
+// Batched publications are sent as a two-part ZeroMQ message: the identifier (exactly as for a
+// single publication, so that subscription filtering is unchanged), then the packed data:
+//   repeated { uint32 size (big-endian), serialized data }
+constexpr std::size_t batched_size_bytes{4};
+
+inline void append_batched(std::vector<char>& batch, const char* bytes, std::size_t size)
+{
+    append_big_endian<std::uint32_t>(batch, size);
+    batch.insert(batch.end(), bytes, bytes + size);
+}
+
+// appends the publication written by serialize(middleware::ByteSink&)
+template <typename Serializer> void append_batched(std::vector<char>& batch, Serializer serialize)
+{
+    auto size_pos = batch.size();
+    batch.resize(size_pos + batched_size_bytes);
+    middleware::ContainerByteSink<std::vector<char>> sink(batch);
+    serialize(sink);
+    write_big_endian<std::uint32_t>(&batch[size_pos],
+                                    batch.size() - size_pos - batched_size_bytes);
+}
+
+// ByteSink that creates the ZeroMQ message (identifier followed by the data) on the first
+// append(), so a serializer that finds its size once writes straight into the message. Any later
+// append() (none of the built-in schemes make one) moves the data to overflow and continues there.
+class MessageByteSink : public middleware::ByteSink
+{
+  public:
+    MessageByteSink(const std::string& identifier, std::vector<char>& overflow)
+        : identifier_(identifier), overflow_(overflow)
+    {
+    }
+
+    char* append(std::size_t size) override
+    {
+        if (!allocated_)
+        {
+            allocated_ = true;
+            size_ = size;
+            message_.rebuild(identifier_.size() + size);
+            char* data = static_cast<char*>(message_.data());
+            memcpy(data, identifier_.data(), identifier_.size());
+            return data + identifier_.size();
+        }
+
+        if (!overflowed_)
+        {
+            overflowed_ = true;
+            const char* data = static_cast<const char*>(message_.data()) + identifier_.size();
+            overflow_.assign(data, data + size_);
+        }
+        size_ += size;
+        middleware::ContainerByteSink<std::vector<char>> overflow_sink(overflow_);
+        return overflow_sink.append(size);
+    }
+
+    // true if the data is in overflow rather than message()
+    bool overflowed() const { return overflowed_; }
+
+    zmq::message_t& message()
+    {
+        if (!allocated_)
+            append(0);
+        return message_;
+    }
+
+    // bytes of data (not including the identifier)
+    std::size_t size() const { return size_; }
+
+  private:
+    const std::string& identifier_;
+    std::vector<char>& overflow_;
+    zmq::message_t message_;
+    bool allocated_{false};
+    bool overflowed_{false};
+    std::size_t size_{0};
+};
+
+/// \brief Calls f(begin, end) for each publication in a batch
+/// \return false if the batch is malformed (f is called for the publications before the error)
+template <typename Function> bool for_each_batched(const char* begin, const char* end, Function f)
+{
+    while (begin != end)
+    {
+        if (end - begin < static_cast<std::ptrdiff_t>(batched_size_bytes))
+            return false;
+        std::uint32_t size = read_big_endian<std::uint32_t>(begin);
+        begin += batched_size_bytes;
+        if (static_cast<std::size_t>(end - begin) < size)
+            return false;
+        f(begin, begin + size);
+        begin += size;
+    }
+    return true;
+}
+
+} // namespace detail
+
 // run in the same thread as InterProcessPortal
 class InterProcessPortalMainThread
 {
   public:
-    InterProcessPortalMainThread(zmq::context_t& context);
+    InterProcessPortalMainThread(zmq::context_t& context,
+                                 const protobuf::InterProcessPortalConfig& cfg);
     bool ready() { return publish_socket_configured_; }
     bool recv(protobuf::InprocControl* control_msg, int flags = 0);
     void set_publish_cfg(const protobuf::Socket& cfg);
     void publish(const std::string& identifier, const char* bytes, int size);
+
+    /// \brief Publish data written by serialize(middleware::ByteSink&), directly into the ZeroMQ
+    /// message when it can be sent right away, otherwise into a reused buffer
+    template <typename Serializer> void publish(const std::string& identifier, Serializer serialize)
+    {
+        if (publish_socket_configured_ && coalesce_max_bytes_ == 0)
+        {
+            detail::MessageByteSink sink(identifier, publish_buffer_);
+            serialize(sink);
+            if (!sink.overflowed())
+            {
+                _send(sink.message(), identifier, sink.size());
+                return;
+            }
+        }
+        else
+        {
+            publish_buffer_.clear();
+            middleware::ContainerByteSink<std::vector<char>> sink(publish_buffer_);
+            serialize(sink);
+        }
+        publish(identifier, publish_buffer_.data(), publish_buffer_.size());
+    }
+
+    // batch is packed using detail::append_batched
+    void publish_batch(const std::string& identifier, const char* batch, int size);
     void subscribe(const std::string& identifier);
     void unsubscribe(const std::string& identifier);
     void reader_shutdown();
 
+    // send coalesced publications (all, or only those held for publish_coalesce_max_delay_ms)
+    void flush_coalesced(bool expired_only = false);
+    // true while coalesced publications are waiting to be sent
+    const std::atomic<bool>& coalesced_pending() const { return coalesced_pending_; }
+
   private:
     void send_control_msg(const protobuf::InprocControl& control);
+    void _send(const std::string& identifier, const char* bytes, int size, bool is_batch);
+    // msg: identifier followed by size bytes of data
+    void _send(zmq::message_t& msg, const std::string& identifier, int size);
+
+    struct Coalesced
+    {
+        std::chrono::steady_clock::time_point first_publish;
+        int count{0};
+        std::vector<char> batch;
+    };
+    void _flush(const std::string& identifier, Coalesced& coalesced);
 
   private:
     zmq::socket_t control_socket_;
     zmq::socket_t publish_socket_;
     bool publish_socket_configured_{false};
-    std::deque<std::pair<std::string, std::vector<char>>>
-        publish_queue_; //used before publish_socket_configured_ == true
+
+    struct QueuedPublication
+    {
+        std::string identifier;
+        std::vector<char> bytes;
+        bool is_batch;
+    };
+    std::deque<QueuedPublication> publish_queue_; //used before publish_socket_configured_ == true
+    // reused when we can't serialize directly into a zmq::message_t
+    std::vector<char> publish_buffer_;
+
+    // publish_coalesce_max_bytes == 0 disables coalescing
+    const std::size_t coalesce_max_bytes_;
+    const std::chrono::milliseconds coalesce_max_delay_;
+    // keyed on identifier, entries are kept (empty) to reuse the batch buffer
+    std::unordered_map<std::string, Coalesced> coalesced_;
+    std::chrono::steady_clock::time_point next_coalesced_flush_{
+        std::chrono::steady_clock::time_point::max()};
+    std::atomic<bool> coalesced_pending_{false};
 };
 
 // run in a separate thread to allow zmq_.poll() to block without interrupting the main thread
@@ -65,15 +323,19 @@ class InterProcessPortalReadThread
   public:
     InterProcessPortalReadThread(const protobuf::InterProcessPortalConfig& cfg,
                                  zmq::context_t& context, std::atomic<bool>& alive,
-                                 std::shared_ptr<std::condition_variable_any> poller_cv);
+                                 std::shared_ptr<std::condition_variable_any> poller_cv,
+                                 std::shared_ptr<middleware::detail::Doorbell> poller_doorbell,
+                                 ReceivedDataQueue& received,
+                                 const std::atomic<bool>& coalesced_pending);
     void run();
 
   private:
     void poll(long timeout_ms = -1);
     void control_data(const zmq::message_t& zmq_msg);
-    void subscribe_data(const zmq::message_t& zmq_msg);
+    void subscribe_data(ReceivedData& received);
     void manager_data(const zmq::message_t& zmq_msg);
     void send_control_msg(const protobuf::InprocControl& control);
+    void notify_poller();
 
   private:
     const protobuf::InterProcessPortalConfig& cfg_;
@@ -82,6 +344,14 @@ class InterProcessPortalReadThread
     zmq::socket_t manager_socket_;
     std::atomic<bool>& alive_;
     std::shared_ptr<std::condition_variable_any> poller_cv_;
+    std::shared_ptr<middleware::detail::Doorbell> poller_doorbell_;
+    ReceivedDataQueue& received_;
+    // message that didn't fit in received_ (main thread is behind)
+    ReceivedData pending_received_;
+    static constexpr long pending_received_retry_ms{1};
+    bool have_pending_received_{false};
+    // the main thread is holding publications for coalescing: wake it up periodically to send them
+    const std::atomic<bool>& coalesced_pending_;
     std::vector<zmq::pollitem_t> poll_items_;
     enum
     {
@@ -108,8 +378,11 @@ class InterProcessPortal
     InterProcessPortal(const protobuf::InterProcessPortalConfig& cfg)
         : cfg_(cfg),
           zmq_context_(cfg.zeromq_number_io_threads()),
-          zmq_main_(zmq_context_),
-          zmq_read_thread_(cfg_, zmq_context_, zmq_alive_, middleware::PollerInterface::cv())
+          zmq_main_(zmq_context_, cfg),
+          zmq_received_(cfg.receive_queue_size()),
+          zmq_read_thread_(cfg_, zmq_context_, zmq_alive_, middleware::PollerInterface::cv(),
+                           middleware::PollerInterface::doorbell(), zmq_received_,
+                           zmq_main_.coalesced_pending())
     {
         _init();
     }
@@ -118,8 +391,11 @@ class InterProcessPortal
         : Base(inner),
           cfg_(cfg),
           zmq_context_(cfg.zeromq_number_io_threads()),
-          zmq_main_(zmq_context_),
-          zmq_read_thread_(cfg_, zmq_context_, zmq_alive_, middleware::PollerInterface::cv())
+          zmq_main_(zmq_context_, cfg),
+          zmq_received_(cfg.receive_queue_size()),
+          zmq_read_thread_(cfg_, zmq_context_, zmq_alive_, middleware::PollerInterface::cv(),
+                           middleware::PollerInterface::doorbell(), zmq_received_,
+                           zmq_main_.coalesced_pending())
     {
         _init();
     }
@@ -128,11 +404,51 @@ class InterProcessPortal
     {
         if (zmq_thread_)
         {
+            zmq_main_.flush_coalesced();
             zmq_main_.reader_shutdown();
             zmq_thread_->join();
         }
     }
 
+    /// \brief Publish a range of Data to a compile-time group as a single ZeroMQ message
+    ///
+    /// Subscribers receive each element as a separate publication, in order, exactly as if
+    /// publish() had been called for each. This avoids the per-message overhead for many small
+    /// messages.
+    template <const goby::middleware::Group& group, typename Range,
+              typename Data =
+                  typename std::decay<decltype(*std::begin(std::declval<Range>()))>::type,
+              int scheme = goby::middleware::scheme<Data>()>
+    void publish_batch(const Range& data,
+                       const middleware::Publisher<Data>& publisher = middleware::Publisher<Data>())
+    {
+        Base::template check_validity<group>();
+        publish_batch_dynamic<Data, scheme>(data, group, publisher);
+    }
+
+    /// \brief Publish a range of Data to a runtime group as a single ZeroMQ message
+    template <typename Data, int scheme = goby::middleware::scheme<Data>(), typename Range>
+    void publish_batch_dynamic(
+        const Range& data, const goby::middleware::Group& group,
+        const middleware::Publisher<Data>& publisher = middleware::Publisher<Data>())
+    {
+        Base::check_validity_runtime(group);
+
+        std::vector<char> batch;
+        for (const Data& d : data)
+        {
+            detail::append_batched(batch, [&](middleware::ByteSink& sink) {
+                middleware::serialize_to<Data, scheme>(d, sink);
+            });
+        }
+        if (!batch.empty())
+            zmq_main_.publish_batch(_make_fully_qualified_identifier<Data, scheme>(group),
+                                    &batch[0], batch.size());
+
+        for (const Data& d : data)
+            Base::inner_.template publish_dynamic<Data, scheme>(d, group, publisher);
+    }
+
     friend Base;
 
   private:
@@ -175,6 +491,7 @@ class InterProcessPortal
                 switch (control_msg.type())
                 {
                     case protobuf::InprocControl::PUB_CONFIGURATION:
+                        identifier_format_ = control_msg.identifier_format();
                         zmq_main_.set_publish_cfg(control_msg.publish_socket());
                         break;
                     default: break;
@@ -187,9 +504,11 @@ class InterProcessPortal
     void _publish(const Data& d, const goby::middleware::Group& group,
                   const middleware::Publisher<Data>& publisher)
     {
-        std::vector<char> bytes(middleware::SerializerParserHelper<Data, scheme>::serialize(d));
-        std::string identifier = _make_fully_qualified_identifier<Data, scheme>(group) + '\0';
-        zmq_main_.publish(identifier, &bytes[0], bytes.size());
+        auto serialize = [&](middleware::ByteSink& sink) {
+            middleware::serialize_to<Data, scheme>(d, sink);
+        };
+
+        zmq_main_.publish(_make_fully_qualified_identifier<Data, scheme>(group), serialize);
     }
 
     template <typename Data, int scheme>
@@ -197,25 +516,23 @@ class InterProcessPortal
                     const goby::middleware::Group& group,
                     const middleware::Subscriber<Data>& subscriber)
     {
-        std::string identifier =
-            _make_identifier<Data, scheme>(group, IdentifierWildcard::PROCESS_THREAD_WILDCARD);
+        auto key = _make_key<Data, scheme>(group);
 
         auto subscription = std::make_shared<middleware::SerializationSubscription<Data, scheme>>(
             f, group,
             middleware::Subscriber<Data>(goby::middleware::protobuf::TransporterConfig(),
                                          [=](const Data& d) { return group; }));
 
-        if (forwarder_subscriptions_.count(identifier) == 0 &&
-            portal_subscriptions_.count(identifier) == 0)
-            zmq_main_.subscribe(identifier);
-        portal_subscriptions_.insert(std::make_pair(identifier, subscription));
+        if (forwarder_subscriptions_.count(key) == 0 && portal_subscriptions_.count(key) == 0)
+            zmq_main_.subscribe(_make_identifier(_type_name<Data, scheme>(), scheme, group,
+                                                 IdentifierWildcard::PROCESS_THREAD_WILDCARD));
+        portal_subscriptions_.insert(std::make_pair(key, subscription));
     }
 
-    void _subscribe_regex(
-        std::function<void(const std::vector<unsigned char>&, int scheme, const std::string& type,
-                           const goby::middleware::Group& group)>
-            f,
-        const std::set<int>& schemes, const std::string& type_regex, const std::string& group_regex)
+    // HandlerType: SerializationSubscriptionRegex::HandlerType or SpanHandlerType
+    template <typename HandlerType>
+    void _subscribe_regex(HandlerType f, const std::set<int>& schemes,
+                          const std::string& type_regex, const std::string& group_regex)
     {
         auto new_sub = std::make_shared<middleware::SerializationSubscriptionRegex>(
             f, schemes, type_regex, group_regex);
@@ -224,14 +541,14 @@ class InterProcessPortal
 
     template <typename Data, int scheme> void _unsubscribe(const goby::middleware::Group& group)
     {
-        std::string identifier =
-            _make_identifier<Data, scheme>(group, IdentifierWildcard::PROCESS_THREAD_WILDCARD);
+        auto key = _make_key<Data, scheme>(group);
 
-        portal_subscriptions_.erase(identifier);
+        portal_subscriptions_.erase(key);
 
         // If no forwarded subscriptions, do the actual unsubscribe
-        if (forwarder_subscriptions_.count(identifier) == 0)
-            zmq_main_.unsubscribe(identifier);
+        if (forwarder_subscriptions_.count(key) == 0)
+            zmq_main_.unsubscribe(_make_identifier(_type_name<Data, scheme>(), scheme, group,
+                                                   IdentifierWildcard::PROCESS_THREAD_WILDCARD));
     }
 
     void _unsubscribe_all(const std::thread::id thread_id = std::this_thread::get_id())
@@ -241,9 +558,8 @@ class InterProcessPortal
         {
             for (const auto& p : portal_subscriptions_)
             {
-                const auto& identifier = p.first;
-                if (forwarder_subscriptions_.count(identifier) == 0)
-                    zmq_main_.unsubscribe(identifier);
+                if (forwarder_subscriptions_.count(p.first) == 0)
+                    zmq_main_.unsubscribe(_make_identifier(*p.second));
             }
             portal_subscriptions_.clear();
         }
@@ -259,87 +575,168 @@ class InterProcessPortal
         {
             regex_subscriptions_.erase(thread_id);
             if (regex_subscriptions_.empty())
-                zmq_main_.unsubscribe("/");
+                zmq_main_.unsubscribe(_all_identifiers());
         }
     }
 
     int _poll(std::unique_ptr<std::unique_lock<std::timed_mutex>>& lock)
     {
-        int items = 0;
-        protobuf::InprocControl control_msg;
-        while (zmq_main_.recv(&control_msg, ZMQ_NOBLOCK))
+        zmq_main_.flush_coalesced(true);
+
+        return zmq_received_.consume(
+            [&](ReceivedData received) {
+                if (lock)
+                    lock.reset();
+                _receive(received);
+            },
+            zmq_received_.capacity());
+    }
+
+    // message: identifier, then the serialized message (not copied)
+    void _receive(const ReceivedData& received)
+    {
+        const char* data = static_cast<const char*>(received.message.data());
+        const char* data_end = data + received.message.size();
+        if (data != data_end && *data == detail::binary_identifier_marker)
+            _receive_binary(data, data_end, received);
+        else
+            _receive_string(data, data_end, received);
+    }
+
+    void _receive_binary(const char* data, const char* data_end, const ReceivedData& received)
+    {
+        auto names_size = [&](const char* p) {
+            return p + 2 <= data_end ? std::size_t(2) + detail::read_big_endian<std::uint16_t>(p)
+                                     : std::size_t(data_end - p) + 1;
+        };
+
+        const char* group_begin = data + detail::binary_identifier_fixed_size;
+        const char* type_begin = nullptr;
+        const char* bytes_begin = nullptr;
+        if (data_end - data >= static_cast<std::ptrdiff_t>(detail::binary_identifier_fixed_size))
         {
-            switch (control_msg.type())
-            {
-                case protobuf::InprocControl::RECEIVE:
-                {
-                    ++items;
-                    if (lock)
-                        lock.reset();
-
-                    const auto& data = control_msg.received_data();
-
-                    std::string group, type, thread;
-                    int scheme, process;
-                    std::tie(group, scheme, type, process, thread) = parse_identifier(data);
-                    std::string identifier = _make_identifier(
-                        type, scheme, group, IdentifierWildcard::PROCESS_THREAD_WILDCARD);
-
-                    // build a set so if any of the handlers unsubscribes, we still have a pointer to the middleware::SerializationHandlerBase<>
-                    std::vector<std::weak_ptr<const middleware::SerializationHandlerBase<>>>
-                        subs_to_post;
-                    auto portal_range = portal_subscriptions_.equal_range(identifier);
-                    for (auto it = portal_range.first; it != portal_range.second; ++it)
-                        subs_to_post.push_back(it->second);
-                    auto forwarder_it = forwarder_subscriptions_.find(identifier);
-                    if (forwarder_it != forwarder_subscriptions_.end())
-                        subs_to_post.push_back(forwarder_it->second);
-
-                    // actually post the data
-                    {
-                        const auto& data = control_msg.received_data();
-                        auto null_delim_it = std::find(std::begin(data), std::end(data), '\0');
-                        for (auto& sub : subs_to_post)
-                        {
-                            if (auto sub_sp = sub.lock())
-                                sub_sp->post(null_delim_it + 1, data.end());
-                        }
-                    }
+            type_begin = group_begin + names_size(group_begin);
+            if (type_begin <= data_end)
+                bytes_begin = type_begin + names_size(type_begin);
+        }
+        if (bytes_begin == nullptr || bytes_begin > data_end)
+        {
+            goby::glog.is_warn() && goby::glog << "Received malformed binary identifier"
+                                               << std::endl;
+            return;
+        }
 
-                    if (!regex_subscriptions_.empty())
-                    {
-                        auto null_delim_it = std::find(std::begin(data), std::end(data), '\0');
-
-                        bool forwarder_subscription_posted = false;
-                        for (auto& sub : regex_subscriptions_)
-                        {
-                            // only post at most once for forwarders as the threads will filter
-                            bool is_forwarded_sub = sub.first != std::this_thread::get_id();
-                            if (is_forwarded_sub && forwarder_subscription_posted)
-                                continue;
-
-                            if (sub.second->post(null_delim_it + 1, data.end(), scheme, type,
-                                                 group) &&
-                                is_forwarded_sub)
-                                forwarder_subscription_posted = true;
-                        }
-                    }
-                }
-                break;
+        detail::IdentifierKey key{detail::read_big_endian<std::uint64_t>(data + 1),
+                                  detail::read_big_endian<std::uint64_t>(data + 13),
+                                  detail::read_big_endian<std::int32_t>(data + 9)};
+
+        detail::ReceivedNames names{group_begin + 2, std::size_t(type_begin - group_begin - 2),
+                                    type_begin + 2, std::size_t(bytes_begin - type_begin - 2)};
+        _post_received(key, bytes_begin, data_end, names, received);
+    }
+
+    void _receive_string(const char* data, const char* data_end, const ReceivedData& received)
+    {
+        const char* null_delim_it = std::find(data, data_end, '\0');
+        if (null_delim_it == data_end)
+        {
+            goby::glog.is_warn() && goby::glog << "Received message without identifier delimiter"
+                                               << std::endl;
+            return;
+        }
+
+        std::string group, type, thread;
+        int scheme, process;
+        std::tie(group, scheme, type, process, thread) =
+            parse_identifier(std::string(data, null_delim_it));
+
+        detail::IdentifierKey key{middleware::detail::fnv1a(group.c_str()),
+                                  middleware::detail::fnv1a(type.c_str()), scheme};
+        detail::ReceivedNames names{group.data(), group.size(), type.data(), type.size()};
+        _post_received(key, null_delim_it + 1, data_end, names, received);
+    }
+
+    // bytes_begin, bytes_end: data following the identifier (empty for a batch)
+    void _post_received(const detail::IdentifierKey& key, const char* bytes_begin,
+                        const char* bytes_end, const detail::ReceivedNames& names,
+                        const ReceivedData& received)
+    {
+        // the names as strings, only needed by regex subscriptions: made at most once per message
+        // (or batch)
+        std::string group, type;
+
+        if (!received.is_batch)
+        {
+            _post(key, bytes_begin, bytes_end, names, group, type);
+        }
+        else
+        {
+            const char* batch = static_cast<const char*>(received.batch.data());
+            if (!detail::for_each_batched(batch, batch + received.batch.size(),
+                                          [&](const char* begin, const char* end) {
+                                              _post(key, begin, end, names, group, type);
+                                          }))
+                goby::glog.is_warn() && goby::glog << "Received malformed batch of publications"
+                                                   << std::endl;
+        }
+    }
+
+    // group, type: names as strings, assigned on first use (type names are never empty)
+    void _post(const detail::IdentifierKey& key, const char* bytes_begin, const char* bytes_end,
+               const detail::ReceivedNames& names, std::string& group, std::string& type)
+    {
+        // build a set so if any of the handlers unsubscribes, we still have a pointer to the middleware::SerializationHandlerBase<>
+        std::vector<std::weak_ptr<const middleware::SerializationHandlerBase<>>> subs_to_post;
+        auto portal_range = portal_subscriptions_.equal_range(key);
+        for (auto it = portal_range.first; it != portal_range.second; ++it)
+        {
+            if (detail::names_match(names, *it->second))
+                subs_to_post.push_back(it->second);
+        }
+        auto forwarder_it = forwarder_subscriptions_.find(key);
+        if (forwarder_it != forwarder_subscriptions_.end() &&
+            detail::names_match(names, *forwarder_it->second))
+            subs_to_post.push_back(forwarder_it->second);
+
+        // actually post the data
+        for (auto& sub : subs_to_post)
+        {
+            if (auto sub_sp = sub.lock())
+                sub_sp->post(bytes_begin, bytes_end);
+        }
 
-                default: break;
+        if (!regex_subscriptions_.empty())
+        {
+            if (type.empty())
+            {
+                group.assign(names.group, names.group_size);
+                type.assign(names.type, names.type_size);
+            }
+
+            bool forwarder_subscription_posted = false;
+            for (auto& sub : regex_subscriptions_)
+            {
+                // only post at most once for forwarders as the threads will filter
+                bool is_forwarded_sub = sub.first != std::this_thread::get_id();
+                if (is_forwarded_sub && forwarder_subscription_posted)
+                    continue;
+
+                if (sub.second->post(bytes_begin, bytes_end, key.scheme, type, group) &&
+                    is_forwarded_sub)
+                    forwarder_subscription_posted = true;
             }
         }
-        return items;
     }
 
     void _receive_publication_forwarded(
         std::shared_ptr<const goby::middleware::protobuf::SerializerTransporterMessage> msg)
     {
+        const auto& type = msg->key().type();
+        const auto& group = msg->key().group();
+        int scheme = msg->key().marshalling_scheme();
         std::string identifier =
-            _make_identifier(msg->key().type(), msg->key().marshalling_scheme(), msg->key().group(),
-                             IdentifierWildcard::NO_WILDCARDS) +
-            '\0';
+            _make_identifier(type, scheme, group, IdentifierWildcard::NO_WILDCARDS) +
+            _identifier_suffix(type, group);
         auto& bytes = msg->data();
         zmq_main_.publish(identifier, &bytes[0], bytes.size());
     }
@@ -347,37 +744,35 @@ class InterProcessPortal
     void _receive_subscription_forwarded(
         std::shared_ptr<const middleware::SerializationHandlerBase<>> subscription)
     {
-        std::string identifier = _make_identifier(subscription->type_name(), subscription->scheme(),
-                                                  subscription->subscribed_group(),
-                                                  IdentifierWildcard::PROCESS_THREAD_WILDCARD);
+        auto key = _make_key(subscription->type_name(), subscription->scheme(),
+                             subscription->subscribed_group());
 
         switch (subscription->action())
         {
             case middleware::SerializationHandlerBase<>::SubscriptionAction::SUBSCRIBE:
             {
                 // insert if this thread hasn't already subscribed
-                if (forwarder_subscription_identifiers_[subscription->thread_id()].count(
-                        identifier) == 0)
+                if (forwarder_subscription_identifiers_[subscription->thread_id()].count(key) == 0)
                 {
                     // first to subscribe from a Forwarder
-                    if (forwarder_subscriptions_.count(identifier) == 0)
+                    if (forwarder_subscriptions_.count(key) == 0)
                     {
                         // first to subscribe (locally or forwarded)
-                        if (portal_subscriptions_.count(identifier) == 0)
-                            zmq_main_.subscribe(identifier);
+                        if (portal_subscriptions_.count(key) == 0)
+                            zmq_main_.subscribe(_make_identifier(*subscription));
 
                         // create Forwarder subscription
-                        forwarder_subscriptions_.insert(std::make_pair(identifier, subscription));
+                        forwarder_subscriptions_.insert(std::make_pair(key, subscription));
                     }
                     forwarder_subscription_identifiers_[subscription->thread_id()].insert(
-                        std::make_pair(identifier, forwarder_subscriptions_.find(identifier)));
+                        std::make_pair(key, forwarder_subscriptions_.find(key)));
                 }
             }
             break;
 
             case middleware::SerializationHandlerBase<>::SubscriptionAction::UNSUBSCRIBE:
             {
-                _forwarder_unsubscribe(subscription->thread_id(), identifier);
+                _forwarder_unsubscribe(subscription->thread_id(), key);
             }
             break;
 
@@ -385,15 +780,15 @@ class InterProcessPortal
         }
     }
 
-    void _forwarder_unsubscribe(std::thread::id thread_id, std::string identifier)
+    void _forwarder_unsubscribe(std::thread::id thread_id, detail::IdentifierKey key)
     {
-        auto it = forwarder_subscription_identifiers_[thread_id].find(identifier);
+        auto it = forwarder_subscription_identifiers_[thread_id].find(key);
         if (it != forwarder_subscription_identifiers_[thread_id].end())
         {
             bool no_forwarder_subscribers = true;
             for (const auto& p : forwarder_subscription_identifiers_)
             {
-                if (p.second.count(identifier) != 0)
+                if (p.second.count(key) != 0)
                 {
                     no_forwarder_subscribers = false;
                     break;
@@ -403,11 +798,13 @@ class InterProcessPortal
             // if no Forwarder subscriptions left
             if (no_forwarder_subscribers)
             {
+                std::string identifier = _make_identifier(*it->second->second);
+
                 // erase the Forwarder subscription
                 forwarder_subscriptions_.erase(it->second);
 
                 // do the actual unsubscribe if we aren't subscribe locally as well
-                if (portal_subscriptions_.count(identifier) == 0)
+                if (portal_subscriptions_.count(key) == 0)
                     zmq_main_.unsubscribe(identifier);
             }
 
@@ -424,7 +821,7 @@ class InterProcessPortal
     void _subscribe_regex(std::shared_ptr<const middleware::SerializationSubscriptionRegex> new_sub)
     {
         if (regex_subscriptions_.empty())
-            zmq_main_.subscribe("/");
+            zmq_main_.subscribe(_all_identifiers());
 
         regex_subscriptions_.insert(std::make_pair(new_sub->thread_id(), new_sub));
     }
@@ -436,30 +833,72 @@ class InterProcessPortal
         PROCESS_THREAD_WILDCARD
     };
 
+    template <typename Data, int scheme> static const std::string& _type_name()
+    {
+        static const std::string type_name(
+            middleware::SerializerParserHelper<Data, scheme>::type_name());
+        return type_name;
+    }
+
+    template <typename Data, int scheme>
+    detail::IdentifierKey _make_key(const goby::middleware::Group& group)
+    {
+        static const std::uint64_t type_hash(
+            middleware::detail::fnv1a(_type_name<Data, scheme>().c_str()));
+        return detail::IdentifierKey{group.hash(), type_hash, scheme};
+    }
+
+    detail::IdentifierKey _make_key(const std::string& type_name, int scheme,
+                                    const goby::middleware::Group& group)
+    {
+        return detail::IdentifierKey{group.hash(), middleware::detail::fnv1a(type_name.c_str()),
+                                     scheme};
+    }
+
     template <typename Data, int scheme>
     std::string _make_fully_qualified_identifier(const goby::middleware::Group& group)
     {
-        auto it = id_map_.find(group);
+        auto key = _make_key<Data, scheme>(group);
+        auto it = id_map_.find(key);
         if (it == id_map_.end())
         {
+            const auto& type_name = _type_name<Data, scheme>();
             auto p = id_map_.insert(std::make_pair(
-                group, _make_identifier<Data, scheme>(group, IdentifierWildcard::THREAD_WILDCARD)));
+                key, std::make_pair(_make_identifier(type_name, scheme, group,
+                                                     IdentifierWildcard::THREAD_WILDCARD),
+                                    _identifier_suffix(type_name, group))));
             it = p.first;
         }
 
-        return it->second + id_component(std::this_thread::get_id(), threads_);
+        return it->second.first + _thread_component(std::this_thread::get_id()) +
+               it->second.second;
     }
 
-    template <typename Data, int scheme>
-    std::string _make_identifier(const goby::middleware::Group& group, IdentifierWildcard wildcard)
+    // ZeroMQ subscription identifier for a (local or forwarded) subscription
+    std::string _make_identifier(const middleware::SerializationHandlerBase<>& subscription)
     {
-        return _make_identifier(middleware::SerializerParserHelper<Data, scheme>::type_name(),
-                                scheme, group, wildcard);
+        return _make_identifier(subscription.type_name(), subscription.scheme(),
+                                subscription.subscribed_group(),
+                                IdentifierWildcard::PROCESS_THREAD_WILDCARD);
     }
 
     std::string _make_identifier(const std::string& type_name, int scheme, const std::string& group,
                                  IdentifierWildcard wildcard)
     {
+        if (identifier_format_ == protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY)
+        {
+            std::string identifier(1, detail::binary_identifier_marker);
+            identifier.reserve(detail::binary_identifier_fixed_size);
+            detail::append_big_endian(identifier, middleware::detail::fnv1a(group.c_str()));
+            detail::append_big_endian<std::int32_t>(identifier, scheme);
+            detail::append_big_endian(identifier, middleware::detail::fnv1a(type_name.c_str()));
+            if (wildcard != IdentifierWildcard::PROCESS_THREAD_WILDCARD)
+                detail::append_big_endian<std::uint32_t>(identifier, getpid());
+            if (wildcard == IdentifierWildcard::NO_WILDCARDS)
+                identifier += _thread_component(std::this_thread::get_id());
+            return identifier;
+        }
+
         switch (wildcard)
         {
             default:
@@ -474,6 +913,49 @@ class InterProcessPortal
         }
     }
 
+    // follows the NO_WILDCARDS identifier, before the data
+    std::string _identifier_suffix(const std::string& type_name, const std::string& group)
+    {
+        if (identifier_format_ == protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY)
+        {
+            std::string suffix;
+            detail::append_binary_name(suffix, group);
+            detail::append_binary_name(suffix, type_name);
+            return suffix;
+        }
+        else
+        {
+            return std::string(1, '\0');
+        }
+    }
+
+    const std::string& _thread_component(std::thread::id thread_id)
+    {
+        if (identifier_format_ == protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY)
+        {
+            auto it = threads_.find(thread_id);
+            if (it == threads_.end())
+            {
+                std::string index;
+                detail::append_big_endian<std::uint32_t>(index, threads_.size());
+                it = threads_.insert(std::make_pair(thread_id, index)).first;
+            }
+            return it->second;
+        }
+        else
+        {
+            return id_component(thread_id, threads_);
+        }
+    }
+
+    // prefix of every identifier
+    std::string _all_identifiers()
+    {
+        return identifier_format_ == protobuf::InterProcessPortalConfig::IDENTIFIER_BINARY
+                   ? std::string(1, detail::binary_identifier_marker)
+                   : std::string("/");
+    }
+
     // group, scheme, type, process, thread
     std::tuple<std::string, int, std::string, int, std::size_t>
     parse_identifier(const std::string& identifier)
@@ -518,19 +1000,28 @@ class InterProcessPortal
     std::atomic<bool> zmq_alive_{true};
     zmq::context_t zmq_context_;
     InterProcessPortalMainThread zmq_main_;
+    ReceivedDataQueue zmq_received_;
     InterProcessPortalReadThread zmq_read_thread_;
 
+    // set by gobyd
+    protobuf::InterProcessPortalConfig::IdentifierFormat identifier_format_{
+        protobuf::InterProcessPortalConfig::IDENTIFIER_STRING};
+
     // maps identifier to subscription
-    std::unordered_multimap<std::string,
-                            std::shared_ptr<const middleware::SerializationHandlerBase<>>>
+    std::unordered_multimap<detail::IdentifierKey,
+                            std::shared_ptr<const middleware::SerializationHandlerBase<>>,
+                            detail::IdentifierKeyHash>
         portal_subscriptions_;
     // only one subscription for each forwarded identifier
-    std::unordered_map<std::string, std::shared_ptr<const middleware::SerializationHandlerBase<>>>
+    std::unordered_map<detail::IdentifierKey,
+                       std::shared_ptr<const middleware::SerializationHandlerBase<>>,
+                       detail::IdentifierKeyHash>
         forwarder_subscriptions_;
     std::unordered_map<
         std::thread::id,
-        std::unordered_map<std::string,
-                           typename decltype(forwarder_subscriptions_)::const_iterator>>
+        std::unordered_map<detail::IdentifierKey,
+                           typename decltype(forwarder_subscriptions_)::const_iterator,
+                           detail::IdentifierKeyHash>>
         forwarder_subscription_identifiers_;
 
     std::unordered_multimap<std::thread::id,
@@ -540,8 +1031,10 @@ class InterProcessPortal
     std::unordered_map<int, std::string> schemes_;
     std::unordered_map<std::thread::id, std::string> threads_;
 
-    // make all but the thread part once and reuse
-    std::unordered_map<goby::middleware::Group, std::string> id_map_;
+    // make all but the thread part (and the part following it) once and reuse
+    std::unordered_map<detail::IdentifierKey, std::pair<std::string, std::string>,
+                       detail::IdentifierKeyHash>
+        id_map_;
 };
 
 class Router